@@ -3,6 +3,14 @@
 
 #include "object_pool.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
 #ifdef BENCH_BOOST_POOL
 #include <boost/pool/object_pool.hpp>
 #endif
@@ -29,6 +37,21 @@ struct BenchAllocFree
     }
 };
 
+/// Test which allocates a number of objects with a single call then frees
+/// them all.
+struct BenchBulkAllocFree
+{
+    const char* name() const { return "bulk alloc+free"; }
+    template <typename HarnessT>
+    size_t run(HarnessT& harness) const
+    {
+        harness.new_bulk();
+        harness.delete_all();
+
+        return harness.count();
+    }
+};
+
 /// Test which allocates a number of objects, memsets their contents a number
 /// of times then deletes all of the objects again.
 struct BenchAllocMemsetFree
@@ -57,6 +80,104 @@ struct BenchAllocMemsetFree
     }
 };
 
+/// Test which fills a pool then repeatedly deletes and reallocates objects at
+/// random indices, leaving free space scattered across many blocks.
+struct BenchChurn
+{
+    const char* name() const { return "churn"; }
+    template <typename HarnessT>
+    size_t run(HarnessT& harness) const
+    {
+        const size_t count = harness.count();
+        for (size_t i = 0; i < count; i++)
+        {
+            harness.new_index(i);
+        }
+
+        // fixed seed so every harness sees the same sequence
+        std::minstd_rand rng(1234);
+        for (size_t round = 0; round < 4; ++round)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const size_t index = rng() % count;
+                harness.delete_index(index);
+                harness.new_index(index);
+            }
+        }
+
+        harness.delete_all();
+
+        return count;
+    }
+};
+
+/// Test which allocates a number of objects then deletes them one at a time
+/// in a scattered order, so frees jump between blocks.
+struct BenchAllocScatteredFree
+{
+    const char* name() const { return "alloc+scattered free"; }
+    template <typename HarnessT>
+    size_t run(HarnessT& harness) const
+    {
+        const size_t count = harness.count();
+        for (size_t i = 0; i < count; i++)
+        {
+            harness.new_index(i);
+        }
+
+        // stepping by a large stride which is coprime with count visits
+        // every index once in an order which looks random to the allocator
+        size_t stride = 2654435761u % count | 1;
+        while (gcd(stride, count) != 1)
+        {
+            stride -= 2;
+        }
+        for (size_t i = 0, index = 0; i < count; i++, index = (index + stride) % count)
+        {
+            harness.delete_index(index);
+        }
+
+        return count;
+    }
+
+    static size_t gcd(size_t a, size_t b)
+    {
+        while (b != 0)
+        {
+            const size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+};
+
+/// Test which keeps half of the objects alive while interleaving allocs and
+/// frees, each object is freed after the next count / 2 allocations.
+struct BenchSteadyState
+{
+    const char* name() const { return "steady state alloc/free"; }
+    template <typename HarnessT>
+    size_t run(HarnessT& harness) const
+    {
+        const size_t count = harness.count();
+        const size_t num_live = count / 2;
+        for (size_t i = 0; i < num_live; i++)
+        {
+            harness.new_index(i);
+        }
+        for (size_t step = 0; step < count * 4; step++)
+        {
+            harness.new_index((step + num_live) % count);
+            harness.delete_index(step % count);
+        }
+        harness.delete_all();
+
+        return count * 4;
+    }
+};
+
 /// A struct which is the size of the given template parameter
 template <size_t N>
 struct Sized
@@ -78,15 +199,21 @@ public:
     {
     }
     void new_index(size_t i) { ptr[i] = pool.new_object(); }
+    void delete_index(size_t i)
+    {
+        pool.delete_object(ptr[i]);
+        ptr[i] = nullptr;
+    }
+    void new_bulk()
+    {
+        pool.new_objects(static_cast<typename PoolT::index_t>(ptr.size()), ptr.data());
+    }
     void delete_all()
     {
-        // delete individual objects for fair comparison
+        // frees everything in one pass, BenchAllocScatteredFree measures
+        // deleting individual objects
         pool.delete_all();
-        // for (auto & p : ptr)
-        //{
-        //    pool.delete_object(p);
-        //    p = nullptr;
-        //}
+        std::fill(ptr.begin(), ptr.end(), nullptr);
     }
     template <typename F>
     void for_each(const F func) const
@@ -110,6 +237,12 @@ private:
 
 #define BENCH_HEAP_ALLOC
 #ifdef BENCH_HEAP_ALLOC
+// heap allocator name used in labels, the bench_jemalloc and bench_tcmalloc
+// builds link a malloc replacement and set this
+#ifndef BENCH_HEAP_NAME
+#define BENCH_HEAP_NAME "HeapAlloc"
+#endif
+
 /// Test harness for running benchmark tests using the default system allocator.
 template <typename T>
 class HeapAllocHarness
@@ -119,12 +252,24 @@ public:
 
     HeapAllocHarness(size_t /*block_size*/, size_t allocs) : ptr(allocs, nullptr) {}
     void new_index(size_t i) { ptr[i] = new value_t; }
+    void delete_index(size_t i)
+    {
+        delete ptr[i];
+        ptr[i] = nullptr;
+    }
+    void new_bulk()
+    {
+        for (size_t i = 0; i < ptr.size(); i++)
+        {
+            new_index(i);
+        }
+    }
     void delete_all()
     {
         for (auto& p : ptr)
         {
             delete p;
-            //   p = nullptr;
+            p = nullptr;
         }
     }
     template <typename F>
@@ -132,17 +277,20 @@ public:
     {
         for (auto p : ptr)
         {
-            func(p);
+            if (p)
+            {
+                func(p);
+            }
         }
     }
     size_t count() const { return ptr.size(); }
     void memset(int value)
     {
         const size_t value_size = sizeof(value_t);
-        for (auto p : ptr)
-        {
-            ::memset(p, value, value_size);
-        }
+        for_each([value, value_size](value_t* p)
+            {
+                ::memset(p, value, value_size);
+            });
     }
 
 private:
@@ -167,6 +315,18 @@ public:
     {
     }
     void new_index(size_t i) { ptr[i] = pool->construct(); }
+    void delete_index(size_t i)
+    {
+        pool->destroy(ptr[i]);
+        ptr[i] = nullptr;
+    }
+    void new_bulk()
+    {
+        for (size_t i = 0; i < ptr.size(); i++)
+        {
+            new_index(i);
+        }
+    }
     void delete_all()
     {
         // boost pool cleans up all objects on destruction
@@ -182,17 +342,20 @@ public:
     {
         for (auto p : ptr)
         {
-            func(p);
+            if (p)
+            {
+                func(p);
+            }
         }
     }
     size_t count() const { return ptr.size(); }
     void memset(int value)
     {
         const size_t value_size = sizeof(value_t);
-        for (auto p : ptr)
-        {
-            ::memset(p, value, value_size);
-        }
+        for_each([value, value_size](value_t* p)
+            {
+                ::memset(p, value, value_size);
+            });
     }
 
 private:
@@ -215,7 +378,8 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
     // FixedObjectPool alloc+free bench
     {
         const auto block_size = num_allocs;
-        snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %s", Size, bench_test.name());
+        snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %s %zu", Size, bench_test.name(),
+            num_allocs);
         registry.emplace_back(label,
             [&bench_test, block_size, num_allocs](nonius::chronometer meter)
             {
@@ -232,8 +396,8 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
         static const size_t block_sizes[3] = {64, 128, 256};
         for (auto block_size : block_sizes)
         {
-            snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %zu byte blocks %s", Size,
-                block_size, bench_test.name());
+            snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %zu byte blocks %s %zu",
+                Size, block_size, bench_test.name(), num_allocs);
             registry.emplace_back(label,
                 [&bench_test, block_size, num_allocs](nonius::chronometer meter)
                 {
@@ -250,7 +414,8 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
     // BoostPoolHarness<SizedN> alloc+free bench
     {
         const auto block_size = num_allocs;
-        snprintf(label, label_size, "BoostPoolHarness<Sized<%zu>> %s", Size, bench_test.name());
+        snprintf(label, label_size, "BoostPoolHarness<Sized<%zu>> %s %zu", Size,
+            bench_test.name(), num_allocs);
         registry.emplace_back(label,
             [&bench_test, block_size, num_allocs](nonius::chronometer meter)
             {
@@ -267,7 +432,8 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
     // HeapAllocHarness<SizedN> alloc+free bench
     {
         const auto block_size = num_allocs;
-        snprintf(label, label_size, "HeapAllocHarness<Sized<%zu>> %s", Size, bench_test.name());
+        snprintf(label, label_size, BENCH_HEAP_NAME "Harness<Sized<%zu>> %s %zu", Size,
+            bench_test.name(), num_allocs);
         registry.emplace_back(label,
             [&bench_test, block_size, num_allocs](nonius::chronometer meter)
             {
@@ -281,6 +447,1058 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
 #endif // BENCH_HEAP_ALLOC
 }
 
+// registers a benchmark which deletes and reallocates objects spread across
+// every block of a full DynamicObjectPool. The cost per object should be the
+// same regardless of the number of blocks in the pool.
+template <size_t Size>
+void run_delete_for_blocks(
+    nonius::benchmark_registry& registry, size_t block_size, size_t num_blocks)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t num_deletes = 1000;
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %zu blocks delete+new", Size,
+        num_blocks);
+    registry.emplace_back(label,
+        [block_size, num_blocks](nonius::chronometer meter)
+        {
+            PoolT pool(static_cast<typename PoolT::index_t>(block_size));
+            const size_t count = block_size * num_blocks;
+            std::vector<SizedN*> ptr(count, nullptr);
+            for (auto& p : ptr)
+            {
+                p = pool.new_object();
+            }
+            // visit blocks from last to first so that new_object finds the
+            // freed entry in the first block it checks
+            const size_t stride = std::max<size_t>(1, count / num_deletes);
+            meter.measure([&pool, &ptr, count, stride]
+                {
+                    for (size_t i = 0; i < num_deletes; ++i)
+                    {
+                        SizedN*& p = ptr[count - 1 - (i * stride) % count];
+                        pool.delete_object(p);
+                        p = pool.new_object();
+                    }
+                    return num_deletes;
+                });
+            pool.delete_all();
+        });
+}
+
+// registers benchmarks which delete a scattered batch of objects spread over
+// many blocks and then create them again. The batch is deleted one by one in
+// a scattered order, with delete_objects in the same order, and with
+// delete_objects in address order, as when the batch is collected by
+// iterating the pool.
+template <size_t Size>
+void run_delete_batch(nonius::benchmark_registry& registry, size_t num_allocs, size_t num_deletes)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const char* const modes[] = {
+        "delete_object", "delete_objects scattered", "delete_objects sorted"};
+
+    for (int mode = 0; mode != 3; ++mode)
+    {
+        snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %s %zu of %zu", Size,
+            modes[mode], num_deletes, num_allocs);
+        registry.emplace_back(label,
+            [mode, num_allocs, num_deletes](nonius::chronometer meter)
+            {
+                // fill whole blocks so new objects reuse exactly the deleted
+                // entries and the batch holds the same pointers every run
+                PoolT pool(256);
+                std::vector<SizedN*> live(num_allocs, nullptr);
+                for (auto& p : live)
+                {
+                    p = pool.new_object();
+                }
+                // pick the deleted objects with a stride which is coprime
+                // with the count so blocks are visited in a scattered order
+                size_t stride = 2654435761u % num_allocs | 1;
+                while (BenchAllocScatteredFree::gcd(stride, num_allocs) != 1)
+                {
+                    stride -= 2;
+                }
+                std::vector<SizedN*> batch(num_deletes, nullptr);
+                for (size_t i = 0; i != num_deletes; ++i)
+                {
+                    batch[i] = live[i * stride % num_allocs];
+                }
+                if (mode == 2)
+                {
+                    std::sort(batch.begin(), batch.end(), std::less<SizedN*>());
+                }
+                const typename PoolT::index_t count =
+                    static_cast<typename PoolT::index_t>(num_deletes);
+                meter.measure([&pool, &batch, mode, count]
+                    {
+                        if (mode == 0)
+                        {
+                            for (SizedN* p : batch)
+                            {
+                                pool.delete_object(p);
+                            }
+                        }
+                        else
+                        {
+                            pool.delete_objects(batch.data(), count);
+                        }
+                        SizedN* last = nullptr;
+                        for (size_t i = 0; i != count; ++i)
+                        {
+                            last = pool.new_object();
+                        }
+                        return last;
+                    });
+                pool.delete_all();
+            });
+    }
+}
+
+// registers benchmarks which delete a small unsorted batch of objects from
+// far apart blocks of a pool with many blocks and then create them again,
+// one by one and with delete_objects. Grouping such a batch by block must
+// not cost a pass over every block.
+template <size_t Size>
+void run_delete_small_batch(
+    nonius::benchmark_registry& registry, size_t num_blocks, size_t num_deletes)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    static const size_t entries_per_block = 32;
+    char label[1024] = {};
+    static const char* const modes[] = {"delete_object", "delete_objects"};
+
+    for (int mode = 0; mode != 2; ++mode)
+    {
+        snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %s %zu in %zu blocks", Size,
+            modes[mode], num_deletes, num_blocks);
+        registry.emplace_back(label,
+            [mode, num_blocks, num_deletes](nonius::chronometer meter)
+            {
+                // fill whole blocks so new objects reuse exactly the deleted
+                // entries and the batch holds the same pointers every run
+                PoolT pool(entries_per_block);
+                std::vector<SizedN*> live(num_blocks * entries_per_block, nullptr);
+                for (auto& p : live)
+                {
+                    p = pool.new_object();
+                }
+                // take one object from blocks spread over the pool, in
+                // descending address order so the batch isn't sorted
+                std::vector<SizedN*> batch(num_deletes, nullptr);
+                for (size_t i = 0; i != num_deletes; ++i)
+                {
+                    batch[i] = live[(num_deletes - i) * (num_blocks / (num_deletes + 1))
+                        * entries_per_block];
+                }
+                const typename PoolT::index_t count =
+                    static_cast<typename PoolT::index_t>(num_deletes);
+                meter.measure([&pool, &batch, mode, count]
+                    {
+                        if (mode == 0)
+                        {
+                            for (SizedN* p : batch)
+                            {
+                                pool.delete_object(p);
+                            }
+                        }
+                        else
+                        {
+                            pool.delete_objects(batch.data(), count);
+                        }
+                        SizedN* last = nullptr;
+                        for (size_t i = 0; i != count; ++i)
+                        {
+                            last = pool.new_object();
+                        }
+                        return last;
+                    });
+                pool.delete_all();
+            });
+    }
+}
+
+/// Thread safe allocator wrappers used by the multi-threaded benchmarks
+template <typename T>
+class ConcurrentPoolAllocator
+{
+public:
+    typedef T value_t;
+    const char* name() const { return "ConcurrentObjectPool"; }
+    ConcurrentPoolAllocator(size_t block_size, size_t)
+        : pool(static_cast<typename ConcurrentObjectPool<T>::index_t>(block_size))
+    {
+    }
+    T* new_object() { return pool.new_object(); }
+    void delete_object(T* ptr) { pool.delete_object(ptr); }
+
+private:
+    ConcurrentObjectPool<T> pool;
+};
+
+template <typename T>
+class LockedPoolAllocator
+{
+public:
+    typedef T value_t;
+    const char* name() const { return "mutex+DynamicObjectPool"; }
+    LockedPoolAllocator(size_t block_size, size_t)
+        : pool(static_cast<typename DynamicObjectPool<T>::index_t>(block_size))
+    {
+    }
+    T* new_object()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pool.new_object();
+    }
+    void delete_object(T* ptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool.delete_object(ptr);
+    }
+
+private:
+    std::mutex mutex;
+    DynamicObjectPool<T> pool;
+};
+
+template <typename T>
+class LockFreeFixedPoolAllocator
+{
+public:
+    typedef T value_t;
+    typedef FixedObjectPool<T, LockFreeObjectPoolPolicy> PoolT;
+    const char* name() const { return "LockFreeFixedObjectPool"; }
+    LockFreeFixedPoolAllocator(size_t, size_t max_allocs)
+        : pool(static_cast<typename PoolT::index_t>(max_allocs))
+    {
+    }
+    T* new_object() { return pool.new_object(); }
+    void delete_object(T* ptr) { pool.delete_object(ptr); }
+
+private:
+    PoolT pool;
+};
+
+template <typename T>
+class LockedFixedPoolAllocator
+{
+public:
+    typedef T value_t;
+    const char* name() const { return "mutex+FixedObjectPool"; }
+    LockedFixedPoolAllocator(size_t, size_t max_allocs)
+        : pool(static_cast<typename FixedObjectPool<T>::index_t>(max_allocs))
+    {
+    }
+    T* new_object()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pool.new_object();
+    }
+    void delete_object(T* ptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool.delete_object(ptr);
+    }
+
+private:
+    std::mutex mutex;
+    FixedObjectPool<T> pool;
+};
+
+template <typename T>
+class HeapAllocator
+{
+public:
+    typedef T value_t;
+    const char* name() const { return BENCH_HEAP_NAME; }
+    HeapAllocator(size_t, size_t) {}
+    T* new_object() { return new T; }
+    void delete_object(T* ptr) { delete ptr; }
+};
+
+/// DynamicObjectPool owned by the producer thread, other threads return
+/// objects with remote_delete_object. Only usable by the producer/consumer
+/// benchmark as new_object must be called from a single thread.
+template <typename T>
+class RemoteFreePoolAllocator
+{
+public:
+    typedef T value_t;
+    const char* name() const { return "remote free DynamicObjectPool"; }
+    RemoteFreePoolAllocator(size_t block_size, size_t)
+        : pool(static_cast<typename DynamicObjectPool<T>::index_t>(block_size))
+    {
+    }
+    T* new_object() { return pool.new_object(); }
+    void delete_object(T* ptr) { pool.remote_delete_object(ptr); }
+
+private:
+    DynamicObjectPool<T> pool;
+};
+
+/// Bounded single producer single consumer queue of pointers
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+    bool push(T* ptr)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items[t % Capacity] = ptr;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    T* pop()
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        T* ptr = items[h % Capacity];
+        head.store(h + 1, std::memory_order_release);
+        return ptr;
+    }
+
+private:
+    T* items[Capacity];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+// registers a benchmark where each thread repeatedly allocates and then
+// frees a batch of objects using an allocator shared by all threads
+template <typename AllocatorT>
+void run_threaded(nonius::benchmark_registry& registry, size_t num_threads)
+{
+    typedef typename AllocatorT::value_t value_t;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t block_size = 256;
+    static const size_t batch_size = 256;
+    static const size_t num_rounds = 64;
+
+    snprintf(label, label_size, "%s<Sized<%zu>> %zu threads alloc+free",
+        AllocatorT(block_size, batch_size).name(), sizeof(value_t), num_threads);
+    registry.emplace_back(label,
+        [num_threads](nonius::chronometer meter)
+        {
+            AllocatorT allocator(block_size, num_threads * batch_size);
+            meter.measure([&allocator, num_threads]
+                {
+                    std::vector<std::thread> threads;
+                    for (size_t t = 0; t < num_threads; ++t)
+                    {
+                        threads.push_back(std::thread([&allocator]
+                            {
+                                value_t* ptr[batch_size];
+                                for (size_t round = 0; round < num_rounds; ++round)
+                                {
+                                    for (auto& p : ptr)
+                                    {
+                                        p = allocator.new_object();
+                                    }
+                                    for (auto p : ptr)
+                                    {
+                                        allocator.delete_object(p);
+                                    }
+                                }
+                            }));
+                    }
+                    for (auto& thread : threads)
+                    {
+                        thread.join();
+                    }
+                    return num_threads;
+                });
+        });
+}
+
+// registers a benchmark where one thread allocates objects and passes them
+// through a queue to another thread which frees them
+template <typename AllocatorT>
+void run_producer_consumer(nonius::benchmark_registry& registry)
+{
+    typedef typename AllocatorT::value_t value_t;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t block_size = 256;
+    static const size_t queue_size = 1024;
+    static const size_t num_objects = 100000;
+
+    snprintf(label, label_size, "%s<Sized<%zu>> producer/consumer",
+        AllocatorT(block_size, queue_size).name(), sizeof(value_t));
+    registry.emplace_back(label,
+        [](nonius::chronometer meter)
+        {
+            // the producer holds at most one object outside the queue and
+            // the consumer one more
+            AllocatorT allocator(block_size, queue_size + 2);
+            meter.measure([&allocator]
+                {
+                    SpscQueue<value_t, queue_size> queue;
+                    std::thread consumer([&allocator, &queue]
+                        {
+                            for (size_t i = 0; i < num_objects;)
+                            {
+                                if (value_t* ptr = queue.pop())
+                                {
+                                    allocator.delete_object(ptr);
+                                    ++i;
+                                }
+                                else
+                                {
+                                    std::this_thread::yield();
+                                }
+                            }
+                        });
+                    for (size_t i = 0; i < num_objects; ++i)
+                    {
+                        value_t* ptr = allocator.new_object();
+                        while (!queue.push(ptr))
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                    consumer.join();
+                    return num_objects;
+                });
+        });
+}
+
+template <size_t Size>
+void run_producer_consumer_for_size(nonius::benchmark_registry& registry)
+{
+    run_producer_consumer<ConcurrentPoolAllocator<Sized<Size> > >(registry);
+    run_producer_consumer<LockedPoolAllocator<Sized<Size> > >(registry);
+    run_producer_consumer<RemoteFreePoolAllocator<Sized<Size> > >(registry);
+    run_producer_consumer<LockFreeFixedPoolAllocator<Sized<Size> > >(registry);
+    run_producer_consumer<LockedFixedPoolAllocator<Sized<Size> > >(registry);
+    run_producer_consumer<HeapAllocator<Sized<Size> > >(registry);
+}
+
+/// Cycle counts of individual operations recorded by a latency benchmark,
+/// percentiles are printed when the benchmark registry is destroyed at exit
+/// as nonius runs each benchmark function several times.
+struct LatencySamples
+{
+    static const size_t max_samples = 1 << 22;
+
+    explicit LatencySamples(const char* label) : label(label) {}
+    ~LatencySamples()
+    {
+        print("new", new_cycles);
+        print("delete", delete_cycles);
+    }
+    void add(uint64_t new_cycle_count, uint64_t delete_cycle_count)
+    {
+        if (new_cycles.size() < max_samples)
+        {
+            new_cycles.push_back(new_cycle_count);
+            delete_cycles.push_back(delete_cycle_count);
+        }
+    }
+    void print(const char* op, std::vector<uint64_t>& cycles) const
+    {
+        if (cycles.empty())
+        {
+            return;
+        }
+        std::sort(cycles.begin(), cycles.end());
+        printf("%s: %s p50 %llu p99 %llu p999 %llu cycles\n", label.c_str(), op,
+            static_cast<unsigned long long>(cycles[cycles.size() / 2]),
+            static_cast<unsigned long long>(cycles[cycles.size() * 99 / 100]),
+            static_cast<unsigned long long>(cycles[cycles.size() * 999 / 1000]));
+    }
+
+    std::string label;
+    std::vector<uint64_t> new_cycles;
+    std::vector<uint64_t> delete_cycles;
+};
+
+// registers a benchmark which times individual new and delete calls in a
+// steady state where half of the objects are alive. Timings include the
+// overhead of reading the timestamp counter.
+template <typename HarnessT>
+void run_latency_percentiles(
+    nonius::benchmark_registry& registry, const char* name, size_t block_size, size_t num_allocs)
+{
+    typedef typename HarnessT::value_t value_t;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t num_ops = 1000;
+
+    snprintf(label, label_size, "%s<Sized<%zu>> new/delete latency %zu", name, sizeof(value_t),
+        num_allocs);
+    const std::shared_ptr<LatencySamples> samples = std::make_shared<LatencySamples>(label);
+    registry.emplace_back(label,
+        [samples, block_size, num_allocs](nonius::chronometer meter)
+        {
+            HarnessT harness(block_size, num_allocs);
+            const size_t num_live = num_allocs / 2;
+            for (size_t i = 0; i < num_live; i++)
+            {
+                harness.new_index(i);
+            }
+            size_t step = 0;
+            meter.measure([&harness, &samples, &step, num_live, num_allocs]
+                {
+                    for (size_t i = 0; i < num_ops; ++i, ++step)
+                    {
+                        const uint64_t t0 = detail::read_cycle_counter();
+                        harness.new_index((step + num_live) % num_allocs);
+                        const uint64_t t1 = detail::read_cycle_counter();
+                        harness.delete_index(step % num_allocs);
+                        const uint64_t t2 = detail::read_cycle_counter();
+                        samples->add(t1 - t0, t2 - t1);
+                    }
+                    return step;
+                });
+            harness.delete_all();
+        });
+}
+
+template <size_t Size>
+void run_latency_percentiles_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    run_latency_percentiles<ObjectPoolHarness<FixedObjectPool<SizedN> > >(
+        registry, "FixedObjectPool", num_allocs, num_allocs);
+    run_latency_percentiles<ObjectPoolHarness<DynamicObjectPool<SizedN> > >(
+        registry, "DynamicObjectPool", 256, num_allocs);
+#ifdef BENCH_BOOST_POOL
+    run_latency_percentiles<BoostPoolHarness<SizedN> >(
+        registry, "BoostPoolHarness", num_allocs, num_allocs);
+#endif // BENCH_BOOST_POOL
+#ifdef BENCH_HEAP_ALLOC
+    run_latency_percentiles<HeapAllocHarness<SizedN> >(
+        registry, BENCH_HEAP_NAME "Harness", num_allocs, num_allocs);
+#endif // BENCH_HEAP_ALLOC
+}
+
+template <size_t Size>
+void run_threaded_for_size(nonius::benchmark_registry& registry)
+{
+    const size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        run_threaded<ConcurrentPoolAllocator<Sized<Size> > >(registry, num_threads);
+        run_threaded<LockedPoolAllocator<Sized<Size> > >(registry, num_threads);
+        run_threaded<LockFreeFixedPoolAllocator<Sized<Size> > >(registry, num_threads);
+        run_threaded<LockedFixedPoolAllocator<Sized<Size> > >(registry, num_threads);
+        run_threaded<HeapAllocator<Sized<Size> > >(registry, num_threads);
+    }
+}
+
+// registers a benchmark which iterates over a pool after deleting entries at
+// random so only the given percentage of entries are still in use
+template <typename HarnessT>
+void run_for_each_occupancy(nonius::benchmark_registry& registry, const char* name,
+    size_t block_size, size_t num_allocs, size_t percent)
+{
+    typedef typename HarnessT::value_t value_t;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "%s<Sized<%zu>> for_each %zu%% occupancy", name, sizeof(value_t),
+        percent);
+    registry.emplace_back(label,
+        [block_size, num_allocs, percent](nonius::chronometer meter)
+        {
+            HarnessT harness(block_size, num_allocs);
+            std::minstd_rand rng(1234);
+            for (size_t i = 0; i < num_allocs; ++i)
+            {
+                harness.new_index(i);
+            }
+            for (size_t i = 0; i < num_allocs; ++i)
+            {
+                if (rng() % 100 >= percent)
+                {
+                    harness.delete_index(i);
+                }
+            }
+            meter.measure([&harness](int i)
+                {
+                    harness.memset(i);
+                    return i;
+                });
+            harness.delete_all();
+        });
+}
+
+template <size_t Size>
+void run_for_each_occupancy_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t percents[4] = {5, 20, 50, 100};
+    for (auto percent : percents)
+    {
+        run_for_each_occupancy<ObjectPoolHarness<FixedObjectPool<SizedN> > >(
+            registry, "FixedObjectPool", num_allocs, num_allocs, percent);
+        run_for_each_occupancy<ObjectPoolHarness<DynamicObjectPool<SizedN> > >(
+            registry, "DynamicObjectPool", 256, num_allocs, percent);
+        run_for_each_occupancy<
+            ObjectPoolHarness<FixedObjectPool<SizedN, DenseObjectPoolPolicy> > >(
+            registry, "DenseFixedObjectPool", num_allocs, num_allocs, percent);
+#ifdef BENCH_HEAP_ALLOC
+        run_for_each_occupancy<HeapAllocHarness<SizedN> >(
+            registry, BENCH_HEAP_NAME "Harness", num_allocs, num_allocs, percent);
+#endif // BENCH_HEAP_ALLOC
+    }
+}
+
+// registers a benchmark which creates a large FixedObjectPool and uses a few
+// entries, unused entries are initialised lazily so this only touches the
+// memory which is used
+void run_construct_large(nonius::benchmark_registry& registry, size_t num_entries)
+{
+    typedef FixedObjectPool<uint32_t> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "FixedObjectPool<uint32_t> construct %zu entries", num_entries);
+    registry.emplace_back(label,
+        [num_entries](nonius::chronometer meter)
+        {
+            meter.measure([num_entries]
+                {
+                    PoolT pool(static_cast<PoolT::index_t>(num_entries));
+                    uint32_t* p = pool.new_object(1u);
+                    pool.delete_all();
+                    return p;
+                });
+        });
+}
+
+// registers a benchmark which uses a DynamicObjectPool as per frame scratch
+// memory, filling it then emptying it with reset
+template <size_t Size>
+void run_frame_reset(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> frame fill and reset %zu", Size,
+        num_allocs);
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            PoolT pool(4096, ObjectPoolGrowth::geometric(65536));
+            meter.measure([&pool, num_allocs]
+                {
+                    SizedN* last = nullptr;
+                    for (size_t i = 0; i < num_allocs; ++i)
+                    {
+                        last = pool.new_object();
+                    }
+                    pool.reset();
+                    return last;
+                });
+        });
+}
+
+// registers a benchmark which fills an empty DynamicObjectPool from a single
+// small block, measuring the cost of growth when a pool warms up.
+template <size_t Size>
+void run_warm_up(nonius::benchmark_registry& registry, const char* name,
+    const ObjectPoolGrowth& growth, size_t block_size, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> %s growth warm up %zu", Size, name,
+        num_allocs);
+    registry.emplace_back(label,
+        [growth, block_size, num_allocs](nonius::chronometer meter)
+        {
+            std::vector<SizedN*> ptr(num_allocs, nullptr);
+            meter.measure([&ptr, &growth, block_size, num_allocs]
+                {
+                    PoolT pool(static_cast<typename PoolT::index_t>(block_size), growth);
+                    pool.new_objects(static_cast<typename PoolT::index_t>(num_allocs), ptr.data());
+                    pool.delete_all();
+                    return ptr[num_allocs - 1];
+                });
+        });
+}
+
+/// DynamicObjectPool which maps its blocks using huge pages
+template <typename T>
+class HugePageObjectPool : public DynamicObjectPool<T>
+{
+public:
+    HugePageObjectPool(typename DynamicObjectPool<T>::index_t entries_per_block)
+        : DynamicObjectPool<T>(
+              entries_per_block, ObjectPoolGrowth::fixed(), ObjectPoolBlockAllocator::huge_pages())
+    {
+    }
+};
+
+// registers for_each benchmarks of a large pool with heap and huge page
+// blocks, huge pages reduce TLB misses when visiting every block
+template <size_t Size>
+void run_for_each_huge_pages_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t percents[2] = {20, 100};
+    for (auto percent : percents)
+    {
+        run_for_each_occupancy<ObjectPoolHarness<DynamicObjectPool<SizedN> > >(
+            registry, "DynamicObjectPool", 4096, num_allocs, percent);
+        run_for_each_occupancy<ObjectPoolHarness<HugePageObjectPool<SizedN> > >(
+            registry, "HugePageObjectPool", 4096, num_allocs, percent);
+    }
+}
+
+/// Policy which prefetches entries ahead of for_each
+struct PrefetchObjectPoolPolicy : CacheAlignedObjectPoolPolicy
+{
+    static const unsigned prefetch_distance = 8;
+};
+
+// registers for_each benchmarks of pools with default and cache line padded
+// entries, with and without prefetching
+template <size_t Size>
+void run_for_each_layout_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t percents[2] = {50, 100};
+    for (auto percent : percents)
+    {
+        run_for_each_occupancy<ObjectPoolHarness<FixedObjectPool<SizedN> > >(
+            registry, "DefaultLayoutFixedObjectPool", num_allocs, num_allocs, percent);
+        run_for_each_occupancy<
+            ObjectPoolHarness<FixedObjectPool<SizedN, CacheAlignedObjectPoolPolicy> > >(
+            registry, "CacheAlignedFixedObjectPool", num_allocs, num_allocs, percent);
+        run_for_each_occupancy<
+            ObjectPoolHarness<FixedObjectPool<SizedN, PrefetchObjectPoolPolicy> > >(
+            registry, "PrefetchFixedObjectPool", num_allocs, num_allocs, percent);
+    }
+}
+
+// registers benchmarks which look up random references to live and deleted
+// objects, using generational handles or a side map of live pointers
+template <size_t Size>
+void run_handle_lookup_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN, GenerationalObjectPoolPolicy> PoolT;
+    static const size_t label_size = 1024;
+    static const size_t num_lookups = 1000;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> resolve handle", Size);
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            PoolT pool(256);
+            std::vector<typename PoolT::handle_t> handles(num_allocs);
+            for (auto& h : handles)
+            {
+                h = pool.handle_of(pool.new_object());
+            }
+            // delete every other object so half the lookups fail
+            for (size_t i = 0; i < num_allocs; i += 2)
+            {
+                pool.delete_object(pool.resolve(handles[i]));
+            }
+            std::minstd_rand rng(1234);
+            meter.measure([&]
+                {
+                    size_t num_valid = 0;
+                    for (size_t i = 0; i < num_lookups; ++i)
+                    {
+                        num_valid += pool.resolve(handles[rng() % num_allocs]) != nullptr;
+                    }
+                    // the lookups have no side effects so would be optimised away
+                    nonius::keep_memory(&num_valid);
+                    return num_valid;
+                });
+            pool.delete_all();
+        });
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> unordered_map lookup", Size);
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            DynamicObjectPool<SizedN> pool(256);
+            std::unordered_map<uint64_t, SizedN*> live;
+            for (size_t i = 0; i < num_allocs; ++i)
+            {
+                live[i] = pool.new_object();
+            }
+            for (size_t i = 0; i < num_allocs; i += 2)
+            {
+                pool.delete_object(live[i]);
+                live.erase(i);
+            }
+            std::minstd_rand rng(1234);
+            meter.measure([&]
+                {
+                    size_t num_valid = 0;
+                    for (size_t i = 0; i < num_lookups; ++i)
+                    {
+                        num_valid += live.find(rng() % num_allocs) != live.end();
+                    }
+                    // the lookups have no side effects so would be optimised away
+                    nonius::keep_memory(&num_valid);
+                    return num_valid;
+                });
+            pool.delete_all();
+        });
+}
+
+/// Policy which allocates the lowest free entries first
+struct AddressOrderedObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool address_ordered = true;
+};
+
+// registers a benchmark which iterates over a pool after a long run of random
+// deletes and news, then reclaiming empty blocks. Address ordered pools gather
+// live objects in fewer blocks.
+template <typename PoolT>
+void run_for_each_after_churn(nonius::benchmark_registry& registry, const char* name,
+    size_t num_allocs)
+{
+    typedef typename PoolT::value_t value_t;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "%s<Sized<%zu>> for_each after churn", name, sizeof(value_t));
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            PoolT pool(256);
+            std::minstd_rand rng(1234);
+            std::vector<value_t*> live(num_allocs);
+            for (auto& p : live)
+            {
+                p = pool.new_object();
+            }
+            // shrink to a quarter of the objects then replace random objects
+            // many times over
+            for (size_t i = 0; i < num_allocs * 3 / 4; ++i)
+            {
+                const size_t index = rng() % live.size();
+                pool.delete_object(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            for (size_t i = 0; i < num_allocs * 10; ++i)
+            {
+                const size_t index = rng() % live.size();
+                pool.delete_object(live[index]);
+                live[index] = pool.new_object();
+            }
+            pool.reclaim_memory();
+            meter.measure([&pool](int i)
+                {
+                    pool.for_each([i](value_t* ptr) { ::memset(ptr, i, sizeof(value_t)); });
+                    return i;
+                });
+            pool.delete_all();
+        });
+}
+
+// registers a benchmark which visits groups of objects which are created and
+// deleted together, after a long run of replacing random groups. Creating the
+// members of a group with new_object_near keeps them in the same block.
+template <size_t Size, bool Near>
+void run_group_traversal_after_churn(nonius::benchmark_registry& registry, size_t num_groups)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t group_size = 8;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "DynamicObjectPool<Sized<%zu>> group traversal after churn %s",
+        Size, Near ? "new_object_near" : "new_object");
+    registry.emplace_back(label,
+        [num_groups](nonius::chronometer meter)
+        {
+            DynamicObjectPool<SizedN> pool(256);
+            std::minstd_rand rng(1234);
+            std::vector<SizedN*> groups(num_groups * group_size);
+            auto new_group = [&pool, &groups](size_t group)
+            {
+                SizedN** members = groups.data() + group * group_size;
+                members[0] = pool.new_object();
+                for (size_t i = 1; i < group_size; ++i)
+                {
+                    members[i] = Near ? pool.new_object_near(members[0]) : pool.new_object();
+                }
+            };
+            // groups are usually built up over time amongst other allocations
+            std::vector<SizedN*> noise;
+            for (size_t group = 0; group < num_groups; ++group)
+            {
+                new_group(group);
+                noise.push_back(pool.new_object());
+            }
+            for (size_t i = 0; i < num_groups * 10; ++i)
+            {
+                const size_t group = rng() % num_groups;
+                for (size_t j = 0; j < group_size; ++j)
+                {
+                    pool.delete_object(groups[group * group_size + j]);
+                }
+                const size_t index = rng() % noise.size();
+                pool.delete_object(noise[index]);
+                noise[index] = pool.new_object();
+                new_group(group);
+            }
+            meter.measure([&groups, &rng](int i)
+                {
+                    // visit the members of groups in random order
+                    for (size_t n = 0; n < 1000; ++n)
+                    {
+                        SizedN** members = groups.data() + rng() % (groups.size() / group_size)
+                            * group_size;
+                        for (size_t j = 0; j < group_size; ++j)
+                        {
+                            ::memset(members[j], i, sizeof(SizedN));
+                        }
+                    }
+                    return i;
+                });
+            pool.delete_all();
+        });
+}
+
+/// A particle where the update step only touches position and velocity
+struct Particle
+{
+    float position[4];
+    float velocity[4];
+    uint8_t other[96];
+};
+
+// registers benchmarks which update the position of every particle from
+// its velocity, with particles stored as structs or in separate columns
+void run_soa_update(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "DynamicObjectPool<Particle> update %zu", num_allocs);
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            DynamicObjectPool<Particle> pool(4096);
+            for (size_t i = 0; i < num_allocs; ++i)
+            {
+                pool.new_object();
+            }
+            meter.measure([&pool]
+                {
+                    pool.for_each([](Particle* p)
+                        {
+                            for (int j = 0; j < 4; ++j)
+                            {
+                                p->position[j] += p->velocity[j];
+                            }
+                        });
+                    return pool.calc_stats().num_allocations;
+                });
+            pool.delete_all();
+        });
+
+    snprintf(label, label_size, "SoaObjectPool<Particle> update %zu", num_allocs);
+    registry.emplace_back(label,
+        [num_allocs](nonius::chronometer meter)
+        {
+            struct Vec4
+            {
+                float v[4];
+            };
+            struct Other
+            {
+                uint8_t other[96];
+            };
+            SoaObjectPool<Vec4, Vec4, Other> pool(4096);
+            for (size_t i = 0; i < num_allocs; ++i)
+            {
+                pool.new_object();
+            }
+            meter.measure([&pool]
+                {
+                    pool.for_each<0, 1>([](Vec4& position, const Vec4& velocity)
+                        {
+                            for (int j = 0; j < 4; ++j)
+                            {
+                                position.v[j] += velocity.v[j];
+                            }
+                        });
+                    return pool.calc_stats().num_allocations;
+                });
+            pool.delete_all();
+        });
+}
+
+// registers benchmarks which update every particle with parallel_for_each
+// on an increasing number of threads
+void run_parallel_update(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    std::vector<unsigned> thread_counts = {1, 2, 4};
+    const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    thread_counts.erase(std::remove_if(thread_counts.begin(), thread_counts.end(),
+                            [max_threads](unsigned n) { return n >= max_threads; }),
+        thread_counts.end());
+    thread_counts.push_back(max_threads);
+    for (unsigned num_threads : thread_counts)
+    {
+        snprintf(label, label_size, "DynamicObjectPool<Particle> parallel update %zu %u threads",
+            num_allocs, num_threads);
+        registry.emplace_back(label,
+            [num_allocs, num_threads](nonius::chronometer meter)
+            {
+                DynamicObjectPool<Particle> pool(4096);
+                for (size_t i = 0; i < num_allocs; ++i)
+                {
+                    pool.new_object();
+                }
+                ObjectPoolThreadExecutor executor(num_threads);
+                meter.measure([&pool, &executor]
+                    {
+                        pool.parallel_for_each([](Particle* p)
+                            {
+                                for (int j = 0; j < 4; ++j)
+                                {
+                                    p->position[j] += p->velocity[j];
+                                }
+                            },
+                            executor);
+                        return pool.calc_stats().num_allocations;
+                    });
+                pool.delete_all();
+            });
+    }
+}
+
 // Auto registers tests with Nonius on static constructon.
 struct BenchmarkRegistrar
 {
@@ -294,10 +1512,91 @@ struct BenchmarkRegistrar
         run_for_size<128, BenchAllocFree>(registry, num_allocs);
         run_for_size<512, BenchAllocFree>(registry, num_allocs);
 
+        // bench bulk alloc+free
+        run_for_size<16, BenchBulkAllocFree>(registry, num_allocs);
+        run_for_size<128, BenchBulkAllocFree>(registry, num_allocs);
+        run_for_size<512, BenchBulkAllocFree>(registry, num_allocs);
+
         // bench alloc+memset+free
         run_for_size<16, BenchAllocMemsetFree>(registry, num_allocs);
         run_for_size<128, BenchAllocMemsetFree>(registry, num_allocs);
         run_for_size<512, BenchAllocMemsetFree>(registry, num_allocs);
+
+        // bench random delete and new across many blocks
+        run_for_size<16, BenchChurn>(registry, 100000);
+        run_for_size<128, BenchChurn>(registry, 100000);
+
+        // bench individual frees and interleaved allocs and frees from small
+        // pools up to pools much larger than the caches
+        for (size_t count = 1000; count <= 10000000; count *= 10)
+        {
+            run_for_size<16, BenchAllocScatteredFree>(registry, count);
+            run_for_size<16, BenchSteadyState>(registry, count);
+        }
+
+        // bench the latency distribution of single operations
+        run_latency_percentiles_for_size<16>(registry, 100000);
+        run_latency_percentiles_for_size<128>(registry, 100000);
+
+        // bench iteration of sparse pools
+        run_for_each_occupancy_for_size<16>(registry, 100000);
+        run_for_each_occupancy_for_size<128>(registry, 100000);
+
+        // bench iteration with cache line aligned entries and prefetching
+        run_for_each_layout_for_size<16>(registry, 100000);
+        run_for_each_layout_for_size<128>(registry, 100000);
+        run_for_each_layout_for_size<512>(registry, 100000);
+
+        // bench iteration after long churn with address ordered allocation
+        run_for_each_after_churn<DynamicObjectPool<Sized<64> > >(
+            registry, "DynamicObjectPool", 100000);
+        run_for_each_after_churn<DynamicObjectPool<Sized<64>, AddressOrderedObjectPoolPolicy> >(
+            registry, "AddressOrderedDynamicObjectPool", 100000);
+
+        // bench visiting groups of related objects allocated with locality hints
+        run_group_traversal_after_churn<64, false>(registry, 10000);
+        run_group_traversal_after_churn<64, true>(registry, 10000);
+
+        // bench updating a few fields of large objects
+        run_soa_update(registry, 100000);
+
+        // bench scaling of iteration across threads
+        run_parallel_update(registry, 1000000);
+
+        // bench checking references to possibly deleted objects
+        run_handle_lookup_for_size<64>(registry, 100000);
+
+        // bench iteration of large pools with huge page blocks
+        run_for_each_huge_pages_for_size<64>(registry, 1000000);
+
+        // bench allocators shared between threads
+        run_threaded_for_size<16>(registry);
+        run_threaded_for_size<128>(registry);
+
+        // bench objects allocated on one thread and freed on another
+        run_producer_consumer_for_size<16>(registry);
+
+        // bench delete_object as the number of blocks grows
+        run_delete_for_blocks<16>(registry, 16, 10);
+        run_delete_for_blocks<16>(registry, 16, 1000);
+        run_delete_for_blocks<16>(registry, 16, 100000);
+
+        // bench freeing a scattered batch of objects at once
+        run_delete_batch<16>(registry, 1 << 20, 10000);
+        run_delete_batch<16>(registry, 1 << 20, 250000);
+        run_delete_small_batch<16>(registry, 100000, 4);
+        run_delete_small_batch<16>(registry, 100000, 64);
+
+        // bench creating a large pool
+        run_construct_large(registry, 1 << 24);
+
+        // bench a scratch pool which is filled and reset every frame
+        run_frame_reset<16>(registry, 1000);
+        run_frame_reset<16>(registry, 100000);
+
+        // bench filling an empty pool with fixed and geometric block growth
+        run_warm_up<16>(registry, "fixed", ObjectPoolGrowth::fixed(), 256, 1000000);
+        run_warm_up<16>(registry, "geometric", ObjectPoolGrowth::geometric(4096), 256, 1000000);
     }
 };
 BenchmarkRegistrar g_benchmark_registrar;
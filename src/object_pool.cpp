@@ -21,9 +21,32 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
 
 namespace detail
 {
@@ -48,309 +71,3510 @@ void aligned_free(void* ptr)
 #endif
 }
 
+/// Marks memory mapped by map_pages which isn't bound to a NUMA node
+const uint32_t ANY_NUMA_NODE = ~uint32_t(0);
+
+/// Asks the OS to place the physical pages of a mapping on the given NUMA
+/// node. This must be done before the pages are first touched. Pages are
+/// preferred rather than bound so allocation falls back to other nodes when
+/// the node is out of memory.
+void bind_to_numa_node(void* ptr, size_t size, uint32_t node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const int MPOL_PREFERRED_MODE = 1;
+    const size_t BITS_PER_MASK_WORD = sizeof(unsigned long) * 8;
+    unsigned long mask[16] = {};
+    if (node < sizeof(mask) * 8)
+    {
+        mask[node / BITS_PER_MASK_WORD] = 1ul << (node % BITS_PER_MASK_WORD);
+        // failure leaves the default first touch placement which is harmless
+        syscall(SYS_mbind, ptr, size, MPOL_PREFERRED_MODE, mask, sizeof(mask) * 8 + 1, 0);
+    }
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+#endif
+}
+
+/// Maps size bytes aligned to align directly from the OS, preferring huge
+/// pages. Size and alignment are rounded up to the huge page size. If node
+/// is not ANY_NUMA_NODE the pages are placed on that NUMA node.
+void* map_pages(size_t size, size_t align, bool explicit_pages, uint32_t node)
+{
+    const size_t page_size = ObjectPoolBlockAllocator::HUGE_PAGE_SIZE;
+    size = align_to(size, page_size);
+    align = std::max(align, page_size);
+#if defined(_WIN32)
+    // VirtualAllocExNuma takes a preferred node, fall back to the calling
+    // thread's node if none was given
+    const DWORD preferred_node = node == ANY_NUMA_NODE ? NUMA_NO_PREFERRED_NODE : node;
+    if (explicit_pages)
+    {
+        // large page allocations are aligned to the large page size and
+        // fail if the process lacks SeLockMemoryPrivilege
+        const size_t large_page_size = GetLargePageMinimum();
+        if (large_page_size != 0 && align <= large_page_size)
+        {
+            if (void* ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr,
+                    align_to(size, large_page_size), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                    PAGE_READWRITE, preferred_node))
+            {
+                return ptr;
+            }
+        }
+    }
+    // reserve enough address space to find an aligned range then map just
+    // that range, retrying if another thread takes the range in between
+    for (int attempt = 0; attempt != 4; ++attempt)
+    {
+        void* reserved = VirtualAlloc(nullptr, size + align, MEM_RESERVE, PAGE_NOACCESS);
+        if (!reserved)
+        {
+            return nullptr;
+        }
+        void* aligned = reinterpret_cast<void*>(
+            align_to(reinterpret_cast<uintptr_t>(reserved), align));
+        VirtualFree(reserved, 0, MEM_RELEASE);
+        if (void* ptr = VirtualAllocExNuma(GetCurrentProcess(), aligned, size,
+                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferred_node))
+        {
+            return ptr;
+        }
+    }
+    return nullptr;
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    bool use_explicit_pages = false;
+#if defined(MAP_HUGETLB)
+    if (explicit_pages)
+    {
+        flags |= MAP_HUGETLB;
+        use_explicit_pages = true;
+    }
+#else
+    (void)explicit_pages;
+#endif
+    // over allocate then unmap the unaligned head and tail. With explicit
+    // huge pages both are multiples of the huge page size so can be unmapped.
+    const size_t mapped_size = size + align;
+    void* mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        // fall back to transparent huge pages if none are reserved
+        if (!use_explicit_pages)
+        {
+            return nullptr;
+        }
+        return map_pages(size, align, false, node);
+    }
+    uint8_t* begin = static_cast<uint8_t*>(mapped);
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(align_to(reinterpret_cast<uintptr_t>(begin), align));
+    const size_t head_size = ptr - begin;
+    if (head_size != 0)
+    {
+        munmap(begin, head_size);
+    }
+    const size_t tail_size = mapped_size - head_size - size;
+    if (tail_size != 0)
+    {
+        munmap(ptr + size, tail_size);
+    }
+#if defined(MADV_HUGEPAGE)
+    if (!use_explicit_pages)
+    {
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+    if (node != ANY_NUMA_NODE)
+    {
+        bind_to_numa_node(ptr, size, node);
+    }
+    return ptr;
+#endif
+}
+
+/// Returns memory from map_pages to the OS
+void unmap_pages(void* ptr, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, align_to(size, ObjectPoolBlockAllocator::HUGE_PAGE_SIZE));
+#endif
+}
+
+uint32_t numa_node_count()
+{
+#if defined(_WIN32)
+    ULONG highest_node = 0;
+    return GetNumaHighestNodeNumber(&highest_node) ? highest_node + 1 : 1;
+#elif defined(__linux__)
+    // the possible node list is a range such as "0-3", or "0" without NUMA
+    static const uint32_t num_nodes = []
+    {
+        uint32_t count = 1;
+        if (FILE* file = std::fopen("/sys/devices/system/node/possible", "r"))
+        {
+            unsigned first = 0;
+            unsigned last = 0;
+            const int num_read = std::fscanf(file, "%u-%u", &first, &last);
+            if (num_read == 2)
+            {
+                count = last + 1;
+            }
+            else if (num_read == 1)
+            {
+                count = first + 1;
+            }
+            std::fclose(file);
+        }
+        return count;
+    }();
+    return num_nodes;
+#else
+    return 1;
+#endif
+}
+
+uint32_t current_numa_node()
+{
+#if defined(_WIN32)
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#elif defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? node : 0;
+#else
+    return 0;
+#endif
+}
+
+uint64_t next_pool_id()
+{
+    // zero is never used so it can mark an empty thread cache entry
+    static std::atomic<uint64_t> pool_id(0);
+    return ++pool_id;
+}
+
 /// Returns true if the pointer is of the given alignment
 inline bool is_aligned_to(const void* ptr, size_t align)
 {
     return (reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0;
 }
 
-} // namespace detail
+namespace
+{
+void* map_huge_pages(void*, size_t size, size_t align)
+{
+    return map_pages(size, align, false, ANY_NUMA_NODE);
+}
 
+void* map_explicit_huge_pages(void*, size_t size, size_t align)
+{
+    return map_pages(size, align, true, ANY_NUMA_NODE);
+}
 
-//
-// Tests
-//
+void* map_numa_node_pages(void* node, size_t size, size_t align)
+{
+    return map_pages(size, align, false, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(node)));
+}
 
-#if UNIT_TESTS
+void unmap_huge_pages(void*, void* ptr, size_t size)
+{
+    unmap_pages(ptr, size);
+}
+} // anonymous namespace
 
-#include "catch.hpp"
+const char POOL_FILE_MAGIC[8] = "OBJPOOL";
+const uint32_t POOL_FILE_VERSION = 1;
+/// Alignment of blocks in pool files. This is the allocation granularity of
+/// file mappings on Windows and a multiple of the page size elsewhere.
+const uint64_t POOL_FILE_ALIGN = 64 * 1024;
 
-namespace tests
+namespace
 {
+uint64_t align_file_offset(uint64_t offset)
+{
+    return (offset + POOL_FILE_ALIGN - 1) / POOL_FILE_ALIGN * POOL_FILE_ALIGN;
+}
 
-using detail::is_aligned_to;
-
-template <typename PoolT>
-void singleNewAndDelete(PoolT& mp)
+bool write_zeros(FILE* file, uint64_t count)
 {
-    uint32_t* p = mp.new_object(0xaabbccdd);
-    REQUIRE(p != nullptr);
-    CHECK(is_aligned_to(p, 4));
-    // should be aligned to the cache line size
-    // CHECK(is_aligned_to(p, MIN_BLOCK_ALIGN));
-    CHECK(*p == 0xaabbccdd);
-    mp.delete_object(p);
+    static const char zeros[4096] = {};
+    while (count != 0)
+    {
+        const size_t size = static_cast<size_t>(std::min<uint64_t>(count, sizeof(zeros)));
+        if (std::fwrite(zeros, 1, size, file) != size)
+        {
+            return false;
+        }
+        count -= size;
+    }
+    return true;
 }
 
-template <typename PoolT>
-void doubleNewAndDelete(PoolT& mp)
+bool same_layout(const PoolFileHeader& a, const PoolFileHeader& b)
 {
-    uint32_t* p1 = mp.new_object(0x11223344);
-    REQUIRE(p1 != nullptr);
-    CHECK(is_aligned_to(p1, 4));
-    uint32_t* p2 = mp.new_object(0x55667788);
-    REQUIRE(p2 != nullptr);
-    CHECK(is_aligned_to(p2, 4));
-    CHECK(p2 == p1 + 1);
-    CHECK(*p1 == 0x11223344);
-    mp.delete_object(p1);
-    CHECK(*p2 == 0x55667788);
-    mp.delete_object(p2);
+    return a.value_size == b.value_size && a.value_align == b.value_align
+        && a.policy_flags == b.policy_flags && a.index_size == b.index_size
+        && a.handle_size == b.handle_size && a.max_entries_per_block == b.max_entries_per_block;
 }
 
-template <typename PoolT>
-void blockFillAndFree(PoolT& mp, size_t size)
+#if defined(_WIN32)
+/// Maps a view of a file at an address aligned to align, retrying if
+/// another thread takes the reserved range in between
+void* map_file_view(HANDLE mapping, bool shared, uint64_t offset, size_t size, size_t align)
 {
-    std::vector<uint32_t*> v;
-    for (size_t i = 0; i < size; ++i)
+    for (int attempt = 0; attempt != 4; ++attempt)
     {
-        uint32_t* p = mp.new_object(1 << i);
-        REQUIRE(p != nullptr);
-        CHECK(*p == 1u << i);
-        v.push_back(p);
+        void* reserved = VirtualAlloc(nullptr, size + align, MEM_RESERVE, PAGE_NOACCESS);
+        if (!reserved)
+        {
+            return nullptr;
+        }
+        void* aligned = reinterpret_cast<void*>(
+            align_to(reinterpret_cast<uintptr_t>(reserved), align));
+        VirtualFree(reserved, 0, MEM_RELEASE);
+        if (void* ptr = MapViewOfFileEx(mapping, shared ? FILE_MAP_WRITE : FILE_MAP_COPY,
+                static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size, aligned))
+        {
+            return ptr;
+        }
     }
-
-    for (size_t i = 0; i < size; ++i)
+    return nullptr;
+}
+#else
+/// Maps part of a file at an address aligned to align by reserving enough
+/// address space to find an aligned range, mapping the file over it and
+/// unmapping the unaligned head and tail
+void* map_file_range(int fd, bool shared, uint64_t offset, size_t size, size_t align)
+{
+    const size_t reserved_size = size + align;
+    void* reserved =
+        mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
     {
-        mp.delete_object(v[i]);
+        return nullptr;
+    }
+    uint8_t* begin = static_cast<uint8_t*>(reserved);
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(align_to(reinterpret_cast<uintptr_t>(begin), align));
+    if (mmap(ptr, size, PROT_READ | PROT_WRITE, (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED, fd,
+            static_cast<off_t>(offset)) == MAP_FAILED)
+    {
+        munmap(reserved, reserved_size);
+        return nullptr;
+    }
+    const size_t head_size = ptr - begin;
+    if (head_size != 0)
+    {
+        munmap(begin, head_size);
+    }
+    const size_t tail_size = reserved_size - head_size - size;
+    if (tail_size != 0)
+    {
+        munmap(ptr + size, tail_size);
     }
+    return ptr;
 }
+#endif
 
-template <typename PoolT>
-void iterateFullBlocks(PoolT& mp, const size_t size, const size_t expected_blocks)
+void unmap_pool_file_block(void*, void* ptr, size_t size)
 {
-    const size_t half_size = size >> 1;
-    std::vector<uint32_t*> v;
-    size_t i;
-    for (i = 0; i < size; ++i)
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+} // anonymous namespace
+
+bool write_pool_file(const char* path, PoolFileHeader& header, PoolFileBlock* blocks,
+    const void* const* block_ptrs)
+{
+    memcpy(header.magic, POOL_FILE_MAGIC, sizeof(header.magic));
+    header.version = POOL_FILE_VERSION;
+    header.header_size = sizeof(PoolFileHeader);
+    const uint64_t num_blocks = header.num_blocks;
+    const uint64_t table_end = sizeof(PoolFileHeader) + sizeof(PoolFileBlock) * num_blocks;
+    uint64_t offset = align_file_offset(table_end);
+    for (uint64_t i = 0; i != num_blocks; ++i)
     {
-        uint32_t* p = mp.new_object(1 << i);
-        REQUIRE(p != nullptr);
-        CHECK(*p == 1u << i);
-        v.push_back(p);
+        blocks[i].offset = offset;
+        offset = align_file_offset(offset + blocks[i].size);
     }
 
+    FILE* file = std::fopen(path, "wb");
+    if (!file)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == size);
-        CHECK(stats.num_blocks == expected_blocks);
+        return false;
     }
-
-    // check values
-    i = 0;
-    for (auto itr = v.begin(), end = v.end(); itr != end; ++itr)
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(blocks, sizeof(PoolFileBlock), num_blocks, file) == num_blocks;
+    uint64_t written = table_end;
+    for (uint64_t i = 0; ok && i != num_blocks; ++i)
     {
-        CHECK(**itr == 1u << i);
-        ++i;
+        const size_t size = static_cast<size_t>(blocks[i].size);
+        ok = write_zeros(file, blocks[i].offset - written)
+            && std::fwrite(block_ptrs[i], 1, size, file) == size;
+        written = blocks[i].offset + size;
     }
-
-    // delete every second entry
-    for (i = 1; i < size; i += 2)
+    // pad the last block so its last page can be mapped
+    ok = ok && write_zeros(file, offset - written);
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
     {
-        uint32_t* p = v[i];
-        v[i] = nullptr;
-        mp.delete_object(p);
+        std::remove(path);
     }
+    return ok;
+}
 
-    // check allocation count is reduced but block count is the same
+bool read_pool_file(const char* path, const PoolFileHeader& expected, PoolFileHeader& header,
+    std::vector<PoolFileBlock>& blocks)
+{
+    FILE* file = std::fopen(path, "rb");
+    if (!file)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == half_size);
-        CHECK(stats.num_blocks == expected_blocks);
+        return false;
     }
-
-    // check remaining objects
-    i = 0;
-    mp.for_each([&i](const uint32_t* itr)
-        {
-            CHECK(*itr == 1u << i);
-            i += 2;
-        });
-    /*
-       for (i = 0; i < size; i += 2)
-       {
-       CHECK(*v[i] == 1u << i);
-       }
-       */
-
-    // allocate 16 new entries (fill first block)
-    for (i = 1; i < half_size; i += 2)
+    // a file from a machine of the other byte order fails the version check
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, POOL_FILE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == POOL_FILE_VERSION && header.header_size == sizeof(PoolFileHeader)
+        && same_layout(header, expected) && header.num_blocks < ~uint32_t(0);
+    if (ok)
     {
-        CHECK(v[i] == nullptr);
-        v[i] = mp.new_object(1 << i);
+        blocks.resize(static_cast<size_t>(header.num_blocks));
+        ok = std::fread(blocks.data(), sizeof(PoolFileBlock), blocks.size(), file) == blocks.size();
     }
-
-    // check allocation and block count
+    std::fclose(file);
+    for (size_t i = 0; ok && i != blocks.size(); ++i)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == size - (half_size >> 1));
-        CHECK(stats.num_blocks == expected_blocks);
+        ok = blocks[i].offset % POOL_FILE_ALIGN == 0 && blocks[i].size != 0
+            && blocks[i].size <= std::numeric_limits<size_t>::max() / 2;
     }
+    return ok;
+}
 
-    // delete objects in second block
-    for (i = half_size; i < size; ++i)
+bool map_pool_file_blocks(const char* path, bool shared, size_t align,
+    const std::vector<PoolFileBlock>& blocks, std::vector<void*>& ptrs)
+{
+    ptrs.clear();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, shared ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
     {
-        uint32_t* p = v[i];
-        v[i] = nullptr;
-        mp.delete_object(p);
+        return false;
     }
-
-    // check that the empty block was freed
+    LARGE_INTEGER file_size;
+    HANDLE mapping = GetFileSizeEx(file, &file_size)
+        ? CreateFileMappingA(file, nullptr, shared ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, nullptr)
+        : nullptr;
+    bool ok = mapping != nullptr;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    align = std::max<size_t>(align, info.dwAllocationGranularity);
+    for (size_t i = 0; ok && i != blocks.size(); ++i)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == half_size);
-        CHECK(stats.num_blocks == expected_blocks);
+        const size_t size = static_cast<size_t>(blocks[i].size);
+        void* ptr = nullptr;
+        if (blocks[i].offset + size <= static_cast<uint64_t>(file_size.QuadPart))
+        {
+            ptr = map_file_view(mapping, shared, blocks[i].offset, size, align);
+        }
+        ok = ptr != nullptr;
+        if (ok)
+        {
+            ptrs.push_back(ptr);
+        }
     }
-
-    for (auto p : v)
+    // views keep the mapping alive once the handles are closed
+    if (mapping)
     {
-        mp.delete_object(p);
+        CloseHandle(mapping);
     }
-
+    CloseHandle(file);
+#else
+    const int fd = open(path, shared ? O_RDWR : O_RDONLY);
+    if (fd < 0)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == 0u);
-        CHECK(stats.num_blocks == expected_blocks);
+        return false;
+    }
+    struct stat file_stat;
+    bool ok = fstat(fd, &file_stat) == 0;
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    align = std::max(align, page_size);
+    for (size_t i = 0; ok && i != blocks.size(); ++i)
+    {
+        // blocks are padded in the file so whole pages can be mapped,
+        // mapping past the end would fault on access
+        const size_t size = align_to(static_cast<size_t>(blocks[i].size), page_size);
+        void* ptr = nullptr;
+        if (blocks[i].offset % page_size == 0
+            && blocks[i].offset + size <= static_cast<uint64_t>(file_stat.st_size))
+        {
+            ptr = map_file_range(fd, shared, blocks[i].offset, size, align);
+        }
+        ok = ptr != nullptr;
+        if (ok)
+        {
+            ptrs.push_back(ptr);
+        }
     }
+    // mappings keep the file open once the descriptor is closed
+    close(fd);
+#endif
+    if (!ok)
+    {
+        for (size_t i = 0; i != ptrs.size(); ++i)
+        {
+            unmap_pool_file_block(nullptr, ptrs[i], static_cast<size_t>(blocks[i].size));
+        }
+        ptrs.clear();
+    }
+    return ok;
 }
 
-TEST_CASE("FixedObjectPool single new and delete", "[fixedpool]")
+const ObjectPoolBlockAllocator& pool_file_allocator()
 {
-    FixedObjectPool<uint32_t> mp(64);
-    singleNewAndDelete(mp);
+    struct Allocator : ObjectPoolBlockAllocator
+    {
+        Allocator()
+        {
+            deallocate = unmap_pool_file_block;
+        }
+    };
+    static const Allocator allocator;
+    return allocator;
 }
 
-TEST_CASE("DynamicObjectPool single new and delete", "[dynamicpool]")
+} // namespace detail
+
+const size_t ObjectPoolBlockAllocator::HUGE_PAGE_SIZE;
+
+ObjectPoolBlockAllocator ObjectPoolBlockAllocator::heap()
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    singleNewAndDelete(mp);
+    return ObjectPoolBlockAllocator();
 }
 
-TEST_CASE("FixedObjectPool double new and delete", "[fixedpool]")
+ObjectPoolBlockAllocator ObjectPoolBlockAllocator::huge_pages(bool explicit_pages)
 {
-    FixedObjectPool<uint32_t> mp(64);
-    doubleNewAndDelete(mp);
+    ObjectPoolBlockAllocator allocator;
+    allocator.allocate = explicit_pages ? detail::map_explicit_huge_pages : detail::map_huge_pages;
+    allocator.deallocate = detail::unmap_huge_pages;
+    allocator.page_size = HUGE_PAGE_SIZE;
+    return allocator;
 }
 
-TEST_CASE("Dynamic pool double new and delete", "[dynamicpool]")
+ObjectPoolBlockAllocator ObjectPoolBlockAllocator::numa_node(index_t node)
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    doubleNewAndDelete(mp);
+    // user data holds the node number rather than pointing at anything
+    ObjectPoolBlockAllocator allocator;
+    allocator.allocate = detail::map_numa_node_pages;
+    allocator.deallocate = detail::unmap_huge_pages;
+    allocator.user_data = reinterpret_cast<void*>(static_cast<uintptr_t>(node));
+    allocator.page_size = HUGE_PAGE_SIZE;
+    return allocator;
 }
 
-TEST_CASE("FixedObjectPool block fill and free", "[fixedpool]")
+namespace detail
 {
-    FixedObjectPool<uint32_t> mp(64);
-    blockFillAndFree(mp, 64);
+void throw_bad_alloc()
+{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
 }
+} // namespace detail
 
-TEST_CASE("DynamicObjectPool block fill and free", "[dynamicpool]")
+const size_t ObjectPoolMemoryResource::MAX_POOLED_SIZE;
+const ObjectPoolMemoryResource::index_t ObjectPoolMemoryResource::NUM_SIZE_CLASSES;
+
+ObjectPoolMemoryResource::ObjectPoolMemoryResource(
+    index_t entries_per_block, index_t max_entries_per_block)
+    : pool8_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block)),
+      pool16_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block)),
+      pool32_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block)),
+      pool64_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block)),
+      pool128_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block)),
+      pool256_(entries_per_block, ObjectPoolGrowth::geometric(max_entries_per_block))
 {
-    DynamicObjectPool<uint32_t> mp(64);
+}
+
+ObjectPoolMemoryResource::~ObjectPoolMemoryResource()
+{
+    // storage is untyped so there is nothing to destruct
+    pool8_.delete_all();
+    pool16_.delete_all();
+    pool32_.delete_all();
+    pool64_.delete_all();
+    pool128_.delete_all();
+    pool256_.delete_all();
+}
+
+ObjectPoolMemoryResource::index_t ObjectPoolMemoryResource::size_class(
+    size_t bytes, size_t alignment)
+{
+    if (bytes > MAX_POOLED_SIZE || alignment > detail::MAX_RAW_ALIGN)
+    {
+        return NUM_SIZE_CLASSES;
+    }
+    // classes start at 8 bytes, storage of each class is aligned to the
+    // smaller of its size and MAX_RAW_ALIGN so covering the alignment is
+    // enough
+    const size_t size = std::max(std::max(bytes, alignment), size_t(8));
+    return static_cast<index_t>(detail::ceil_log2(size) - 3);
+}
+
+void* ObjectPoolMemoryResource::allocate(size_t bytes, size_t alignment)
+{
+    void* ptr = nullptr;
+    switch (size_class(bytes, alignment))
+    {
+    case 0:
+        ptr = pool8_.allocate();
+        break;
+    case 1:
+        ptr = pool16_.allocate();
+        break;
+    case 2:
+        ptr = pool32_.allocate();
+        break;
+    case 3:
+        ptr = pool64_.allocate();
+        break;
+    case 4:
+        ptr = pool128_.allocate();
+        break;
+    case 5:
+        ptr = pool256_.allocate();
+        break;
+    default:
+        ptr = detail::aligned_malloc(bytes, std::max(alignment, sizeof(void*)));
+        break;
+    }
+    if (ptr == nullptr)
+    {
+        detail::throw_bad_alloc();
+    }
+    return ptr;
+}
+
+void ObjectPoolMemoryResource::deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+    switch (size_class(bytes, alignment))
+    {
+    case 0:
+        pool8_.deallocate(static_cast<detail::RawStorage<8>*>(ptr));
+        break;
+    case 1:
+        pool16_.deallocate(static_cast<detail::RawStorage<16>*>(ptr));
+        break;
+    case 2:
+        pool32_.deallocate(static_cast<detail::RawStorage<32>*>(ptr));
+        break;
+    case 3:
+        pool64_.deallocate(static_cast<detail::RawStorage<64>*>(ptr));
+        break;
+    case 4:
+        pool128_.deallocate(static_cast<detail::RawStorage<128>*>(ptr));
+        break;
+    case 5:
+        pool256_.deallocate(static_cast<detail::RawStorage<256>*>(ptr));
+        break;
+    default:
+        detail::aligned_free(ptr);
+        break;
+    }
+}
+
+void ObjectPoolMemoryResource::reclaim_memory()
+{
+    pool8_.reclaim_memory();
+    pool16_.reclaim_memory();
+    pool32_.reclaim_memory();
+    pool64_.reclaim_memory();
+    pool128_.reclaim_memory();
+    pool256_.reclaim_memory();
+}
+
+ObjectPoolStats ObjectPoolMemoryResource::calc_stats() const
+{
+    const ObjectPoolStats class_stats[NUM_SIZE_CLASSES] = {pool8_.calc_stats(),
+        pool16_.calc_stats(), pool32_.calc_stats(), pool64_.calc_stats(), pool128_.calc_stats(),
+        pool256_.calc_stats()};
+    ObjectPoolStats stats;
+    for (const ObjectPoolStats& pool_stats : class_stats)
+    {
+        stats.num_blocks += pool_stats.num_blocks;
+        stats.num_allocations += pool_stats.num_allocations;
+        stats.peak_allocations += pool_stats.peak_allocations;
+        stats.num_free_blocks += pool_stats.num_free_blocks;
+        stats.bytes_reserved += pool_stats.bytes_reserved;
+        stats.bytes_in_use += pool_stats.bytes_in_use;
+    }
+    return stats;
+}
+
+const size_t SizeClassPool::GRANULARITY;
+const size_t SizeClassPool::MAX_SIZE;
+const SizeClassPool::index_t SizeClassPool::NUM_SIZE_CLASSES;
+
+SizeClassPool::SizeClassPool(size_t slab_size, const ObjectPoolBlockAllocator& allocator)
+    : slab_size_(slab_size), allocator_(allocator)
+{
+    assert((slab_size & (slab_size - 1)) == 0);
+    const size_t header_size = detail::align_to(sizeof(SlabHeader), sizeof(index_t));
+    for (index_t i = 0; i != NUM_SIZE_CLASSES; ++i)
+    {
+        // leave room for aligning the entries after the indices
+        SizeClass& size_class = classes_[i];
+        const size_t entry_size = (i + 1) * GRANULARITY;
+        const size_t entries_per_slab =
+            (slab_size - header_size - GRANULARITY) / (entry_size + sizeof(index_t));
+        assert(entries_per_slab >= 4);
+        size_class.free_slab_index_ = detail::INVALID_INDEX;
+        size_class.entries_per_slab_ = static_cast<index_t>(entries_per_slab);
+        size_class.entries_offset_ =
+            detail::align_to(header_size + entries_per_slab * sizeof(index_t), GRANULARITY);
+        size_class.num_allocations_ = 0;
+        size_class.peak_allocations_ = 0;
+    }
+}
+
+SizeClassPool::~SizeClassPool()
+{
+    // objects are untyped here, so live objects can't be destructed
+    for (SizeClass& size_class : classes_)
+    {
+        for (SlabInfo& info : size_class.slabs_)
+        {
+            allocator_.deallocate_block(info.slab_, slab_size_);
+        }
+    }
+}
+
+SizeClassPool::index_t* SizeClassPool::slab_indices(SlabHeader* slab)
+{
+    return reinterpret_cast<index_t*>(reinterpret_cast<uint8_t*>(slab) +
+                                      detail::align_to(sizeof(SlabHeader), sizeof(index_t)));
+}
+
+uint8_t* SizeClassPool::slab_entries(SlabHeader* slab) const
+{
+    return reinterpret_cast<uint8_t*>(slab) + classes_[slab->size_class_].entries_offset_;
+}
+
+bool SizeClassPool::add_slab(index_t size_class_index)
+{
+    SizeClass& size_class = classes_[size_class_index];
+    assert(size_class.free_slab_index_ == detail::INVALID_INDEX);
+    void* memory = allocator_.allocate_block(slab_size_, slab_size_);
+    if (!memory)
+    {
+        return false;
+    }
+    SlabHeader* slab = new (memory) SlabHeader{detail::FreeList<false>(0), size_class_index,
+        static_cast<index_t>(size_class.slabs_.size()), 0};
+    index_t* indices = slab_indices(slab);
+    for (index_t i = 0; i != size_class.entries_per_slab_; ++i)
+    {
+        indices[i] = i + 1;
+    }
+    SlabInfo info = {slab, size_class.free_slab_index_};
+    size_class.slabs_.push_back(info);
+    size_class.free_slab_index_ = slab->slab_index_;
+    return true;
+}
+
+void* SizeClassPool::allocate(size_t size)
+{
+    if (size > MAX_SIZE)
+    {
+        return nullptr;
+    }
+    const index_t size_class_index = size_class_of(size);
+    SizeClass& size_class = classes_[size_class_index];
+    // if no slabs have space then create a new one
+    if (size_class.free_slab_index_ == detail::INVALID_INDEX && !add_slab(size_class_index))
+    {
+        return nullptr;
+    }
+    SlabInfo& info = size_class.slabs_[size_class.free_slab_index_];
+    SlabHeader* slab = info.slab_;
+    const index_t index = slab->free_list_.pop(slab_indices(slab), size_class.entries_per_slab_);
+    assert(index != size_class.entries_per_slab_);
+    // remove the slab from the free list if it is full
+    if (++slab->num_allocations_ == size_class.entries_per_slab_)
+    {
+        size_class.free_slab_index_ = info.next_free_;
+    }
+    if (++size_class.num_allocations_ > size_class.peak_allocations_)
+    {
+        size_class.peak_allocations_ = size_class.num_allocations_;
+    }
+    return slab_entries(slab) + index * (size_class_index + 1) * GRANULARITY;
+}
+
+void SizeClassPool::deallocate(const void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    // find the owning slab from the pointer address
+    SlabHeader* slab =
+        reinterpret_cast<SlabHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~(slab_size_ - 1));
+    SizeClass& size_class = classes_[slab->size_class_];
+    const size_t offset = static_cast<const uint8_t*>(ptr) - slab_entries(slab);
+    const index_t index =
+        static_cast<index_t>(offset / ((slab->size_class_ + 1) * GRANULARITY));
+    assert(index < size_class.entries_per_slab_ && slab->num_allocations_ != 0);
+    slab->free_list_.push(slab_indices(slab), index);
+    // add the slab to the free list if it was full
+    if (slab->num_allocations_-- == size_class.entries_per_slab_)
+    {
+        size_class.slabs_[slab->slab_index_].next_free_ = size_class.free_slab_index_;
+        size_class.free_slab_index_ = slab->slab_index_;
+    }
+    --size_class.num_allocations_;
+}
+
+void SizeClassPool::reclaim_memory()
+{
+    for (SizeClass& size_class : classes_)
+    {
+        // free empty slabs, moving the last slab into each gap
+        std::vector<SlabInfo>& slabs = size_class.slabs_;
+        for (size_t i = 0; i < slabs.size();)
+        {
+            if (slabs[i].slab_->num_allocations_ != 0)
+            {
+                ++i;
+                continue;
+            }
+            allocator_.deallocate_block(slabs[i].slab_, slab_size_);
+            if (i + 1 != slabs.size())
+            {
+                slabs[i] = slabs.back();
+                slabs[i].slab_->slab_index_ = static_cast<index_t>(i);
+            }
+            slabs.pop_back();
+        }
+        // relink the remaining slabs with space
+        size_class.free_slab_index_ = detail::INVALID_INDEX;
+        for (size_t i = slabs.size(); i-- != 0;)
+        {
+            if (slabs[i].slab_->num_allocations_ != size_class.entries_per_slab_)
+            {
+                slabs[i].next_free_ = size_class.free_slab_index_;
+                size_class.free_slab_index_ = static_cast<index_t>(i);
+            }
+        }
+    }
+}
+
+ObjectPoolStats SizeClassPool::calc_class_stats(index_t size_class_index) const
+{
+    assert(size_class_index < NUM_SIZE_CLASSES);
+    const SizeClass& size_class = classes_[size_class_index];
+    ObjectPoolStats stats;
+    stats.num_blocks = size_class.slabs_.size();
+    stats.num_allocations = size_class.num_allocations_;
+    stats.peak_allocations = size_class.peak_allocations_;
+    for (const SlabInfo& info : size_class.slabs_)
+    {
+        stats.num_free_blocks += info.slab_->num_allocations_ == 0;
+    }
+    stats.bytes_reserved =
+        size_class.slabs_.size() * slab_size_ + size_class.slabs_.capacity() * sizeof(SlabInfo);
+    stats.bytes_in_use = size_class.num_allocations_ * (size_class_index + 1) * GRANULARITY;
+    return stats;
+}
+
+ObjectPoolStats SizeClassPool::calc_stats() const
+{
+    ObjectPoolStats stats;
+    for (index_t i = 0; i != NUM_SIZE_CLASSES; ++i)
+    {
+        const ObjectPoolStats class_stats = calc_class_stats(i);
+        stats.num_blocks += class_stats.num_blocks;
+        stats.num_allocations += class_stats.num_allocations;
+        stats.peak_allocations += class_stats.peak_allocations;
+        stats.num_free_blocks += class_stats.num_free_blocks;
+        stats.bytes_reserved += class_stats.bytes_reserved;
+        stats.bytes_in_use += class_stats.bytes_in_use;
+    }
+    return stats;
+}
+
+ObjectPoolThreadExecutor::ObjectPoolThreadExecutor(unsigned num_threads)
+    : run_(nullptr),
+      num_tasks_(0),
+      next_task_(0),
+      num_busy_(0),
+      call_id_(0),
+      stop_(false)
+{
+    for (unsigned i = 1; i < num_threads; ++i)
+    {
+        threads_.emplace_back(&ObjectPoolThreadExecutor::worker, this);
+    }
+}
+
+ObjectPoolThreadExecutor::~ObjectPoolThreadExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+unsigned ObjectPoolThreadExecutor::num_threads() const
+{
+    return static_cast<unsigned>(threads_.size()) + 1;
+}
+
+void ObjectPoolThreadExecutor::operator()(
+    size_t num_tasks, const std::function<void(size_t)>& run)
+{
+    if (threads_.empty() || num_tasks <= 1)
+    {
+        for (size_t i = 0; i != num_tasks; ++i)
+        {
+            run(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        run_ = &run;
+        num_tasks_ = num_tasks;
+        next_task_.store(0, std::memory_order_relaxed);
+        num_busy_ = threads_.size();
+        ++call_id_;
+    }
+    start_.notify_all();
+    run_tasks();
+
+    // wait for workers so none are left holding the task function
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return num_busy_ == 0; });
+    run_ = nullptr;
+}
+
+void ObjectPoolThreadExecutor::run_tasks()
+{
+    for (size_t i = next_task_.fetch_add(1); i < num_tasks_; i = next_task_.fetch_add(1))
+    {
+        (*run_)(i);
+    }
+}
+
+void ObjectPoolThreadExecutor::worker()
+{
+    uint64_t last_call_id = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [this, last_call_id] { return stop_ || call_id_ != last_call_id; });
+            if (stop_)
+            {
+                return;
+            }
+            last_call_id = call_id_;
+        }
+        run_tasks();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--num_busy_ == 0)
+        {
+            done_.notify_one();
+        }
+    }
+}
+
+const uint32_t ObjectPoolTelemetry::NUM_LATENCY_BUCKETS;
+
+uint64_t ObjectPoolTelemetry::percentile(
+    const uint64_t (&histogram)[NUM_LATENCY_BUCKETS], double fraction)
+{
+    uint64_t num_samples = 0;
+    for (uint32_t i = 0; i != NUM_LATENCY_BUCKETS; ++i)
+    {
+        num_samples += histogram[i];
+    }
+    if (num_samples == 0)
+    {
+        return 0;
+    }
+    // the first bucket which takes the running count to the wanted rank
+    const double rank = std::min(std::max(fraction, 0.0), 1.0) * static_cast<double>(num_samples);
+    uint64_t count = 0;
+    for (uint32_t i = 0; i != NUM_LATENCY_BUCKETS; ++i)
+    {
+        count += histogram[i];
+        if (count != 0 && static_cast<double>(count) >= rank)
+        {
+            return uint64_t(1) << i;
+        }
+    }
+    return uint64_t(1) << (NUM_LATENCY_BUCKETS - 1);
+}
+
+namespace
+{
+void append_histogram(std::string& out, const char* name,
+    const uint64_t (&histogram)[ObjectPoolTelemetry::NUM_LATENCY_BUCKETS])
+{
+    char buffer[32];
+    out += ",\"";
+    out += name;
+    out += "\":[";
+    for (uint32_t i = 0; i != ObjectPoolTelemetry::NUM_LATENCY_BUCKETS; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), i == 0 ? "%llu" : ",%llu",
+            static_cast<unsigned long long>(histogram[i]));
+        out += buffer;
+    }
+    out += "]";
+}
+} // anonymous namespace
+
+std::string ObjectPoolTelemetry::to_json() const
+{
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "{\"num_allocs\":%llu,\"num_frees\":%llu,\"num_failed_allocs\":%llu,"
+        "\"num_blocks_added\":%llu,\"num_blocks_freed\":%llu,\"num_blocks_scanned\":%llu,"
+        "\"peak_allocations\":%llu",
+        static_cast<unsigned long long>(num_allocs), static_cast<unsigned long long>(num_frees),
+        static_cast<unsigned long long>(num_failed_allocs),
+        static_cast<unsigned long long>(num_blocks_added),
+        static_cast<unsigned long long>(num_blocks_freed),
+        static_cast<unsigned long long>(num_blocks_scanned),
+        static_cast<unsigned long long>(peak_allocations));
+    std::string out = buffer;
+    append_histogram(out, "alloc_cycles", alloc_cycles);
+    append_histogram(out, "free_cycles", free_cycles);
+    out += "}";
+    return out;
+}
+
+ObjectPoolGrowth ObjectPoolGrowth::fixed()
+{
+    return ObjectPoolGrowth();
+}
+
+ObjectPoolGrowth ObjectPoolGrowth::geometric(index_t max_entries_per_block)
+{
+    ObjectPoolGrowth growth;
+    growth.mode = GEOMETRIC;
+    growth.max_entries_per_block = max_entries_per_block;
+    return growth;
+}
+
+ObjectPoolGrowth ObjectPoolGrowth::custom(
+    callback_t callback, void* user_data, index_t max_entries_per_block)
+{
+    ObjectPoolGrowth growth;
+    growth.mode = CUSTOM;
+    growth.max_entries_per_block = max_entries_per_block;
+    growth.callback = callback;
+    growth.user_data = user_data;
+    return growth;
+}
+
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <list>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace tests
+{
+
+using detail::is_aligned_to;
+
+template <typename PoolT>
+void singleNewAndDelete(PoolT& mp)
+{
+    uint32_t* p = mp.new_object(0xaabbccdd);
+    REQUIRE(p != nullptr);
+    CHECK(is_aligned_to(p, 4));
+    // should be aligned to the cache line size
+    // CHECK(is_aligned_to(p, MIN_BLOCK_ALIGN));
+    CHECK(*p == 0xaabbccdd);
+    mp.delete_object(p);
+}
+
+template <typename PoolT>
+void doubleNewAndDelete(PoolT& mp)
+{
+    uint32_t* p1 = mp.new_object(0x11223344);
+    REQUIRE(p1 != nullptr);
+    CHECK(is_aligned_to(p1, 4));
+    uint32_t* p2 = mp.new_object(0x55667788);
+    REQUIRE(p2 != nullptr);
+    CHECK(is_aligned_to(p2, 4));
+    CHECK(p2 == p1 + 1);
+    CHECK(*p1 == 0x11223344);
+    mp.delete_object(p1);
+    CHECK(*p2 == 0x55667788);
+    mp.delete_object(p2);
+}
+
+template <typename PoolT>
+void blockFillAndFree(PoolT& mp, size_t size)
+{
+    std::vector<uint32_t*> v;
+    for (size_t i = 0; i < size; ++i)
+    {
+        uint32_t* p = mp.new_object(1 << i);
+        REQUIRE(p != nullptr);
+        CHECK(*p == 1u << i);
+        v.push_back(p);
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+}
+
+template <typename PoolT>
+void iterateFullBlocks(PoolT& mp, const size_t size, const size_t expected_blocks)
+{
+    const size_t half_size = size >> 1;
+    std::vector<uint32_t*> v;
+    size_t i;
+    for (i = 0; i < size; ++i)
+    {
+        uint32_t* p = mp.new_object(1 << i);
+        REQUIRE(p != nullptr);
+        CHECK(*p == 1u << i);
+        v.push_back(p);
+    }
+
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // check values
+    i = 0;
+    for (auto itr = v.begin(), end = v.end(); itr != end; ++itr)
+    {
+        CHECK(**itr == 1u << i);
+        ++i;
+    }
+
+    // delete every second entry
+    for (i = 1; i < size; i += 2)
+    {
+        uint32_t* p = v[i];
+        v[i] = nullptr;
+        mp.delete_object(p);
+    }
+
+    // check allocation count is reduced but block count is the same
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == half_size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // check remaining objects
+    i = 0;
+    mp.for_each([&i](const uint32_t* itr)
+        {
+            CHECK(*itr == 1u << i);
+            i += 2;
+        });
+    /*
+       for (i = 0; i < size; i += 2)
+       {
+       CHECK(*v[i] == 1u << i);
+       }
+       */
+
+    // allocate 16 new entries (fill first block)
+    for (i = 1; i < half_size; i += 2)
+    {
+        CHECK(v[i] == nullptr);
+        v[i] = mp.new_object(1 << i);
+    }
+
+    // check allocation and block count
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == size - (half_size >> 1));
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // delete objects in second block
+    for (i = half_size; i < size; ++i)
+    {
+        uint32_t* p = v[i];
+        v[i] = nullptr;
+        mp.delete_object(p);
+    }
+
+    // check that the empty block was freed
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == half_size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == 0u);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+}
+
+template <typename PoolT>
+void bulkNewAndDelete(PoolT& mp, size_t size, size_t expected_allocs)
+{
+    std::vector<uint32_t*> v(size, nullptr);
+    const size_t count = mp.new_objects(static_cast<typename PoolT::index_t>(size), v.data(), 7u);
+    CHECK(count == expected_allocs);
+    CHECK(mp.calc_stats().num_allocations == expected_allocs);
+    for (size_t i = 0; i < count; ++i)
+    {
+        REQUIRE(v[i] != nullptr);
+        CHECK(*v[i] == 7u);
+    }
+    CHECK(std::set<uint32_t*>(v.begin(), v.begin() + count).size() == count);
+    // delete every third entry singly and the rest in bulk
+    for (size_t i = 0; i < count; i += 3)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    mp.delete_objects(v.data(), static_cast<typename PoolT::index_t>(count));
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    // space is available again
+    CHECK(mp.new_objects(static_cast<typename PoolT::index_t>(count), v.data(), 8u) == count);
+    mp.delete_objects(v.data(), static_cast<typename PoolT::index_t>(count));
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("FixedObjectPool bulk new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    bulkNewAndDelete(mp, 100, 64);
+}
+
+TEST_CASE("Lock free FixedObjectPool bulk new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> mp(200);
+    bulkNewAndDelete(mp, 100, 100);
+}
+
+TEST_CASE("DynamicObjectPool bulk new and delete", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(32);
+    bulkNewAndDelete(mp, 100, 100);
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_free_blocks == 4u);
+}
+
+TEST_CASE("FixedObjectPool single new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("DynamicObjectPool single new and delete", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("FixedObjectPool double new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    doubleNewAndDelete(mp);
+}
+
+TEST_CASE("Dynamic pool double new and delete", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    doubleNewAndDelete(mp);
+}
+
+TEST_CASE("FixedObjectPool block fill and free", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    blockFillAndFree(mp, 64);
+}
+
+TEST_CASE("DynamicObjectPool block fill and free", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
     blockFillAndFree(mp, 64);
 }
 
-TEST_CASE("DynamicObjectPool double block fill and free", "[dynamicpool]")
+TEST_CASE("DynamicObjectPool double block fill and free", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    blockFillAndFree(mp, 128);
+}
+
+TEST_CASE("DynamicObjectPool delete all", "[dynamicpool")
+{
+    std::vector<uint32_t*> v(128, nullptr);
+    DynamicObjectPool<uint32_t> mp(32);
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 64; ++i)
+    {
+        mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 64; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    for (size_t i = 0; i < 32; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 128u);
+    for (size_t i = 32; i < 96; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 128u);
+    for (size_t i = 0; i < 32; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 96u);
+    for (size_t i = 96; i < 128; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("DynamicObjectPool delete after reclaim", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v(128, nullptr);
+    DynamicObjectPool<uint32_t> mp(32);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    // empty the first and third blocks so reclaim shuffles the rest
+    for (size_t i = 0; i < 32; ++i)
+    {
+        mp.delete_object(v[i]);
+        mp.delete_object(v[i + 64]);
+        v[i] = nullptr;
+        v[i + 64] = nullptr;
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    // deleting from the moved blocks must find the right owner
+    for (size_t i = 96; i < 128; ++i)
+    {
+        CHECK(*v[i] == i);
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    for (size_t i = 32; i < 64; ++i)
+    {
+        CHECK(*v[i] == i);
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    // deleting nullptr is a no-op
+    mp.delete_object(nullptr);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("DynamicObjectPool reuses space in full blocks", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v(128, nullptr);
+    DynamicObjectPool<uint32_t> mp(32);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    // free one entry from the first and third blocks
+    uint32_t* p0 = v[5];
+    uint32_t* p2 = v[70];
+    mp.delete_object(p0);
+    mp.delete_object(p2);
+    // both holes should be filled before a new block is added
+    uint32_t* n0 = mp.new_object(0u);
+    uint32_t* n1 = mp.new_object(1u);
+    CHECK(((n0 == p0 && n1 == p2) || (n0 == p2 && n1 == p0)));
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    uint32_t* n2 = mp.new_object(2u);
+    CHECK(mp.calc_stats().num_blocks == 5u);
+    mp.delete_object(n2);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("DynamicObjectPool stats", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v(96, nullptr);
+    DynamicObjectPool<uint32_t> mp(32);
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_blocks == 1u);
+        CHECK(stats.num_free_blocks == 1u);
+        CHECK(stats.peak_allocations == 0u);
+        CHECK(stats.bytes_in_use == 0u);
+        CHECK(stats.bytes_reserved >= 32 * sizeof(uint32_t));
+    }
+    for (size_t i = 0; i < 96; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    const size_t reserved = mp.calc_stats().bytes_reserved;
+    for (size_t i = 0; i < 40; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_blocks == 3u);
+        CHECK(stats.num_allocations == 56u);
+        CHECK(stats.peak_allocations == 96u);
+        CHECK(stats.num_free_blocks == 1u);
+        CHECK(stats.bytes_in_use == 56 * sizeof(uint32_t));
+        CHECK(stats.bytes_reserved == reserved);
+    }
+    mp.reclaim_memory();
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_blocks == 2u);
+        CHECK(stats.num_free_blocks == 0u);
+        CHECK(stats.bytes_reserved < reserved);
+    }
+    mp.delete_all();
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == 0u);
+        CHECK(stats.peak_allocations == 96u);
+        CHECK(stats.num_free_blocks == 2u);
+    }
+}
+
+TEST_CASE("DynamicObjectPool geometric growth", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v(1000, nullptr);
+    DynamicObjectPool<uint32_t> mp(16, ObjectPoolGrowth::geometric(256));
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+    }
+    // blocks of 16, 16, 32, 64, 128 then 256 until there is enough space
+    CHECK(mp.calc_stats().num_blocks == 8u);
+    size_t num_visited = 0;
+    mp.for_each([&num_visited](const uint32_t*) { ++num_visited; });
+    CHECK(num_visited == v.size());
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        CHECK(*v[i] == i);
+        mp.delete_object(v[i]);
+    }
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == 0u);
+        CHECK(stats.num_free_blocks == 8u);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+}
+
+namespace
+{
+uint32_t growByFixedStep(void* user_data, uint32_t num_blocks, size_t capacity)
+{
+    uint32_t* num_calls = static_cast<uint32_t*>(user_data);
+    ++*num_calls;
+    CHECK(capacity == num_blocks * 8u + 24u);
+    return num_blocks == 1 ? 8 : 100;
+}
+}
+
+TEST_CASE("DynamicObjectPool custom growth", "[dynamicpool]")
+{
+    uint32_t num_calls = 0;
+    std::vector<uint32_t*> v(48, nullptr);
+    DynamicObjectPool<uint32_t> mp(32, ObjectPoolGrowth::custom(growByFixedStep, &num_calls, 16));
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    // the initial block has 32 entries, then the callback gives 8 and the
+    // second result is clamped to 16
+    CHECK(num_calls == 2u);
+    CHECK(mp.calc_stats().num_blocks == 3u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+namespace
+{
+struct CountingAllocator
+{
+    size_t num_blocks = 0;
+    size_t num_bytes = 0;
+
+    static void* allocate(void* user_data, size_t size, size_t align)
+    {
+        CountingAllocator* self = static_cast<CountingAllocator*>(user_data);
+        ++self->num_blocks;
+        self->num_bytes += size;
+        return detail::aligned_malloc(size, align);
+    }
+
+    static void deallocate(void* user_data, void* ptr, size_t size)
+    {
+        CountingAllocator* self = static_cast<CountingAllocator*>(user_data);
+        --self->num_blocks;
+        self->num_bytes -= size;
+        detail::aligned_free(ptr);
+    }
+};
+}
+
+TEST_CASE("DynamicObjectPool custom block allocator", "[dynamicpool]")
+{
+    CountingAllocator counter;
+    ObjectPoolBlockAllocator allocator;
+    allocator.allocate = CountingAllocator::allocate;
+    allocator.deallocate = CountingAllocator::deallocate;
+    allocator.user_data = &counter;
+    {
+        std::vector<uint32_t*> v(100, nullptr);
+        DynamicObjectPool<uint32_t> mp(32, ObjectPoolGrowth::fixed(), allocator);
+        CHECK(counter.num_blocks == 1u);
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            v[i] = mp.new_object(static_cast<uint32_t>(i));
+        }
+        CHECK(counter.num_blocks == 4u);
+        mp.delete_all();
+        mp.reclaim_memory();
+        // freed blocks are returned to the allocator
+        CHECK(counter.num_blocks == 1u);
+    }
+    CHECK(counter.num_blocks == 0u);
+    CHECK(counter.num_bytes == 0u);
+}
+
+TEST_CASE("DynamicObjectPool huge page blocks", "[dynamicpool]")
+{
+    const ObjectPoolBlockAllocator allocator = ObjectPoolBlockAllocator::huge_pages();
+    typedef detail::ObjectPoolBlock<uint32_t> Block;
+    DynamicObjectPool<uint32_t> mp(1000, ObjectPoolGrowth::fixed(), allocator);
+    // blocks are grown to fill a whole huge page
+    const size_t num_entries = Block::calc_entries_for_size(allocator.page_size);
+    CHECK(Block::calc_block_size(static_cast<uint32_t>(num_entries)) <= allocator.page_size);
+    CHECK(Block::calc_block_size(static_cast<uint32_t>(num_entries + 1)) > allocator.page_size);
+    std::vector<uint32_t*> v(num_entries + 1, nullptr);
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    CHECK(std::find(v.begin(), v.end(), nullptr) == v.end());
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    size_t num_mismatched = 0;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        num_mismatched += *v[i] != i;
+        mp.delete_object(v[i]);
+    }
+    CHECK(num_mismatched == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+}
+
+TEST_CASE("FixedObjectPool huge page block", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64, ObjectPoolBlockAllocator::huge_pages(true));
+    blockFillAndFree(mp, 32);
+}
+
+TEST_CASE("NumaObjectPool allocates from each node", "[numapool]")
+{
+    NumaObjectPool<uint32_t> mp(64);
+    const uint32_t num_nodes = mp.num_nodes();
+    REQUIRE(num_nodes >= 1u);
+    CHECK(mp.current_node() < num_nodes);
+
+    std::vector<uint32_t*> v;
+    for (uint32_t node = 0; node != num_nodes; ++node)
+    {
+        for (uint32_t i = 0; i != 100; ++i)
+        {
+            uint32_t* p = mp.new_object_on_node(node, i);
+            REQUIRE(p != nullptr);
+            CHECK(mp.node_of(p) == node);
+            v.push_back(p);
+        }
+        auto stats = mp.calc_node_stats(node);
+        CHECK(stats.num_allocations == 100u);
+        CHECK(stats.bytes_in_use == 100 * sizeof(uint32_t));
+    }
+    uint32_t* local = mp.new_object(0u);
+    REQUIRE(local != nullptr);
+    CHECK(mp.node_of(local) < num_nodes);
+    mp.delete_object(local);
+
+    CHECK(mp.calc_stats().num_allocations == v.size());
+    size_t num_visited = 0;
+    mp.for_each([&num_visited](const uint32_t*) { ++num_visited; });
+    CHECK(num_visited == v.size());
+
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+    mp.reclaim_memory();
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == 0u);
+        CHECK(stats.num_blocks == num_nodes);
+        CHECK(stats.peak_allocations >= v.size());
+    }
+}
+
+TEST_CASE("FixedObjectPool generational handles", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, GenerationalObjectPoolPolicy> mp(16);
+    uint32_t* p = mp.new_object(1u);
+    const uint64_t h = mp.handle_of(p);
+    CHECK(h != 0u);
+    CHECK(mp.is_valid(h));
+    CHECK(mp.resolve(h) == p);
+    mp.delete_object(p);
+    CHECK_FALSE(mp.is_valid(h));
+    CHECK(mp.resolve(h) == nullptr);
+    // the slot is reused with a new generation
+    uint32_t* q = mp.new_object(2u);
+    CHECK(q == p);
+    const uint64_t h2 = mp.handle_of(q);
+    CHECK(h2 != h);
+    CHECK_FALSE(mp.is_valid(h));
+    CHECK(mp.resolve(h2) == q);
+    mp.delete_all();
+    CHECK_FALSE(mp.is_valid(h2));
+    // zero and handles to unallocated entries are never valid
+    CHECK_FALSE(mp.is_valid(0u));
+    CHECK_FALSE(mp.is_valid(uint64_t(1) << 32 | 5));
+}
+
+TEST_CASE("DynamicObjectPool generational handles", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, GenerationalObjectPoolPolicy> mp(32);
+    std::vector<uint32_t*> v(100, nullptr);
+    std::vector<uint64_t> h(v.size(), 0);
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        h[i] = mp.handle_of(v[i]);
+    }
+    CHECK(std::set<uint64_t>(h.begin(), h.end()).size() == h.size());
+    size_t num_resolved = 0;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        num_resolved += mp.resolve(h[i]) == v[i];
+    }
+    CHECK(num_resolved == v.size());
+
+    // delete the last block, reclaiming it must not revalidate old handles
+    for (size_t i = 96; i < v.size(); ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 3u);
+    for (size_t i = 96; i < v.size(); ++i)
+    {
+        CHECK_FALSE(mp.is_valid(h[i]));
+        v[i] = mp.new_object(0u);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    for (size_t i = 96; i < v.size(); ++i)
+    {
+        CHECK_FALSE(mp.is_valid(h[i]));
+        CHECK(mp.is_valid(mp.handle_of(v[i])));
+    }
+
+    // blocks before a used block aren't moved by reclaim_memory
+    for (size_t i = 0; i < 64; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.resolve(h[64]) == v[64]);
+    CHECK_FALSE(mp.is_valid(h[0]));
+    mp.delete_all();
+    CHECK_FALSE(mp.is_valid(h[64]));
+}
+
+namespace
+{
+struct CompactHandlePolicy : GenerationalObjectPoolPolicy
+{
+    typedef uint32_t handle_t;
+};
+}
+
+TEST_CASE("DynamicObjectPool 32 bit handles", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, CompactHandlePolicy> mp(1024);
+    uint32_t* p = mp.new_object(1u);
+    const uint32_t h = mp.handle_of(p);
+    CHECK(mp.resolve(h) == p);
+    // 16 bits of position leave room for 64 blocks of 1024 entries
+    std::vector<uint32_t*> v;
+    while (uint32_t* q = mp.new_object(0u))
+    {
+        v.push_back(q);
+    }
+    CHECK(mp.calc_stats().num_blocks == 64u);
+    CHECK(v.size() == 64u * 1024u - 1u);
+    // generations wrap and skip zero
+    size_t num_zero_handles = 0;
+    for (int i = 0; i < 70000; ++i)
+    {
+        mp.delete_object(p);
+        p = mp.new_object(1u);
+        num_zero_handles += mp.handle_of(p) == 0u;
+    }
+    CHECK(num_zero_handles == 0u);
+    CHECK(mp.resolve(mp.handle_of(p)) == p);
+    mp.delete_all();
+}
+
+namespace
+{
+struct SmallIndexPolicy : DefaultObjectPoolPolicy
+{
+    typedef uint16_t index_t;
+};
+
+struct TinyIndexPolicy : DefaultObjectPoolPolicy
+{
+    typedef uint8_t index_t;
+};
+
+struct WideIndexPolicy : DefaultObjectPoolPolicy
+{
+    typedef uint64_t index_t;
+};
+
+struct SmallIndexGenerationalPolicy : GenerationalObjectPoolPolicy
+{
+    typedef uint16_t index_t;
+};
+
+struct SmallIndexLockFreePolicy : LockFreeObjectPoolPolicy
+{
+    typedef uint16_t index_t;
+};
+
+struct SmallIndexPrefetchPolicy : DefaultObjectPoolPolicy
+{
+    typedef uint16_t index_t;
+    static const unsigned prefetch_distance = 4;
+};
+
+template <typename Pool>
+size_t fill_and_check(Pool& mp)
+{
+    std::vector<uint32_t*> v;
+    while (uint32_t* p = mp.new_object(static_cast<uint32_t>(v.size())))
+    {
+        v.push_back(p);
+    }
+    size_t num_mismatches = 0;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        num_mismatches += *v[i] != i;
+    }
+    CHECK(num_mismatches == 0u);
+    for (size_t i = 0; i < v.size(); i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    CHECK(mp.calc_stats().num_allocations == v.size() / 2);
+    mp.delete_all();
+    return v.size();
+}
+
+template <typename Pool>
+size_t bulk_fill_and_check(Pool& mp, size_t count)
+{
+    typedef typename Pool::index_t index_t;
+    std::vector<uint32_t*> v(count, nullptr);
+    v.resize(mp.new_objects(static_cast<index_t>(count), v.data(), 7u));
+    size_t num_mismatches = 0;
+    for (uint32_t* p : v)
+    {
+        num_mismatches += *p != 7u;
+    }
+    CHECK(num_mismatches == 0u);
+    // delete every other object in one batch, skipping nulls
+    std::vector<const uint32_t*> ptrs;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        ptrs.push_back(i % 2 == 0 ? v[i] : nullptr);
+    }
+    mp.delete_objects(ptrs.data(), static_cast<index_t>(ptrs.size()));
+    CHECK(mp.calc_stats().num_allocations == v.size() / 2);
+    size_t num_visited = 0;
+    mp.for_each([&num_visited](const uint32_t* p) { num_visited += *p == 7u; });
+    CHECK(num_visited == v.size() / 2);
+    mp.delete_all();
+    return v.size();
+}
+}
+
+TEST_CASE("FixedObjectPool index types", "[fixedpool]")
+{
+    static_assert(sizeof(FixedObjectPool<uint32_t, SmallIndexPolicy>::index_t) == 2, "");
+    FixedObjectPool<uint32_t> mp32(1000);
+    FixedObjectPool<uint32_t, SmallIndexPolicy> mp16(1000);
+    FixedObjectPool<uint32_t, WideIndexPolicy> mp64(1000);
+    FixedObjectPool<uint32_t, SmallIndexLockFreePolicy> mplf(1000);
+    CHECK(fill_and_check(mp32) == 1000u);
+    CHECK(fill_and_check(mp16) == 1000u);
+    CHECK(fill_and_check(mp64) == 1000u);
+    CHECK(fill_and_check(mplf) == 1000u);
+    // smaller free list indices shrink the block
+    CHECK(mp16.calc_stats().bytes_reserved < mp32.calc_stats().bytes_reserved);
+    CHECK(mp32.calc_stats().bytes_reserved < mp64.calc_stats().bytes_reserved);
+    // the largest index is the end of the free list
+    FixedObjectPool<uint32_t, TinyIndexPolicy> mp8(254);
+    CHECK(fill_and_check(mp8) == 254u);
+
+    // bulk allocation takes every entry whatever the index type
+    CHECK(bulk_fill_and_check(mp16, 1000) == 1000u);
+    CHECK(bulk_fill_and_check(mplf, 1000) == 1000u);
+    CHECK(bulk_fill_and_check(mp8, 254) == 254u);
+    FixedObjectPool<uint32_t, SmallIndexPrefetchPolicy> mppf(1000);
+    CHECK(bulk_fill_and_check(mppf, 1000) == 1000u);
+}
+
+TEST_CASE("DynamicObjectPool index types", "[dynamicpool]")
+{
+    // block sizes are capped to fit the index type
+    DynamicObjectPool<uint32_t, TinyIndexPolicy> mp(16, ObjectPoolGrowth::geometric(1024));
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    // blocks of 16, 16, 32, 64, 128 then 254 until there is enough space
+    CHECK(mp.calc_stats().num_blocks == 12u);
+    size_t num_mismatches = 0;
+    for (uint32_t i = 0; i < v.size(); ++i)
+    {
+        num_mismatches += *v[i] != i;
+    }
+    CHECK(num_mismatches == 0u);
+    mp.delete_all();
+    CHECK(bulk_fill_and_check(mp, 2000) == 2000u);
+    CHECK(mp.calc_stats().num_blocks == 12u);
+    DynamicObjectPool<uint32_t, SmallIndexPrefetchPolicy> pp(256);
+    CHECK(bulk_fill_and_check(pp, 1000) == 1000u);
+
+    // generations stay 32 bit with small indices
+    DynamicObjectPool<uint32_t, SmallIndexGenerationalPolicy> gp(256);
+    uint32_t* p = gp.new_object(1u);
+    size_t num_stale_valid = 0;
+    for (int i = 0; i < 70000; ++i)
+    {
+        const auto h = gp.handle_of(p);
+        gp.delete_object(p);
+        p = gp.new_object(1u);
+        num_stale_valid += gp.is_valid(h);
+    }
+    CHECK(num_stale_valid == 0u);
+    CHECK(gp.resolve(gp.handle_of(p)) == p);
+    CHECK((gp.handle_of(p) >> 32) > 0xffffu);
+    gp.delete_all();
+}
+
+namespace
+{
+struct DenseGenerationalPolicy : GenerationalObjectPoolPolicy
+{
+    static const bool dense = true;
+};
+
+template <typename Pool>
+size_t count_dense_mismatches(const Pool& mp, const std::set<const uint32_t*>& live)
+{
+    std::set<const uint32_t*> visited;
+    size_t num_mismatches = 0;
+    mp.for_each([&](const uint32_t* p) { num_mismatches += !visited.insert(p).second; });
+    return num_mismatches + (visited != live);
+}
+}
+
+TEST_CASE("FixedObjectPool dense iteration", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, DenseObjectPoolPolicy> mp(1000);
+    CHECK(mp.calc_stats().bytes_reserved
+        > FixedObjectPool<uint32_t>(1000).calc_stats().bytes_reserved);
+    std::set<const uint32_t*> live;
+    std::minstd_rand rng(1234);
+    std::vector<uint32_t*> v;
+    size_t num_mismatches = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        if (!v.empty() && rng() % 3 == 0)
+        {
+            const size_t index = rng() % v.size();
+            live.erase(v[index]);
+            mp.delete_object(v[index]);
+            v[index] = v.back();
+            v.pop_back();
+        }
+        else if (uint32_t* p = mp.new_object(static_cast<uint32_t>(i)))
+        {
+            live.insert(p);
+            v.push_back(p);
+        }
+        if (i % 100 == 0)
+        {
+            num_mismatches += count_dense_mismatches(mp, live);
+        }
+    }
+    CHECK(num_mismatches == 0u);
+
+    // bulk allocation and deletion keep the live array in step
+    uint32_t* ptrs[100];
+    const detail::index_t num_allocated = mp.new_objects(100, ptrs, 7u);
+    for (detail::index_t i = 0; i < num_allocated; ++i)
+    {
+        live.insert(ptrs[i]);
+    }
+    CHECK(count_dense_mismatches(mp, live) == 0u);
+    mp.delete_objects(ptrs, num_allocated);
+    for (detail::index_t i = 0; i < num_allocated; ++i)
+    {
+        live.erase(ptrs[i]);
+    }
+    CHECK(count_dense_mismatches(mp, live) == 0u);
+
+    // the current entry may be deleted while iterating
+    mp.for_each([&](uint32_t* p)
+        {
+            if (*p % 2 == 0)
+            {
+                live.erase(p);
+                mp.delete_object(p);
+            }
+        });
+    CHECK(count_dense_mismatches(mp, live) == 0u);
+    CHECK(mp.calc_stats().num_allocations == live.size());
+    mp.delete_all();
+    CHECK(count_dense_mismatches(mp, std::set<const uint32_t*>()) == 0u);
+}
+
+TEST_CASE("DynamicObjectPool dense iteration", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, DenseGenerationalPolicy> mp(64);
+    std::set<const uint32_t*> live;
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        if (i % 5 != 0)
+        {
+            mp.delete_object(v[i]);
+        }
+        else
+        {
+            live.insert(v[i]);
+        }
+    }
+    CHECK(count_dense_mismatches(mp, live) == 0u);
+    const uint64_t h = mp.handle_of(v[5]);
+
+    // compaction moves entries between live arrays
+    std::map<const uint32_t*, const uint32_t*> moved;
+    mp.compact([&](const uint32_t* from, const uint32_t* to) { moved[from] = to; });
+    std::set<const uint32_t*> compacted;
+    for (auto p : live)
+    {
+        compacted.insert(moved.count(p) ? moved[p] : p);
+    }
+    CHECK(count_dense_mismatches(mp, compacted) == 0u);
+    CHECK(*mp.resolve(h) == 5u);
+    mp.delete_all();
+}
+
+namespace
+{
+template <size_t N>
+struct Bytes
+{
+    uint8_t bytes[N];
+};
+
+struct PrefetchPolicy : CacheAlignedObjectPoolPolicy
+{
+    static const bool generations = true;
+    static const unsigned prefetch_distance = 4;
+};
+
+struct DensePrefetchPolicy : DenseObjectPoolPolicy
+{
+    static const unsigned prefetch_distance = 4;
+};
+
+template <typename Pool>
+size_t count_straddling(Pool& mp, size_t num_entries)
+{
+    typedef typename Pool::value_t value_t;
+    std::vector<value_t*> v;
+    size_t num_straddling = 0;
+    for (size_t i = 0; i < num_entries; ++i)
+    {
+        value_t* p = mp.new_object();
+        const uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        const uintptr_t last = addr + sizeof(value_t) - 1;
+        num_straddling += sizeof(value_t) <= 64 ? addr / 64 != last / 64 : addr % 64 != 0;
+        v.push_back(p);
+    }
+    // padded entries are still found by for_each and freed by pointer
+    size_t num_visited = 0;
+    mp.for_each([&num_visited](value_t*) { ++num_visited; });
+    CHECK(num_visited == v.size());
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    return num_straddling;
+}
+}
+
+TEST_CASE("FixedObjectPool cache aligned entries", "[fixedpool]")
+{
+    FixedObjectPool<Bytes<24>, CacheAlignedObjectPoolPolicy> mp24(100);
+    FixedObjectPool<Bytes<100>, CacheAlignedObjectPoolPolicy> mp100(100);
+    FixedObjectPool<Bytes<128>, CacheAlignedObjectPoolPolicy> mp128(100);
+    CHECK(count_straddling(mp24, 100) == 0u);
+    CHECK(count_straddling(mp100, 100) == 0u);
+    CHECK(count_straddling(mp128, 100) == 0u);
+    // padding costs memory
+    FixedObjectPool<Bytes<24> > unpadded(100);
+    CHECK(count_straddling(unpadded, 100) != 0u);
+    CHECK(mp24.calc_stats().bytes_reserved > unpadded.calc_stats().bytes_reserved);
+    CHECK(mp24.calc_stats().bytes_reserved >= 100u * 32u);
+}
+
+TEST_CASE("DynamicObjectPool cache aligned entries with prefetch", "[dynamicpool]")
+{
+    DynamicObjectPool<Bytes<48>, PrefetchPolicy> mp(100);
+    CHECK(count_straddling(mp, 1000) == 0u);
+    Bytes<48>* p = mp.new_object();
+    CHECK(mp.resolve(mp.handle_of(p)) == p);
+    mp.delete_object(p);
+
+    // prefetching never reads past the visited entries
+    FixedObjectPool<uint32_t, DensePrefetchPolicy> dp(10);
+    uint32_t* q = dp.new_object(0u);
+    dp.new_object(1u);
+    dp.delete_object(q);
+    uint32_t sum = 0;
+    dp.for_each([&sum](const uint32_t* v) { sum += *v + 1; });
+    CHECK(sum == 2u);
+    dp.delete_all();
+}
+
+namespace
+{
+struct AddressOrderedPolicy : DefaultObjectPoolPolicy
+{
+    static const bool address_ordered = true;
+};
+}
+
+TEST_CASE("FixedObjectPool address ordered", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, AddressOrderedPolicy> mp(100);
+    std::vector<uint32_t*> v;
+    while (uint32_t* p = mp.new_object(0u))
+    {
+        v.push_back(p);
+    }
+    CHECK(v.size() == 100u);
+    size_t num_unordered = 0;
+    for (size_t i = 1; i < v.size(); ++i)
+    {
+        num_unordered += v[i] <= v[i - 1];
+    }
+    CHECK(num_unordered == 0u);
+
+    // freed entries are reused lowest address first whatever the order
+    // they were freed in
+    const size_t freed[] = {90, 3, 70, 64, 65, 10};
+    for (size_t i : freed)
+    {
+        mp.delete_object(v[i]);
+    }
+    uint32_t* ptrs[4];
+    CHECK(mp.new_objects(4, ptrs, 1u) == 4u);
+    CHECK(ptrs[0] == v[3]);
+    CHECK(ptrs[1] == v[10]);
+    CHECK(ptrs[2] == v[64]);
+    CHECK(ptrs[3] == v[65]);
+    CHECK(mp.new_object(1u) == v[70]);
+    mp.delete_objects(ptrs, 4);
+    CHECK(mp.new_object(1u) == v[3]);
+    CHECK(mp.calc_stats().num_allocations == 96u);
+    mp.delete_all();
+    CHECK(mp.new_object(1u) == v[0]);
+    mp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool address ordered", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, AddressOrderedPolicy> mp(64);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    // blocks with space are used lowest index first
+    mp.delete_object(v[200]);
+    mp.delete_object(v[10]);
+    mp.delete_object(v[140]);
+    CHECK(mp.new_object(0u) == v[10]);
+    CHECK(mp.new_object(0u) == v[140]);
+    CHECK(mp.new_object(0u) == v[200]);
+
+    // live objects gather in the lowest blocks so the rest can be reclaimed
+    for (size_t i = 1; i < v.size(); i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    size_t num_misplaced = 0;
+    for (size_t i = 1; i < 128; i += 2)
+    {
+        num_misplaced += mp.new_object(0u) != v[i];
+    }
+    CHECK(num_misplaced == 0u);
+    for (size_t i = 128; i < v.size(); i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 128u);
+    mp.delete_all();
+}
+
+template <typename PoolT>
+void delete_batch(bool sorted)
+{
+    PoolT mp(64);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    // delete every other object, visiting them out of order
+    std::vector<const uint32_t*> ptrs(3, nullptr);
+    for (size_t i = 0; i < 500; ++i)
+    {
+        ptrs.push_back(v[(i * 337) % 500 * 2 + 1]);
+    }
+    if (sorted)
+    {
+        std::sort(ptrs.begin(), ptrs.end(), std::less<const uint32_t*>());
+    }
+    mp.delete_objects(ptrs.data(), static_cast<typename PoolT::index_t>(ptrs.size()));
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 500u);
+    CHECK(stats.num_free_blocks == 0u);
+    uint64_t num_odd = 0;
+    mp.for_each([&num_odd](const uint32_t* p) { num_odd += *p % 2; });
+    CHECK(num_odd == 0u);
+
+    // emptied blocks are counted and the freed entries are reused before
+    // new blocks are added
+    ptrs.clear();
+    for (size_t i = 0; i < 64; i += 2)
+    {
+        ptrs.push_back(v[i]);
+    }
+    mp.delete_objects(ptrs.data(), static_cast<typename PoolT::index_t>(ptrs.size()));
+    CHECK(mp.calc_stats().num_free_blocks == 1u);
+    const ObjectPoolStats before = mp.calc_stats();
+    for (size_t i = 0; i < 532; ++i)
+    {
+        mp.new_object(0u);
+    }
+    stats = mp.calc_stats();
+    CHECK(stats.num_blocks == before.num_blocks);
+    CHECK(stats.num_allocations == 1000u);
+    mp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool delete batches", "[dynamicpool]")
+{
+    for (bool sorted : {false, true})
+    {
+        delete_batch<DynamicObjectPool<uint32_t>>(sorted);
+        delete_batch<DynamicObjectPool<uint32_t, AddressOrderedPolicy>>(sorted);
+        delete_batch<DynamicObjectPool<uint32_t, GenerationalObjectPoolPolicy>>(sorted);
+    }
+
+    // address ordered pools still use the lowest block with space first
+    DynamicObjectPool<uint32_t, AddressOrderedPolicy> mp(16);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    const uint32_t* ptrs[] = {v[50], nullptr, v[20], v[40]};
+    mp.delete_objects(ptrs, 4);
+    CHECK(mp.calc_stats().num_allocations == 61u);
+    CHECK(mp.new_object(0u) == v[20]);
+    CHECK(mp.new_object(0u) == v[40]);
+    CHECK(mp.new_object(0u) == v[50]);
+    mp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool new_object_near", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(16);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    // the most recently freed block is the one new_object would use
+    mp.delete_object(v[1]);
+    mp.delete_object(v[50]);
+    uint32_t* p = mp.new_object_near(v[0], 1u);
+    CHECK(p == v[1]);
+    CHECK(*p == 1u);
+    // a full hint block falls back to any block with space
+    CHECK(mp.new_object_near(v[2], 50u) == v[50]);
+    CHECK(mp.new_object_near(v[3], 64u) != nullptr);
+    CHECK(mp.calc_stats().num_blocks == 5u);
+    CHECK(mp.new_object_near(nullptr, 65u) != nullptr);
+    CHECK(mp.calc_stats().num_allocations == 66u);
+
+    // the free block list stays consistent when the hint fills a block
+    // which isn't at the front of it
+    mp.delete_object(v[5]);
+    mp.delete_object(v[20]);
+    mp.delete_object(v[40]);
+    CHECK(mp.new_object_near(v[21], 0u) == v[20]);
+    CHECK(mp.new_object_near(v[4], 0u) == v[5]);
+    CHECK(mp.new_object(0u) == v[40]);
+    p = mp.new_object(0u);
+    CHECK(mp.owns(p));
+    mp.delete_all();
+}
+
+namespace
+{
+/// Fills blocks with a pattern so tests can see which bytes a pool writes
+struct PatternAllocator
+{
+    static const uint8_t PATTERN = 0xa5;
+    uint8_t* last_block = nullptr;
+    size_t last_size = 0;
+
+    static void* allocate(void* user_data, size_t size, size_t align)
+    {
+        PatternAllocator* self = static_cast<PatternAllocator*>(user_data);
+        self->last_block = static_cast<uint8_t*>(detail::aligned_malloc(size, align));
+        self->last_size = size;
+        memset(self->last_block, PATTERN, size);
+        return self->last_block;
+    }
+
+    static void deallocate(void*, void* ptr, size_t) { detail::aligned_free(ptr); }
+
+    size_t count_written() const
+    {
+        return last_size - std::count(last_block, last_block + last_size, PATTERN);
+    }
+
+    ObjectPoolBlockAllocator block_allocator()
+    {
+        ObjectPoolBlockAllocator allocator;
+        allocator.allocate = allocate;
+        allocator.deallocate = deallocate;
+        allocator.user_data = this;
+        return allocator;
+    }
+};
+
+const uint8_t PatternAllocator::PATTERN;
+
+template <typename Pool>
+size_t count_unused_mismatches(Pool& mp)
+{
+    // entries are handed out in order, then freed entries are reused
+    std::vector<uint32_t*> v;
+    size_t num_mismatches = 0;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    for (size_t i = 0; i < v.size(); i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    size_t num_visited = 0;
+    mp.for_each([&](const uint32_t* p)
+        {
+            num_mismatches += *p % 2 != 1;
+            ++num_visited;
+        });
+    num_mismatches += num_visited != 100;
+    num_mismatches += std::distance(mp.begin(), mp.end()) != 100;
+    for (size_t i = 0; i < v.size(); i += 2)
+    {
+        num_mismatches += mp.new_object(0u) == nullptr;
+    }
+    num_mismatches += mp.calc_stats().num_allocations != 200;
+    mp.delete_all();
+    num_mismatches += mp.calc_stats().num_allocations != 0;
+    num_mismatches += mp.begin() != mp.end();
+    return num_mismatches;
+}
+}
+
+TEST_CASE("FixedObjectPool initialises entries lazily", "[fixedpool]")
+{
+    PatternAllocator pattern;
+    {
+        FixedObjectPool<uint32_t> mp(100000, pattern.block_allocator());
+        // only the block header is written on construction
+        CHECK(pattern.count_written() < 64u);
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            mp.new_object(i);
+        }
+        CHECK(pattern.count_written() < 128u);
+        mp.delete_all();
+        CHECK(pattern.count_written() < 128u);
+        CHECK(count_unused_mismatches(mp) == 0u);
+    }
+
+    // every block layout works on uninitialised memory
+    FixedObjectPool<uint32_t, GenerationalObjectPoolPolicy> gp(1000, pattern.block_allocator());
+    FixedObjectPool<uint32_t, DenseObjectPoolPolicy> dp(1000, pattern.block_allocator());
+    FixedObjectPool<uint32_t, AddressOrderedPolicy> ap(1000, pattern.block_allocator());
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> lp(1000, pattern.block_allocator());
+    CHECK(count_unused_mismatches(gp) == 0u);
+    CHECK(count_unused_mismatches(dp) == 0u);
+    CHECK(count_unused_mismatches(ap) == 0u);
+    CHECK(count_unused_mismatches(lp) == 0u);
+
+    // handles to unused entries never resolve and delete_all keeps the
+    // generations of used entries
+    CHECK(gp.resolve(1ull << 32 | 500) == nullptr);
+    uint32_t* p = gp.new_object(1u);
+    const uint64_t h = gp.handle_of(p);
+    gp.delete_all();
+    CHECK(gp.new_object(2u) == p);
+    CHECK_FALSE(gp.is_valid(h));
+    gp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool reset", "[dynamicpool]")
+{
+    // a scratch pool which is filled then reset repeatedly
+    DynamicObjectPool<uint64_t> mp(64, ObjectPoolGrowth::geometric(512));
+    const size_t block_size = mp.calc_stats().bytes_reserved;
+    size_t num_mismatches = 0;
+    for (uint64_t frame = 0; frame < 10; ++frame)
+    {
+        std::vector<uint64_t*> v;
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            v.push_back(mp.new_object(frame * 1000 + i));
+        }
+        for (uint64_t i = 0; i < v.size(); ++i)
+        {
+            num_mismatches += *v[i] != frame * 1000 + i;
+        }
+        mp.reset();
+        num_mismatches += mp.calc_stats().num_allocations != 0;
+        num_mismatches += mp.begin() != mp.end();
+    }
+    CHECK(num_mismatches == 0u);
+    // blocks of 64, 64, 128, 256 then 512 are all kept
+    CHECK(mp.calc_stats().num_blocks == 5u);
+    CHECK(mp.calc_stats().num_free_blocks == 5u);
+
+    // blocks past the retained size are freed, the first is always kept
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        mp.new_object(i);
+    }
+    mp.reset(block_size * 3);
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    mp.reset(0);
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.new_object(1u) != nullptr);
+    mp.reset();
+
+    // objects with destructors are destructed and handles are invalidated
+    DynamicObjectPool<std::unique_ptr<uint32_t>, GenerationalObjectPoolPolicy> gp(16);
+    std::vector<uint64_t> handles;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        handles.push_back(gp.handle_of(gp.new_object(new uint32_t(i))));
+    }
+    gp.reset(0);
+    size_t num_valid = 0;
+    for (auto h : handles)
+    {
+        num_valid += gp.is_valid(h);
+    }
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        gp.new_object(new uint32_t(i));
+    }
+    for (auto h : handles)
+    {
+        num_valid += gp.is_valid(h);
+    }
+    CHECK(num_valid == 0u);
+    gp.delete_all();
+}
+
+namespace
+{
+// times every operation so tests can count samples
+struct TelemetryEveryOpPolicy : TelemetryObjectPoolPolicy
+{
+    static const unsigned telemetry_sample_interval = 1;
+};
+
+struct LockFreeTelemetryPolicy : LockFreeObjectPoolPolicy
+{
+    static const bool telemetry = true;
+};
+
+uint64_t count_samples(const uint64_t (&histogram)[ObjectPoolTelemetry::NUM_LATENCY_BUCKETS])
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i != ObjectPoolTelemetry::NUM_LATENCY_BUCKETS; ++i)
+    {
+        count += histogram[i];
+    }
+    return count;
+}
+} // anonymous namespace
+
+TEST_CASE("FixedObjectPool telemetry", "[fixedpool]")
+{
+    // disabled telemetry has no storage
+    static_assert(std::is_empty<detail::TelemetryCounters<DefaultObjectPoolPolicy>>::value, "");
+
+    FixedObjectPool<uint32_t, TelemetryEveryOpPolicy> mp(4);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    CHECK(v[4] == nullptr);
+    mp.delete_object(v[0]);
+    mp.delete_object(v[1]);
+    uint32_t* ptrs[3];
+    CHECK(mp.new_objects(3, ptrs, 0u) == 2u);
+    mp.delete_objects(ptrs, 2);
+    mp.delete_all();
+
+    ObjectPoolTelemetry telemetry = mp.telemetry();
+    CHECK(telemetry.num_allocs == 6u);
+    CHECK(telemetry.num_failed_allocs == 2u);
+    CHECK(telemetry.num_frees == 6u);
+    CHECK(telemetry.num_blocks_added == 0u);
+    CHECK(telemetry.peak_allocations == 4u);
+    // only single object operations are timed
+    CHECK(count_samples(telemetry.alloc_cycles) == 5u);
+    CHECK(count_samples(telemetry.free_cycles) == 2u);
+    CHECK(ObjectPoolTelemetry::percentile(telemetry.alloc_cycles, 0.5) != 0u);
+    CHECK(ObjectPoolTelemetry::percentile(telemetry.alloc_cycles, 0.5)
+        <= ObjectPoolTelemetry::percentile(telemetry.alloc_cycles, 1.0));
+    CHECK(telemetry.to_json().find("\"num_allocs\":6,") != std::string::npos);
+    CHECK(telemetry.to_json().find("\"free_cycles\":[") != std::string::npos);
+
+    mp.reset_telemetry();
+    telemetry = mp.telemetry();
+    CHECK(telemetry.num_allocs == 0u);
+    CHECK(count_samples(telemetry.alloc_cycles) == 0u);
+    CHECK(ObjectPoolTelemetry::percentile(telemetry.alloc_cycles, 0.5) == 0u);
+}
+
+TEST_CASE("FixedObjectPool lock free telemetry", "[fixedpool]")
+{
+    static const uint32_t num_threads = 4;
+    static const uint32_t num_ops = 1000;
+    FixedObjectPool<uint64_t, LockFreeTelemetryPolicy> mp(num_threads);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&mp]
+            {
+                for (uint32_t i = 0; i < num_ops; ++i)
+                {
+                    mp.delete_object(mp.new_object(i));
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    ObjectPoolTelemetry telemetry = mp.telemetry();
+    CHECK(telemetry.num_allocs == num_threads * num_ops);
+    CHECK(telemetry.num_frees == num_threads * num_ops);
+    CHECK(telemetry.num_failed_allocs == 0u);
+    // one in telemetry_sample_interval operations is timed
+    const uint64_t num_samples =
+        count_samples(telemetry.alloc_cycles) + count_samples(telemetry.free_cycles);
+    CHECK(num_samples
+        == 2 * num_threads * num_ops / LockFreeTelemetryPolicy::telemetry_sample_interval);
+}
+
+TEST_CASE("DynamicObjectPool telemetry", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, TelemetryEveryOpPolicy> mp(16);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    ObjectPoolTelemetry telemetry = mp.telemetry();
+    CHECK(telemetry.num_allocs == 100u);
+    CHECK(telemetry.num_blocks_added == 7u);
+    // allocations which don't add a block visit the head of the free list,
+    // the first block is added by the constructor
+    CHECK(telemetry.num_blocks_scanned == 94u);
+    CHECK(count_samples(telemetry.alloc_cycles) == 100u);
+
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+    mp.reclaim_memory();
+    telemetry = mp.telemetry();
+    CHECK(telemetry.num_frees == 100u);
+    CHECK(telemetry.num_blocks_freed == 6u);
+    CHECK(count_samples(telemetry.free_cycles) == 100u);
+    CHECK(telemetry.peak_allocations == 100u);
+
+    // batches and delete_all are counted
+    mp.reset_telemetry();
+    uint32_t* ptrs[40];
+    CHECK(mp.new_objects(40, ptrs, 0u) == 40u);
+    mp.delete_objects(ptrs, 20);
+    mp.reset(0);
+    telemetry = mp.telemetry();
+    CHECK(telemetry.num_allocs == 40u);
+    CHECK(telemetry.num_frees == 40u);
+    CHECK(telemetry.num_blocks_added == 2u);
+    CHECK(telemetry.num_blocks_freed == 2u);
+    CHECK(telemetry.num_failed_allocs == 0u);
+    CHECK(count_samples(telemetry.alloc_cycles) == 0u);
+
+    // unordered batches are grouped so each block is visited once
+    for (uint32_t i = 0; i < 48; ++i)
+    {
+        v[i] = mp.new_object(i);
+    }
+    std::vector<const uint32_t*> interleaved;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        interleaved.push_back(v[i + 32]);
+        interleaved.push_back(nullptr);
+        interleaved.push_back(v[i]);
+        interleaved.push_back(v[i + 16]);
+    }
+    mp.reset_telemetry();
+    mp.delete_objects(interleaved.data(), static_cast<detail::index_t>(interleaved.size()));
+    telemetry = mp.telemetry();
+    CHECK(telemetry.num_frees == 48u);
+    CHECK(telemetry.num_blocks_scanned == 3u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+
+    // as are batches smaller than the number of blocks
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        v[i] = mp.new_object(i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    const uint32_t* small_batch[] = {v[40], v[0], v[41]};
+    mp.reset_telemetry();
+    mp.delete_objects(small_batch, 3);
+    telemetry = mp.telemetry();
+    CHECK(telemetry.num_frees == 3u);
+    CHECK(telemetry.num_blocks_scanned == 2u);
+    CHECK(mp.calc_stats().num_allocations == 61u);
+    mp.delete_all();
+}
+
+TEST_CASE("FixedObjectPool save and load", "[fixedpool]")
+{
+    const char* path = "object_pool_fixed_test.bin";
+    typedef FixedObjectPool<uint64_t, GenerationalObjectPoolPolicy> Pool;
+    std::vector<Pool::handle_t> handles;
+    {
+        Pool mp(1000);
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            handles.push_back(mp.handle_of(mp.new_object(i)));
+        }
+        for (size_t i = 0; i < handles.size(); i += 2)
+        {
+            mp.delete_object(mp.resolve(handles[i]));
+        }
+        REQUIRE(mp.save(path));
+        mp.delete_all();
+    }
+
+    // copy on write changes aren't written back to the file
+    for (int pass = 0; pass != 2; ++pass)
+    {
+        Pool mp(1000);
+        REQUIRE(mp.load(path));
+        CHECK(mp.calc_stats().num_allocations == 500u);
+        CHECK(mp.calc_stats().peak_allocations == 1000u);
+        size_t num_mismatched = 0;
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            const uint64_t* p = mp.resolve(handles[i]);
+            num_mismatched += i % 2 == 0 ? p != nullptr : p == nullptr || *p != i;
+        }
+        CHECK(num_mismatched == 0u);
+        *mp.resolve(handles[1]) = 42;
+        CHECK(mp.new_object(7u) != nullptr);
+        CHECK(mp.calc_stats().num_allocations == 501u);
+        mp.delete_all();
+    }
+
+    // shared changes are
+    {
+        Pool mp(1000);
+        REQUIRE(mp.load(path, true));
+        *mp.resolve(handles[1]) = 42;
+        mp.delete_object(mp.resolve(handles[3]));
+        mp.delete_object(mp.resolve(handles[5]));
+    }
+    {
+        Pool mp(1000);
+        REQUIRE(mp.load(path));
+        CHECK(*mp.resolve(handles[1]) == 42u);
+        CHECK(mp.resolve(handles[3]) == nullptr);
+        CHECK(mp.calc_stats().num_allocations == 498u);
+
+        // loading again replaces the mapped block
+        mp.delete_all();
+        REQUIRE(mp.load(path));
+        CHECK(mp.calc_stats().num_allocations == 498u);
+        mp.delete_all();
+    }
+
+    // files of other layouts are rejected leaving the pool usable
+    {
+        Pool mp(999);
+        CHECK_FALSE(mp.load(path));
+        CHECK_FALSE(mp.load("object_pool_missing_test.bin"));
+        CHECK(mp.new_object(1u) != nullptr);
+        mp.delete_all();
+    }
+    {
+        FixedObjectPool<uint64_t> mp(1000);
+        CHECK_FALSE(mp.load(path));
+    }
+    {
+        FixedObjectPool<uint32_t, GenerationalObjectPoolPolicy> mp(1000);
+        CHECK_FALSE(mp.load(path));
+    }
+    FILE* file = std::fopen(path, "r+b");
+    REQUIRE(file != nullptr);
+    std::fputc('X', file);
+    std::fclose(file);
+    {
+        Pool mp(1000);
+        CHECK_FALSE(mp.load(path));
+    }
+    std::remove(path);
+}
+
+TEST_CASE("DynamicObjectPool save and load", "[dynamicpool]")
+{
+    const char* path = "object_pool_dynamic_test.bin";
+    typedef DynamicObjectPool<uint32_t, GenerationalObjectPoolPolicy> Pool;
+    std::vector<Pool::handle_t> handles;
+    uint64_t sum = 0;
+    {
+        Pool mp(256, ObjectPoolGrowth::geometric(4096));
+        for (uint32_t i = 0; i < 20000; ++i)
+        {
+            handles.push_back(mp.handle_of(mp.new_object(i)));
+        }
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            if (i % 3 == 0)
+            {
+                mp.delete_object(mp.resolve(handles[i]));
+            }
+            else
+            {
+                sum += i;
+            }
+        }
+        CHECK(mp.calc_stats().num_blocks > 1u);
+        REQUIRE(mp.save(path));
+        mp.delete_all();
+    }
+
+    Pool mp(256, ObjectPoolGrowth::geometric(4096));
+    REQUIRE(mp.load(path));
+    const ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 13333u);
+    CHECK(stats.peak_allocations == 20000u);
+    CHECK(stats.num_free_blocks == 0u);
+    uint64_t loaded_sum = 0;
+    mp.for_each([&loaded_sum](const uint32_t* p) { loaded_sum += *p; });
+    CHECK(loaded_sum == sum);
+    size_t num_mismatched = 0;
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        const uint32_t* p = mp.resolve(handles[i]);
+        num_mismatched += i % 3 == 0 ? p != nullptr : p == nullptr || *p != i;
+    }
+    CHECK(num_mismatched == 0u);
+
+    // deleted entries are reused, then new blocks are added
+    for (uint32_t i = 0; i < 10000; ++i)
+    {
+        mp.new_object(i);
+    }
+    CHECK(mp.calc_stats().num_blocks > stats.num_blocks);
+
+    // mapped and allocated blocks can be freed
+    mp.reset(0);
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        num_mismatched += mp.is_valid(handles[i]);
+    }
+    CHECK(num_mismatched == 0u);
+
+    // files of other layouts are rejected
+    DynamicObjectPool<uint32_t, GenerationalObjectPoolPolicy> other(256);
+    CHECK_FALSE(other.load(path));
+    CHECK(other.calc_stats().num_blocks == 1u);
+    std::remove(path);
+}
+
+TEST_CASE("DynamicObjectPool compact", "[dynamicpool]")
+{
+    DynamicObjectPool<std::unique_ptr<uint32_t>> mp(16);
+    std::vector<std::unique_ptr<uint32_t>*> v;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        v.push_back(mp.new_object(new uint32_t(i)));
+    }
+    // leave a few objects scattered over all four blocks
+    std::vector<std::unique_ptr<uint32_t>*> live;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        if (i % 5 == 0)
+        {
+            live.push_back(v[i]);
+        }
+        else
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+
+    // an incremental step only moves up to the budget
+    size_t num_moved = 0;
+    auto relocate = [&](const std::unique_ptr<uint32_t>* from, std::unique_ptr<uint32_t>* to)
+    {
+        CHECK(from->get() == nullptr);
+        *std::find(live.begin(), live.end(), from) = to;
+        ++num_moved;
+    };
+    CHECK_FALSE(mp.compact(relocate, 2));
+    CHECK(num_moved == 2u);
+    while (!mp.compact(relocate, 2))
+    {
+    }
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_allocations == live.size());
+    CHECK(stats.num_blocks == 1u);
+    std::set<uint32_t> values;
+    for (auto p : live)
+    {
+        values.insert(**p);
+    }
+    CHECK(values.size() == live.size());
+    CHECK(*values.rbegin() == 60u);
+
+    // a compact pool has nothing to move
+    num_moved = 0;
+    CHECK(mp.compact(relocate));
+    CHECK(num_moved == 0u);
+    mp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool compact keeps empty blocks", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(16);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 96; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    // two objects in each of the first four blocks, the last two are empty
+    std::set<uint32_t*> live;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        if (i < 64 && i % 8 == 0)
+        {
+            live.insert(v[i]);
+        }
+        else
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    CHECK(mp.calc_stats().num_free_blocks == 2u);
+
+    // only the blocks emptied by compaction are freed
+    auto relocate = [&](const uint32_t* from, uint32_t* to)
+    {
+        live.erase(const_cast<uint32_t*>(from));
+        live.insert(to);
+    };
+    while (!mp.compact(relocate, 3))
+    {
+    }
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_blocks == 3u);
+    CHECK(stats.num_free_blocks == 2u);
+    CHECK(stats.num_allocations == 8u);
+    CHECK(stats.peak_allocations == 96u);
+    std::set<uint32_t> values;
+    for (auto p : live)
+    {
+        values.insert(*p);
+    }
+    CHECK(values.size() == 8u);
+    CHECK(*values.rbegin() == 56u);
+
+    // the free block list and counts were kept up to date while moving
+    for (uint32_t i = 0; i < 40; ++i)
+    {
+        mp.new_object(i);
+    }
+    stats = mp.calc_stats();
+    CHECK(stats.num_blocks == 3u);
+    CHECK(stats.num_free_blocks == 0u);
+    mp.new_object(0);
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    mp.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool compact generational handles", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t, GenerationalObjectPoolPolicy> mp(32);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 128; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    std::map<uint64_t, uint32_t> handles;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        if (i % 4 == 0)
+        {
+            handles[mp.handle_of(v[i])] = *v[i];
+        }
+        else
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    std::map<uint64_t, uint64_t> remap;
+    CHECK(mp.compact([&](const uint32_t* from, uint32_t* to)
+        {
+            remap[mp.handle_of(from)] = mp.handle_of(to);
+        }));
+    // objects only move towards the first block so the emptied trailing
+    // blocks are freed
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    size_t num_mismatches = 0;
+    for (auto& entry : handles)
+    {
+        auto it = remap.find(entry.first);
+        const uint64_t handle = it == remap.end() ? entry.first : it->second;
+        num_mismatches += it != remap.end() && mp.is_valid(entry.first);
+        const uint32_t* p = mp.resolve(handle);
+        num_mismatches += p == nullptr || *p != entry.second;
+    }
+    CHECK(num_mismatches == 0u);
+    mp.delete_all();
+}
+
+TEST_CASE("ObjectPoolAllocator node containers", "[memoryresource]")
+{
+    ObjectPoolMemoryResource resource(16);
+    {
+        std::list<uint32_t, ObjectPoolAllocator<uint32_t>> list(&resource);
+        std::map<uint32_t, uint64_t, std::less<uint32_t>,
+            ObjectPoolAllocator<std::pair<const uint32_t, uint64_t>>>
+            map(std::less<uint32_t>(), &resource);
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            list.push_back(i);
+            map[i] = i * 2;
+        }
+        CHECK(resource.calc_stats().num_allocations == 200u);
+        CHECK(map[50] == 100u);
+        list.remove_if([](uint32_t i) { return i % 2 == 0; });
+        CHECK(resource.calc_stats().num_allocations == 150u);
+
+        // allocations too large for the pools come from the heap
+        std::vector<uint32_t, ObjectPoolAllocator<uint32_t>> vec(&resource);
+        vec.resize(1000);
+        CHECK(resource.calc_stats().num_allocations == 150u);
+    }
+    CHECK(resource.calc_stats().num_allocations == 0u);
+    resource.reclaim_memory();
+
+    // pooled storage meets the requested alignment
+    size_t num_misaligned = 0;
+    std::vector<std::pair<void*, size_t>> ptrs;
+    for (size_t size = 1; size <= ObjectPoolMemoryResource::MAX_POOLED_SIZE; size += 7)
+    {
+        const size_t align = std::min<size_t>(16, size_t(1) << detail::ceil_log2(size));
+        void* ptr = resource.allocate(size, align);
+        num_misaligned += reinterpret_cast<uintptr_t>(ptr) % align != 0;
+        ptrs.push_back(std::make_pair(ptr, size));
+    }
+    CHECK(num_misaligned == 0u);
+    CHECK(resource.calc_stats().num_allocations == ptrs.size());
+    for (auto& ptr : ptrs)
+    {
+        resource.deallocate(ptr.first, ptr.second,
+            std::min<size_t>(16, size_t(1) << detail::ceil_log2(ptr.second)));
+    }
+    CHECK(resource.calc_stats().num_allocations == 0u);
+}
+
+#if OBJECT_POOL_HAS_PMR
+TEST_CASE("PmrObjectPoolResource pmr containers", "[memoryresource]")
+{
+    PmrObjectPoolResource resource(16);
+    {
+        std::pmr::list<uint32_t> list(&resource);
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            list.push_back(i);
+        }
+        CHECK(resource.pools().calc_stats().num_allocations == 100u);
+    }
+    CHECK(resource.pools().calc_stats().num_allocations == 0u);
+    CHECK(resource.is_equal(resource));
+}
+#endif
+
+namespace
+{
+template <size_t Size>
+struct Message
+{
+    Message(uint32_t id) : id(id) {}
+    uint32_t id;
+    uint8_t payload[Size - sizeof(uint32_t)];
+};
+}
+
+TEST_CASE("SizeClassPool mixed sizes", "[sizeclasspool]")
+{
+    SizeClassPool mp(4096);
+    CHECK(SizeClassPool::size_class_of(1) == 0u);
+    CHECK(SizeClassPool::size_class_of(16) == 0u);
+    CHECK(SizeClassPool::size_class_of(17) == 1u);
+    CHECK(SizeClassPool::size_class_of(512) == SizeClassPool::NUM_SIZE_CLASSES - 1);
+    CHECK(mp.allocate(SizeClassPool::MAX_SIZE + 1) == nullptr);
+    CHECK(mp.calc_stats().num_blocks == 0u);
+
+    // types of the same size class share slabs
+    std::vector<Message<20>*> small;
+    std::vector<Message<24>*> similar;
+    std::vector<Message<500>*> large;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        small.push_back(mp.new_object<Message<20>>(i));
+        similar.push_back(mp.new_object<Message<24>>(i));
+        large.push_back(mp.new_object<Message<500>>(i));
+    }
+    const ObjectPoolStats class_stats = mp.calc_class_stats(SizeClassPool::size_class_of(20));
+    CHECK(class_stats.num_allocations == 200u);
+    CHECK(mp.calc_class_stats(SizeClassPool::size_class_of(500)).num_allocations == 100u);
+    CHECK(mp.calc_stats().num_allocations == 300u);
+
+    size_t num_mismatches = 0;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        num_mismatches += small[i]->id != i || similar[i]->id != i || large[i]->id != i;
+        num_mismatches += reinterpret_cast<uintptr_t>(large[i]) % SizeClassPool::GRANULARITY != 0;
+    }
+    CHECK(num_mismatches == 0u);
+
+    // freed entries are reused and empty slabs are reclaimed
+    const size_t num_blocks = mp.calc_stats().num_blocks;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        mp.delete_object(large[i]);
+        large[i] = mp.new_object<Message<500>>(i + 1000);
+    }
+    CHECK(mp.calc_stats().num_blocks == num_blocks);
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        mp.delete_object(small[i]);
+        if (i % 2 == 0)
+        {
+            mp.delete_object(large[i]);
+        }
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_class_stats(SizeClassPool::size_class_of(500)).num_free_blocks == 0u);
+    CHECK(mp.calc_stats().num_allocations == 150u);
+    num_mismatches = 0;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        num_mismatches += similar[i]->id != i;
+        num_mismatches += i % 2 == 1 && large[i]->id != i + 1000;
+    }
+    CHECK(num_mismatches == 0u);
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        mp.delete_object(similar[i]);
+        if (i % 2 == 1)
+        {
+            mp.delete_object(large[i]);
+        }
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 0u);
+}
+
+TEST_CASE("SoaObjectPool new, get and delete", "[soapool]")
+{
+    typedef SoaObjectPool<float, uint8_t, std::string> PoolT;
+    PoolT mp(100);
+    const uint32_t e0 = mp.new_object(1.0f, uint8_t(2), "three");
+    const uint32_t e1 = mp.new_object();
+    REQUIRE(e0 != PoolT::INVALID_INDEX);
+    REQUIRE(e1 != PoolT::INVALID_INDEX);
+    CHECK(e0 != e1);
+    CHECK(mp.get<0>(e0) == 1.0f);
+    CHECK(mp.get<1>(e0) == 2u);
+    CHECK(mp.get<2>(e0) == "three");
+    CHECK(mp.get<2>(e1).empty());
+    // columns are stored in separate cache line aligned arrays
+    CHECK(detail::is_aligned_to(&mp.get<0>(e0) - (e0 & 127), detail::MIN_BLOCK_ALIGN));
+    const ptrdiff_t offset = &mp.get<0>(e1) - &mp.get<0>(e0);
+    CHECK(offset == ptrdiff_t(e1) - ptrdiff_t(e0));
+    mp.get<2>(e1) = "one";
+    mp.delete_object(e0);
+    CHECK(mp.calc_stats().num_allocations == 1u);
+    // the freed slot is reused
+    CHECK(mp.new_object(4.0f, uint8_t(5), "six") == e0);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("SoaObjectPool for_each columns", "[soapool]")
+{
+    SoaObjectPool<float, float, uint32_t> mp(64);
+    std::vector<uint32_t> entries;
+    for (uint32_t i = 0; i < 300; ++i)
+    {
+        entries.push_back(mp.new_object(float(i), 1.0f, i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 5u);
+    // delete some entries so both full and sparse bitmap words are visited
+    for (uint32_t i = 0; i < 300; i += 3)
+    {
+        mp.delete_object(entries[i]);
+    }
+    mp.for_each<0, 1>([](float& position, const float& velocity)
+        {
+            position += velocity;
+        });
+    size_t num_visited = 0;
+    size_t num_mismatched = 0;
+    mp.for_each<0, 2>([&](const float& position, const uint32_t& id)
+        {
+            ++num_visited;
+            num_mismatched += position != float(id) + 1.0f || id % 3 == 0;
+        });
+    CHECK(num_visited == 200u);
+    CHECK(num_mismatched == 0u);
+
+    auto stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 200u);
+    CHECK(stats.peak_allocations == 300u);
+    CHECK(stats.num_free_blocks == 0u);
+    CHECK(stats.bytes_in_use == 200u * (2 * sizeof(float) + sizeof(uint32_t)));
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_free_blocks == 5u);
+}
+
+TEST_CASE("StaticObjectPool new and delete", "[staticpool]")
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    blockFillAndFree(mp, 128);
+    static_assert(sizeof(StaticObjectPool<uint32_t, 64>::slot_t) == 1, "");
+    static_assert(sizeof(StaticObjectPool<uint32_t, 255>::slot_t) == 1, "");
+    static_assert(sizeof(StaticObjectPool<uint32_t, 256>::slot_t) == 2, "");
+    static_assert(sizeof(StaticObjectPool<uint32_t, 70000>::slot_t) == 4, "");
+
+    // a capacity which isn't a multiple of the bitmap word size
+    StaticObjectPool<std::unique_ptr<uint32_t>, 100> mp;
+    CHECK(mp.CAPACITY == 100u);
+    std::vector<std::unique_ptr<uint32_t>*> v;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        v.push_back(mp.new_object(new uint32_t(i)));
+    }
+    CHECK(mp.new_object(nullptr) == nullptr);
+    CHECK(mp.calc_stats().num_allocations == 100u);
+    CHECK(mp.owns(v[99]));
+    size_t num_misaligned = 0;
+    for (auto p : v)
+    {
+        num_misaligned += reinterpret_cast<uintptr_t>(p) % alignof(std::unique_ptr<uint32_t>);
+    }
+    CHECK(num_misaligned == 0u);
+
+    for (size_t i = 0; i < v.size(); i += 3)
+    {
+        mp.delete_object(v[i]);
+    }
+    uint32_t sum = 0;
+    size_t num_visited = 0;
+    mp.for_each([&](const std::unique_ptr<uint32_t>* p)
+        {
+            sum += **p;
+            ++num_visited;
+        });
+    CHECK(num_visited == 66u);
+    CHECK(mp.calc_stats().num_allocations == 66u);
+    CHECK(mp.calc_stats().peak_allocations == 100u);
+
+    // freed entries are reused
+    CHECK(mp.new_object(new uint32_t(0)) == v[99]);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    CHECK(mp.new_object(nullptr) == v[0]);
 }
 
-TEST_CASE("DynamicObjectPool delete all", "[dynamicpool")
+TEST_CASE("FixedObjectPool stats", "[fixedpool]")
 {
-    std::vector<uint32_t*> v(128, nullptr);
-    DynamicObjectPool<uint32_t> mp(32);
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
+    FixedObjectPool<uint32_t> mp(64);
+    uint32_t* p1 = mp.new_object(1u);
+    uint32_t* p2 = mp.new_object(2u);
+    mp.delete_object(p1);
+    auto stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 1u);
+    CHECK(stats.peak_allocations == 2u);
+    CHECK(stats.num_free_blocks == 0u);
+    CHECK(stats.bytes_in_use == sizeof(uint32_t));
+    CHECK(stats.bytes_reserved >= 64 * sizeof(uint32_t));
+    mp.delete_object(p2);
+    CHECK(mp.calc_stats().num_free_blocks == 1u);
+}
+
+TEST_CASE("FixedObjectPool iterate full block", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    iterateFullBlocks(mp, 64, 1);
+}
+
+TEST_CASE("FixedObjectPool iterate sparse block", "[fixedpool]")
+{
+    // a block size which isn't a multiple of the bitmap word size
+    static const size_t size = 200;
+    FixedObjectPool<uint32_t> mp(size);
+    std::vector<uint32_t*> v;
+    for (size_t i = 0; i < size; ++i)
+    {
+        v.push_back(mp.new_object(static_cast<uint32_t>(i)));
+    }
+    // keep entries either side of word boundaries and the last entry
+    const uint32_t keep[] = {0, 63, 64, 127, 128, 150, 199};
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (std::find(std::begin(keep), std::end(keep), i) == std::end(keep))
+        {
+            mp.delete_object(v[i]);
+            v[i] = nullptr;
+        }
+    }
+    std::vector<uint32_t> visited;
+    mp.for_each([&visited](const uint32_t* p)
+        {
+            visited.push_back(*p);
+        });
+    CHECK(visited == std::vector<uint32_t>(std::begin(keep), std::end(keep)));
+
+    // entries deleted by the callback are not visited
+    visited.clear();
+    mp.for_each([&mp, &v, &visited](uint32_t* p)
+        {
+            visited.push_back(*p);
+            if (*p == 63)
+            {
+                mp.delete_object(v[127]);
+                v[127] = nullptr;
+                mp.delete_object(v[64]);
+                v[64] = nullptr;
+            }
+        });
+    CHECK(visited == std::vector<uint32_t>({0, 63, 128, 150, 199}));
+    CHECK(mp.calc_stats().num_allocations == 5u);
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 1u);
     CHECK(mp.calc_stats().num_allocations == 0u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
+}
+
+TEST_CASE("FixedObjectPool iterators", "[fixedpool]")
+{
+    static const size_t size = 200;
+    FixedObjectPool<uint32_t> mp(size);
+    CHECK(mp.begin() == mp.end());
+    std::vector<uint32_t*> v;
+    for (size_t i = 0; i < size; ++i)
+    {
+        v.push_back(mp.new_object(static_cast<uint32_t>(i)));
+    }
+    const uint32_t keep[] = {0, 63, 64, 127, 128, 150, 199};
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (std::find(std::begin(keep), std::end(keep), i) == std::end(keep))
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    std::vector<uint32_t> visited;
+    for (uint32_t& value : mp)
+    {
+        visited.push_back(value);
+    }
+    CHECK(visited == std::vector<uint32_t>(std::begin(keep), std::end(keep)));
+
+    // iterators work with standard algorithms and stop early
+    const FixedObjectPool<uint32_t>& cmp = mp;
+    FixedObjectPool<uint32_t>::const_iterator it =
+        std::find_if(cmp.begin(), cmp.end(), [](uint32_t value) { return value > 100; });
+    REQUIRE(it != cmp.end());
+    CHECK(*it == 127u);
+    CHECK(std::distance(cmp.begin(), cmp.end()) == 7);
+
+    // deleting the current entry while iterating
+    for (FixedObjectPool<uint32_t>::iterator i = mp.begin(); i != mp.end();)
+    {
+        uint32_t* p = &*i++;
+        mp.delete_object(p);
+    }
+    CHECK(mp.begin() == mp.end());
     CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 64; ++i)
+}
+
+TEST_CASE("DynamicObjectPool iterators", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    CHECK(mp.begin() == mp.end());
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 256; ++i)
     {
-        mp.new_object(1 << i);
+        v.push_back(mp.new_object(i));
     }
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
+    // empty the second block and leave a few entries in the others
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        if (i % 64 == 63 && (i < 64 || i >= 128))
+        {
+            expected.push_back(i);
+        }
+        else
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    std::vector<uint32_t> visited(mp.begin(), mp.end());
+    CHECK(visited == expected);
+    size_t num_visited = 0;
+    DynamicObjectPool<uint32_t>::const_iterator it = mp.begin();
+    for (; it != mp.end(); ++it)
+    {
+        ++num_visited;
+    }
+    CHECK(num_visited == expected.size());
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 64; ++i)
+    CHECK(mp.begin() == mp.end());
+}
+
+TEST_CASE("DynamicObjectPool parallel for_each", "[dynamicpool]")
+{
+    static const uint32_t size = 1000;
+    DynamicObjectPool<uint32_t> mp(256);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < size; ++i)
     {
-        v[i] = mp.new_object(1 << i);
+        v.push_back(mp.new_object(i));
     }
-    for (size_t i = 0; i < 32; ++i)
+    for (uint32_t i = 0; i < size; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        if (i % 3 == 0)
+        {
+            mp.delete_object(v[i]);
+        }
     }
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 32u);
+
+    // every live entry is visited once for whole block and partial block
+    // tasks, with chunk sizes that aren't a multiple of the bitmap word
+    ObjectPoolThreadExecutor executor(4);
+    CHECK(executor.num_threads() == 4u);
+    const detail::index_t chunk_sizes[] = {0, 1, 100, 256};
+    for (detail::index_t chunk_size : chunk_sizes)
+    {
+        std::vector<std::atomic<uint32_t>> visits(size);
+        mp.parallel_for_each([&visits](const uint32_t* p) { ++visits[*p]; }, executor, chunk_size);
+        size_t num_mismatches = 0;
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            num_mismatches += visits[i].load() != (i % 3 == 0 ? 0u : 1u);
+        }
+        CHECK(num_mismatches == 0u);
+    }
+
+    // any callable taking the task count and function can be an executor
+    size_t num_tasks = 0;
+    size_t num_visited = 0;
+    mp.parallel_for_each([&num_visited](uint32_t*) { ++num_visited; },
+        [&num_tasks](size_t count, const std::function<void(size_t)>& run)
+        {
+            num_tasks = count;
+            for (size_t i = 0; i != count; ++i)
+            {
+                run(i);
+            }
+        },
+        64);
+    CHECK(num_tasks == 16u);
+    CHECK(num_visited == mp.calc_stats().num_allocations);
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 128; ++i)
+}
+
+TEST_CASE("DynamicObjectPool remote frees", "[dynamicpool]")
+{
+    DynamicObjectPool<uint64_t> mp(64);
+    std::vector<uint64_t*> v;
+    for (uint64_t i = 0; i < 256; ++i)
     {
-        v[i] = mp.new_object(1 << i);
+        v.push_back(mp.new_object(i));
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.collect_remote_frees() == 0u);
+
+    // delete every other object from several threads
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&mp, &v, t]
+            {
+                for (size_t i = t * 2; i < v.size(); i += 8)
+                {
+                    mp.remote_delete_object(v[i]);
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(mp.calc_stats().num_allocations == 256u);
+    CHECK(mp.collect_remote_frees() == 128u);
     CHECK(mp.calc_stats().num_allocations == 128u);
-    for (size_t i = 32; i < 96; ++i)
+
+    // new_object reuses remotely freed entries before adding a block
+    for (size_t i = 0; i < 128; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        mp.new_object(0u);
     }
     CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 1; i < v.size(); i += 2)
+    {
+        mp.remote_delete_object(v[i]);
+    }
     for (size_t i = 0; i < 128; ++i)
     {
-        v[i] = mp.new_object(1 << i);
+        mp.new_object(0u);
     }
     CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 128u);
-    for (size_t i = 0; i < 32; ++i)
+    CHECK(mp.calc_stats().num_allocations == 256u);
+
+    // so does new_objects
+    for (size_t i = 0; i < 64; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        mp.remote_delete_object(v[i]);
     }
+    CHECK(mp.new_objects(64, v.data(), uint64_t(1)) == 64u);
     CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 96u);
-    for (size_t i = 96; i < 128; ++i)
+    CHECK(mp.calc_stats().num_allocations == 256u);
+
+    // iterating a non-const pool collects pending frees first, so destructed
+    // objects aren't visited
+    for (size_t i = 0; i < 64; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        mp.remote_delete_object(v[i]);
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
+    size_t num_visited = 0;
+    mp.for_each([&num_visited](const uint64_t*) { ++num_visited; });
+    CHECK(num_visited == 192u);
+    CHECK(mp.collect_remote_frees() == 0u);
+    mp.remote_delete_object(v[64]);
+    CHECK(static_cast<size_t>(std::distance(mp.begin(), mp.end())) == 191u);
+    mp.remote_delete_object(v[65]);
+    std::atomic<size_t> num_parallel(0);
+    mp.parallel_for_each([&num_parallel](const uint64_t*) { ++num_parallel; },
+        [](size_t num_tasks, const std::function<void(size_t)>& run)
+        {
+            for (size_t i = 0; i != num_tasks; ++i)
+            {
+                run(i);
+            }
+        });
+    CHECK(num_parallel == 190u);
+
+    // pending frees are collected by delete_all
+    mp.remote_delete_object(&*mp.begin());
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
     CHECK(mp.calc_stats().num_allocations == 0u);
 }
 
-TEST_CASE("FixedObjectPool iterate full block", "[fixedpool]")
-{
-    FixedObjectPool<uint32_t> mp(64);
-    iterateFullBlocks(mp, 64, 1);
-}
-
 TEST_CASE("DynamicObjectPool iterate full block", "[dynamicpool]")
 {
     DynamicObjectPool<uint32_t> mp(64);
@@ -363,6 +3587,296 @@ TEST_CASE("DynamicObjectPool iterate double full blocks", "[dynamicpool]")
     iterateFullBlocks(mp, 128, 2);
 }
 
+TEST_CASE("Lock free FixedObjectPool single new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("Lock free FixedObjectPool double new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> mp(64);
+    doubleNewAndDelete(mp);
+}
+
+TEST_CASE("Lock free FixedObjectPool iterate full block", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> mp(64);
+    iterateFullBlocks(mp, 64, 1);
+}
+
+TEST_CASE("Lock free FixedObjectPool concurrent new and delete", "[fixedpool]")
+{
+    static const size_t num_threads = 4;
+    static const size_t num_entries = 256;
+    static const size_t num_iterations = 20000;
+    FixedObjectPool<uint32_t, LockFreeObjectPoolPolicy> mp(num_entries);
+    std::vector<size_t> errors(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&mp, &errors, t]
+            {
+                // each thread holds a few entries at a time, checking
+                // nobody else was given the same entry
+                uint32_t* held[8] = {};
+                for (size_t i = 0; i < num_iterations; ++i)
+                {
+                    uint32_t*& p = held[i % 8];
+                    if (p)
+                    {
+                        if (*p != t)
+                        {
+                            ++errors[t];
+                        }
+                        mp.delete_object(p);
+                    }
+                    p = mp.new_object(static_cast<uint32_t>(t));
+                    if (p == nullptr)
+                    {
+                        ++errors[t];
+                    }
+                }
+                for (auto p : held)
+                {
+                    mp.delete_object(p);
+                }
+            }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        CHECK(errors[t] == 0u);
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    // the whole pool is still available after concurrent use
+    blockFillAndFree(mp, num_entries);
+}
+
+TEST_CASE("WaitingObjectPool callbacks", "[waitingpool]")
+{
+    WaitingObjectPool<std::string> mp(4);
+    std::vector<std::string*> v;
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(mp.new_object_async([&v](std::string* p) { v.push_back(p); }, "a"));
+    }
+    CHECK(v.size() == 4u);
+    CHECK(mp.new_object("b") == nullptr);
+
+    // full pools queue callbacks with copies of the parameters
+    std::vector<std::string*> ready;
+    for (int i = 0; i < 3; ++i)
+    {
+        std::string value(1, static_cast<char>('x' + i));
+        CHECK(!mp.new_object_async([&ready](std::string* p) { ready.push_back(p); }, value));
+    }
+    CHECK(mp.num_waiting() == 3u);
+    CHECK(ready.empty());
+
+    // each delete resumes the oldest waiter with the freed entry
+    mp.delete_object(v[2]);
+    REQUIRE(ready.size() == 1u);
+    CHECK(ready[0] == v[2]);
+    CHECK(*ready[0] == "x");
+    CHECK(mp.num_waiting() == 2u);
+    mp.delete_object(nullptr);
+    CHECK(ready.size() == 1u);
+
+    // delete_all serves every waiter it has room for
+    mp.delete_all();
+    REQUIRE(ready.size() == 3u);
+    CHECK(*ready[1] == "y");
+    CHECK(*ready[2] == "z");
+    CHECK(mp.num_waiting() == 0u);
+    CHECK(mp.calc_stats().num_allocations == 2u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+
+    // callbacks are freed once they have run
+    std::shared_ptr<int> token = std::make_shared<int>(0);
+    WaitingObjectPool<uint32_t> small(1);
+    uint32_t* p = small.new_object(1u);
+    CHECK(!small.new_object_async([token](uint32_t* q) { *q += 1; }, 2u));
+    CHECK(token.use_count() == 2);
+    small.delete_object(p);
+    CHECK(token.use_count() == 1);
+    CHECK(*p == 3u);
+    small.delete_object(p);
+}
+
+TEST_CASE("WaitingObjectPool threads", "[waitingpool]")
+{
+    static const size_t num_threads = 4;
+    static const size_t num_iterations = 5000;
+    WaitingObjectPool<uint32_t> mp(2);
+    std::vector<size_t> errors(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&mp, &errors, t]
+            {
+                // more threads than entries, so most allocations wait for
+                // another thread to free its object
+                for (size_t i = 0; i < num_iterations; ++i)
+                {
+                    std::atomic<uint32_t*> ready(nullptr);
+                    mp.new_object_async(
+                        [&ready](uint32_t* p) { ready.store(p, std::memory_order_release); },
+                        static_cast<uint32_t>(t));
+                    uint32_t* p;
+                    while ((p = ready.load(std::memory_order_acquire)) == nullptr)
+                    {
+                        std::this_thread::yield();
+                    }
+                    if (*p != t)
+                    {
+                        ++errors[t];
+                    }
+                    mp.delete_object(p);
+                }
+            }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        CHECK(errors[t] == 0u);
+    }
+    CHECK(mp.num_waiting() == 0u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+#if OBJECT_POOL_HAS_COROUTINES
+/// Coroutine which starts straight away and frees itself when it finishes
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return DetachedTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::abort(); }
+    };
+};
+
+DetachedTask acquire_string(WaitingObjectPool<std::string>& mp, const char* value,
+    std::vector<std::string*>& ready)
+{
+    std::string* p = co_await mp.acquire(value);
+    ready.push_back(p);
+}
+
+TEST_CASE("WaitingObjectPool coroutines", "[waitingpool]")
+{
+    WaitingObjectPool<std::string> mp(2);
+    std::vector<std::string*> ready;
+    acquire_string(mp, "a", ready);
+    acquire_string(mp, "b", ready);
+    REQUIRE(ready.size() == 2u);
+    CHECK(*ready[0] == "a");
+
+    // the third coroutine suspends until an entry is freed
+    acquire_string(mp, "c", ready);
+    CHECK(ready.size() == 2u);
+    CHECK(mp.num_waiting() == 1u);
+    mp.delete_object(ready[0]);
+    REQUIRE(ready.size() == 3u);
+    CHECK(ready[2] == ready[0]);
+    CHECK(*ready[2] == "c");
+    CHECK(mp.num_waiting() == 0u);
+    mp.delete_all();
+}
+#endif
+
+TEST_CASE("ConcurrentObjectPool single new and delete", "[concurrentpool]")
+{
+    ConcurrentObjectPool<uint32_t> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("ConcurrentObjectPool block fill and free", "[concurrentpool]")
+{
+    ConcurrentObjectPool<uint32_t> mp(64, 16);
+    blockFillAndFree(mp, 256);
+    mp.flush_thread_cache();
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("ConcurrentObjectPool cross thread delete", "[concurrentpool]")
+{
+    static const size_t num_threads = 4;
+    static const size_t num_objects = 10000;
+    ConcurrentObjectPool<uint32_t> mp(256, 32);
+    std::vector<std::vector<uint32_t*> > objects(num_threads);
+    std::vector<std::thread> threads;
+    // each thread allocates a set of objects
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&mp, &objects, t]
+            {
+                for (size_t i = 0; i < num_objects; ++i)
+                {
+                    objects[t].push_back(mp.new_object(static_cast<uint32_t>(t * num_objects + i)));
+                }
+            }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    CHECK(mp.calc_stats().num_allocations == num_threads * num_objects);
+
+    // each thread deletes the objects allocated by its neighbour
+    std::vector<size_t> errors(num_threads, 0);
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&mp, &objects, &errors, t]
+            {
+                const size_t other = (t + 1) % num_threads;
+                for (size_t i = 0; i < num_objects; ++i)
+                {
+                    uint32_t* p = objects[other][i];
+                    if (p == nullptr || *p != other * num_objects + i)
+                    {
+                        ++errors[t];
+                    }
+                    mp.delete_object(p);
+                }
+            }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        CHECK(errors[t] == 0u);
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+
+    // entries returned by exited threads can be allocated again
+    std::vector<uint32_t*> v;
+    for (size_t i = 0; i < num_threads * num_objects; ++i)
+    {
+        v.push_back(mp.new_object(0u));
+    }
+    const size_t num_blocks = mp.calc_stats().num_blocks;
+    CHECK(num_blocks == (num_threads * num_objects + 255) / 256);
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+}
+
 } // namespace tests
 
 #endif // UNIT_TESTS
@@ -20,11 +20,59 @@
 #ifndef _BITS_OBJECT_POOL_HPP_
 #define _BITS_OBJECT_POOL_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+// std::pmr is only available from C++17
+#if defined(_MSVC_LANG) && _MSVC_LANG > __cplusplus
+#define OBJECT_POOL_CPLUSPLUS _MSVC_LANG
+#else
+#define OBJECT_POOL_CPLUSPLUS __cplusplus
+#endif
+#if OBJECT_POOL_CPLUSPLUS >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define OBJECT_POOL_HAS_PMR 1
+#endif
+#endif
+#ifndef OBJECT_POOL_HAS_PMR
+#define OBJECT_POOL_HAS_PMR 0
+#endif
+#if OBJECT_POOL_CPLUSPLUS >= 202002L && defined(__has_include) && defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define OBJECT_POOL_HAS_COROUTINES 1
+#endif
+#endif
+#ifndef OBJECT_POOL_HAS_COROUTINES
+#define OBJECT_POOL_HAS_COROUTINES 0
+#endif
+
+struct DefaultObjectPoolPolicy;
+struct ObjectPoolBlockAllocator;
+struct ObjectPoolTelemetry;
+
 /// Internal details - look below this namespace for public classes!
 namespace detail
 {
@@ -32,17 +80,344 @@ namespace detail
 /// single pool block.
 typedef uint32_t index_t;
 
-/// Base object pool block. This contains a list of indices of free and used
-/// entries and the storage for the entries themselves. Everything is allocated
-/// in a single allocation in the static create function, and indices_begin()
-/// and memory_begin() methods will return pointers offset from this for their
-/// respective data.
-template <typename T>
-class ObjectPoolBlock
+/// Minimum alignment of pool blocks, this is the cache line size on most
+/// platforms.
+const uint32_t MIN_BLOCK_ALIGN = 64;
+
+/// Cache line size assumed by cache line aware block layouts
+const uint32_t CACHE_LINE_SIZE = 64;
+
+/// Smallest power of two which is not less than N
+template <size_t N, size_t P = 1, bool Done = (P >= N)>
+struct NextPow2
+{
+    static const size_t value = NextPow2<N, P * 2>::value;
+};
+
+template <size_t N, size_t P>
+struct NextPow2<N, P, true>
+{
+    static const size_t value = P;
+};
+
+/// Hints that the cache line holding the given address will be read soon
+inline void prefetch(const void* ptr);
+
+/// Reads the CPU timestamp counter, or a nanosecond clock on platforms
+/// without one
+inline uint64_t read_cycle_counter();
+
+/// Number of buckets in the latency histograms of ObjectPoolTelemetry
+const uint32_t TELEMETRY_LATENCY_BUCKETS = 32;
+
+/// Compile time sequence of indices, std::index_sequence is C++14
+template <size_t... I>
+struct index_sequence
+{
+};
+
+template <size_t N, size_t... I>
+struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...>
+{
+};
+
+template <size_t... I>
+struct make_index_sequence<0, I...> : index_sequence<I...>
+{
+};
+
+/// Smallest unsigned type which can hold values up to N
+template <size_t N>
+struct SmallestIndex
+{
+    typedef typename std::conditional<N <= 0xff, uint8_t,
+        typename std::conditional<N <= 0xffff, uint16_t, uint32_t>::type>::type type;
+};
+
+/// Largest alignment of raw allocations served from pools
+const size_t MAX_RAW_ALIGN = 16;
+
+/// Untyped storage for raw pool allocations of Size bytes, aligned to the
+/// smaller of Size and MAX_RAW_ALIGN
+template <size_t Size>
+struct RawStorage
+{
+    typename std::aligned_storage<Size, (Size < MAX_RAW_ALIGN ? Size : MAX_RAW_ALIGN)>::type data;
+};
+
+/// Minimal spin lock for short critical sections
+class SpinLock
 {
+    std::atomic_flag flag_;
+
+public:
+    SpinLock();
+    void lock();
+    void unlock();
+};
+
+/// Wraps a type so it isn't used for template argument deduction
+template <typename I>
+struct NonDeduced
+{
+    typedef I type;
+};
+
+/// Accessors for entries of the indices array, I is the index type. Lock
+/// free blocks store indices as atomics which are accessed with relaxed
+/// ordering, the free list head provides the ordering guarantees.
+template <typename I>
+I load_index(const I& index);
+template <typename I>
+I load_index(const std::atomic<I>& index);
+template <typename I>
+void store_index(I& index, typename NonDeduced<I>::type value);
+template <typename I>
+void store_index(std::atomic<I>& index, typename NonDeduced<I>::type value);
+
+/// Adds to or subtracts from a counter returning the new value
+template <typename I>
+I add_index(I& index, typename NonDeduced<I>::type value);
+template <typename I>
+I add_index(std::atomic<I>& index, typename NonDeduced<I>::type value);
+template <typename I>
+I sub_index(I& index, typename NonDeduced<I>::type value);
+template <typename I>
+I sub_index(std::atomic<I>& index, typename NonDeduced<I>::type value);
+
+/// Raises a counter to value if it is currently lower
+template <typename I>
+void max_index(I& index, typename NonDeduced<I>::type value);
+template <typename I>
+void max_index(std::atomic<I>& index, typename NonDeduced<I>::type value);
+
+/// Advances a counter by up to count without passing limit, returns the
+/// amount it was advanced by and sets first to its previous value
+template <typename I>
+I claim_indices(I& index, typename NonDeduced<I>::type limit, typename NonDeduced<I>::type count,
+    typename NonDeduced<I>::type& first);
+template <typename I>
+I claim_indices(std::atomic<I>& index, typename NonDeduced<I>::type limit,
+    typename NonDeduced<I>::type count, typename NonDeduced<I>::type& first);
+
+/// Type of each word of a block's occupancy bitmap
+typedef uint64_t bitmap_word_t;
+
+/// Accessors for occupancy bitmap words. Lock free blocks store words as
+/// atomics so bits for different entries may be updated concurrently.
+inline bitmap_word_t load_bits(const bitmap_word_t& word);
+inline bitmap_word_t load_bits(const std::atomic<bitmap_word_t>& word);
+inline void set_bits(bitmap_word_t& word, bitmap_word_t mask);
+inline void set_bits(std::atomic<bitmap_word_t>& word, bitmap_word_t mask);
+inline void clear_bits(bitmap_word_t& word, bitmap_word_t mask);
+inline void clear_bits(std::atomic<bitmap_word_t>& word, bitmap_word_t mask);
+
+/// Head of the list of free entries in a block. The list is linked through
+/// the indices array, I is the index type.
+template <bool LockFree, typename I = index_t>
+class FreeList;
+
+template <typename I>
+class FreeList<false, I>
+{
+    typedef I index_t;
+
     /// Index of the first free entry
-    index_t free_head_index_;
+    index_t head_;
+
+public:
+    typedef index_t index_storage_t;
+
+    explicit FreeList(index_t head);
+
+    /// Resets the head of the list, this is not thread safe
+    void reset(index_t head);
+
+    /// Removes the first entry from the list, returns end if the list is empty
+    index_t pop(const index_storage_t* indices, index_t end);
+
+    /// Adds index to the front of the list
+    void push(index_storage_t* indices, index_t index);
+
+    /// Removes up to count entries from the front of the list, returns the
+    /// number of entries removed
+    index_t pop_n(const index_storage_t* indices, index_t end, index_t* out, index_t count);
+
+    /// Adds a chain of entries already linked from first to last to the
+    /// front of the list
+    void push_n(index_storage_t* indices, index_t first, index_t last);
+};
+
+/// Lock free free list implemented as a Treiber stack. The head index is
+/// packed with a counter which is incremented on every update in a single
+/// 64 bit atomic. This prevents the ABA problem where an entry is popped and
+/// pushed by other threads between reading the head and updating it.
+template <typename I>
+class FreeList<true, I>
+{
+    typedef I index_t;
+    static_assert(sizeof(index_t) <= sizeof(uint32_t), "index_t must fit in 32 bits");
+
+    /// Index of the first free entry in the low 32 bits, update counter in
+    /// the high 32 bits
+    std::atomic<uint64_t> head_;
+
+public:
+    typedef std::atomic<index_t> index_storage_t;
+
+    explicit FreeList(index_t head);
+
+    /// Resets the head of the list, this is not thread safe
+    void reset(index_t head);
+
+    /// Removes the first entry from the list, returns end if the list is empty
+    index_t pop(const index_storage_t* indices, index_t end);
+
+    /// Adds index to the front of the list
+    void push(index_storage_t* indices, index_t index);
+
+    /// Removes up to count entries from the front of the list, returns the
+    /// number of entries removed
+    index_t pop_n(const index_storage_t* indices, index_t end, index_t* out, index_t count);
+
+    /// Adds a chain of entries already linked from first to last to the
+    /// front of the list
+    void push_n(index_storage_t* indices, index_t first, index_t last);
+};
+
+/// Counters behind ObjectPoolTelemetry. Pools call the hooks on every
+/// operation, when the policy disables telemetry they do nothing and have
+/// no storage so they compile away. Lock free pools count with relaxed
+/// atomics.
+template <typename Policy, bool Enabled = Policy::telemetry>
+class TelemetryCounters;
+
+template <typename Policy>
+class TelemetryCounters<Policy, false>
+{
+public:
+    uint64_t begin_sample() { return 0; }
+    void end_alloc_sample(uint64_t) {}
+    void end_free_sample(uint64_t) {}
+    void add_allocs(uint64_t) {}
+    void add_failed_allocs(uint64_t) {}
+    void add_frees(uint64_t) {}
+    void add_blocks_added(uint64_t) {}
+    void add_blocks_freed(uint64_t) {}
+    void add_blocks_scanned(uint64_t) {}
+};
+
+template <typename Policy>
+class TelemetryCounters<Policy, true>
+{
+public:
+    TelemetryCounters();
+
+    /// Returns the cycle counter if this operation is sampled for the
+    /// latency histograms, otherwise zero
+    uint64_t begin_sample();
+
+    /// Adds the cycles since a non-zero begin_sample result to a histogram
+    void end_alloc_sample(uint64_t start);
+    void end_free_sample(uint64_t start);
+
+    void add_allocs(uint64_t count);
+    void add_failed_allocs(uint64_t count);
+    void add_frees(uint64_t count);
+    void add_blocks_added(uint64_t count);
+    void add_blocks_freed(uint64_t count);
+    void add_blocks_scanned(uint64_t count);
+
+    /// Copies the counters into a snapshot
+    void snapshot(ObjectPoolTelemetry& telemetry) const;
+
+    /// Sets all counters to zero
+    void reset();
+
+private:
+    typedef typename std::conditional<Policy::lock_free, std::atomic<uint64_t>, uint64_t>::type
+        counter_t;
+
+    static void add_sample(counter_t* histogram, uint64_t start);
+
+    counter_t num_allocs_;
+    counter_t num_failed_allocs_;
+    counter_t num_frees_;
+    counter_t num_blocks_added_;
+    counter_t num_blocks_freed_;
+    counter_t num_blocks_scanned_;
+    /// number of operations which could have been sampled
+    counter_t num_sample_calls_;
+    counter_t alloc_cycles_[TELEMETRY_LATENCY_BUCKETS];
+    counter_t free_cycles_[TELEMETRY_LATENCY_BUCKETS];
+};
+
+/// Base object pool block. This contains a list of indices of free entries,
+/// a bitmap of used entries and the storage for the entries themselves.
+/// Everything is allocated in a single allocation in the static create
+/// function, and indices_begin(), bitmap_begin() and memory_begin() methods
+/// will return pointers offset from this for their respective data.
+///
+/// Entries are handed out in order from a high water mark until it reaches
+/// the end of the block, only freed entries go through the free list. The
+/// indices, bitmap words and generations of entries above the mark are not
+/// initialised, so creating a block or deleting all its entries doesn't
+/// touch memory the block hasn't used. Lock free blocks initialise their
+/// bitmap and generations up front so other threads can read them.
+template <typename T, typename Policy = DefaultObjectPoolPolicy>
+class ObjectPoolBlock
+{
+    static_assert(!(Policy::lock_free && Policy::dense), "dense blocks can not be lock free");
+    static_assert(!(Policy::lock_free && Policy::address_ordered),
+        "address ordered blocks can not be lock free");
+
+public:
+    /// Type of entry indices and counts, chosen by the policy
+    typedef typename Policy::index_t index_t;
+    /// Type of entry generations, these are 32 bit whatever the index type
+    typedef detail::index_t generation_t;
+
+private:
+    typedef detail::FreeList<Policy::lock_free, index_t> FreeList;
+    typedef typename FreeList::index_storage_t index_storage_t;
+    typedef typename std::conditional<Policy::lock_free, std::atomic<generation_t>,
+        generation_t>::type generation_storage_t;
+    typedef typename std::conditional<Policy::lock_free, std::atomic<bitmap_word_t>,
+        bitmap_word_t>::type bitmap_storage_t;
+    typedef typename std::conditional<Policy::lock_free, std::atomic<index_t>, index_t>::type
+        counter_t;
+    typedef typename Policy::handle_t handle_t;
+
+    /// number of entries tracked by each bitmap word
+    static const index_t BITS_PER_WORD = sizeof(bitmap_word_t) * 8;
+
+    /// distance in bytes between entries, with padded entries this is a
+    /// power of two up to a cache line or else a whole number of lines so
+    /// no entry straddles a cache line
+    static const size_t ENTRY_STRIDE = !Policy::pad_entries ? sizeof(T)
+        : sizeof(T) <= CACHE_LINE_SIZE ? NextPow2<sizeof(T)>::value
+        : (sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+    /// List of free entries
+    FreeList free_list_;
     const index_t entries_per_block_;
+    /// Index of this block in the owning pool's block list
+    detail::index_t pool_index_;
+    /// Number of allocated entries
+    counter_t num_allocations_;
+    /// Highest number of allocated entries since the block was created
+    counter_t peak_allocations_;
+    /// With address ordered allocation all bitmap words before this one
+    /// are full
+    index_t lowest_free_word_;
+    /// Number of entries which have been allocated since the block was
+    /// created or emptied by delete_all, later entries are unused
+    counter_t high_water_;
+    /// Number of entries whose generation has been initialised, this isn't
+    /// reset by delete_all so generations of reused entries keep counting
+    index_t num_generations_;
+    /// Generation of entries when they're first allocated
+    generation_t first_generation_;
 
     /// Constructor and destructor are private as create and destroy should
     /// be used instead.
@@ -52,19 +427,84 @@ class ObjectPoolBlock
     ObjectPoolBlock(const ObjectPoolBlock&) = delete;
     ObjectPoolBlock& operator=(const ObjectPoolBlock&) = delete;
 
+    /// returns the number of bitmap words for the given number of entries
+    static index_t calc_bitmap_words(index_t entries_per_block);
+
+    /// returns offsets of generations, bitmap and pool memory from the
+    /// start of the block
+    static size_t calc_generations_offset(index_t entries_per_block);
+    static size_t calc_live_offset(index_t entries_per_block);
+    static size_t calc_bitmap_offset(index_t entries_per_block);
+    static size_t calc_memory_offset(index_t entries_per_block);
+
     /// returns start of indices
-    index_t* indices_begin() const;
+    index_storage_t* indices_begin() const;
+
+    /// returns start of entry generations, only valid if the policy enables
+    /// generations
+    generation_storage_t* generations_begin() const;
+
+    /// Increments the generation of a freed entry if generations are enabled
+    void bump_generation(index_t index);
+
+    /// returns start of the packed array of live entry indices followed by
+    /// the position of each entry in it, only valid if the policy enables
+    /// dense iteration
+    index_t* live_begin() const;
+
+    /// Adds an entry to, or swaps and pops it from, the live array if the
+    /// policy enables dense iteration. Must be called before num_allocations_
+    /// is updated.
+    void add_live(index_t index);
+    void remove_live(index_t index);
+
+    /// returns start of the occupancy bitmap
+    bitmap_storage_t* bitmap_begin() const;
 
     /// returns start of pool memory
     T* memory_begin() const;
 
+    /// Prefetches the entry the policy's prefetch distance after the given
+    /// index, if there is one
+    void prefetch_ahead(index_t index) const;
+
+    /// Finds up to count of the lowest free entries below the high water
+    /// mark for address ordered allocation without marking them as used,
+    /// returns the number found
+    index_t find_lowest_free(index_t* out, index_t count);
+
+    /// Takes up to count entries from the high water mark, initialising
+    /// their bitmap words and generations as required. Returns the number
+    /// of entries taken, which start from first.
+    index_t claim_unused(index_t count, index_t& first);
+
 public:
+    /// Returns the size in bytes of a block with the given number of entries
+    /// including the header, indices and entry storage.
+    static size_t calc_block_size(index_t entries_per_block);
+
+    /// Returns the largest number of entries that fit in a block of the
+    /// given size in bytes, at least one.
+    static index_t calc_entries_for_size(size_t block_size);
+
     /// Creates to ObjectPoolBlock object and storage in a single aligned
-    /// allocation.
-    static ObjectPoolBlock<T>* create(index_t entries_per_block);
+    /// allocation from the given allocator. The block address will be a
+    /// multiple of block_align.
+    static ObjectPoolBlock* create(
+        index_t entries_per_block, size_t block_align, const ObjectPoolBlockAllocator& allocator);
+
+    /// Returns the block which owns the given pointer. The block must have
+    /// been created with a power of two block_align which is not smaller than
+    /// calc_block_size for the block.
+    static ObjectPoolBlock* from_pointer(const T* ptr, size_t block_align);
 
-    /// Destroys the ObjectPoolBlock and associated storage.
-    static void destroy(ObjectPoolBlock<T>* ptr);
+    /// Destroys the ObjectPoolBlock and returns its storage to the allocator
+    /// it was created with.
+    static void destroy(ObjectPoolBlock* ptr, const ObjectPoolBlockAllocator& allocator);
+
+    /// Frees the ObjectPoolBlock storage without destructing allocated
+    /// entries. Used by pools which track the lifetime of entries themselves.
+    static void destroy_storage(ObjectPoolBlock* ptr, const ObjectPoolBlockAllocator& allocator);
 
     /// Allocates a new object from this block. Returns nullptr if there is
     /// no available space.
@@ -74,42 +514,388 @@ public:
     /// Deletes the given pointer. The pointer must be owned by this block.
     void delete_object(const T* ptr);
 
-    /// Delete all current allocations and reinitialise the block
+    /// Allocates storage for an entry without constructing it. Returns
+    /// nullptr if there is no available space.
+    T* allocate();
+
+    /// Frees the storage of an entry without destructing it. The pointer
+    /// must be owned by this block.
+    void deallocate(const T* ptr);
+
+    /// Allocates storage for up to count entries without constructing them.
+    /// Returns the number of entries allocated.
+    index_t allocate_n(T** ptrs, index_t count);
+
+    /// Frees the storage of count entries without destructing them. The
+    /// pointers must be owned by this block.
+    void deallocate_n(const T* const* ptrs, index_t count);
+
+    /// Delete all current allocations and reinitialise the block. Only
+    /// rewinds counters unless T has a destructor or the policy is lock free
+    /// or has generations.
     void delete_all();
 
-    /// Calls given function for all allocated entries
+    /// Calls given function for all allocated entries. Empty entries are
+    /// skipped a bitmap word at a time. If the policy enables dense iteration
+    /// the live array is walked instead, in no particular order, and func
+    /// may only delete the entry it is called with.
     template <typename F>
     void for_each(const F func) const;
 
+    /// Calls given function for allocated entries with indices in the range
+    /// [begin, end) in index order
+    template <typename F>
+    void for_each_in(index_t begin, index_t end, const F func) const;
+
+    /// Returns the index of the first allocated entry at or after the given
+    /// index, or num_entries() if there is none. Empty entries are skipped
+    /// a bitmap word at a time.
+    index_t find_allocated(index_t index) const;
+
+    /// Returns the entry at the given index
+    T* entry_at(index_t index) const;
+
     /// returns start of pool memory
     const T* memory_offset() const;
 
-    /// Calculates the number of allocated entries
+    /// Returns the number of allocated entries
     index_t num_allocations() const;
+
+    /// Returns the highest number of allocated entries at any one time
+    index_t peak_allocations() const;
+
+    /// Returns the total number of entries in this block
+    index_t num_entries() const;
+
+    /// Index of this block in the owning pool's block list
+    detail::index_t pool_index() const;
+    void set_pool_index(detail::index_t pool_index);
+
+    /// Number of bits of a handle holding the entry's position in the pool,
+    /// the remaining high bits hold its generation
+    static const unsigned HANDLE_POSITION_BITS = sizeof(handle_t) * 4;
+
+    /// Returns the generation following the given one. Generations are
+    /// truncated to fit in a handle and are never zero, so a handle is
+    /// never zero either.
+    static generation_t next_generation(generation_t generation);
+
+    /// Returns the index of the entry at the given address
+    index_t index_of(const T* ptr) const;
+
+    /// Returns the current generation of an entry
+    generation_t generation(index_t index) const;
+
+    /// Returns the entry at the given index if its generation matches,
+    /// otherwise nullptr
+    T* resolve(index_t index, generation_t generation) const;
+
+    /// Sets the generation of every entry, used when a pool reuses a block
+    /// index so handles to the previous block stay invalid
+    void reset_generations(generation_t generation);
+
+    /// Returns the highest generation of any entry
+    generation_t max_generation() const;
+
+    /// Returns the largest number of entries a block can have
+    static index_t max_entries();
 };
 
 } // namespace detail
 
 
+/// Default object pool policy. Pool behaviour can be customised by deriving
+/// a policy from this and overriding members.
+struct DefaultObjectPoolPolicy
+{
+    /// If true a lock free free list is used so new_object and delete_object
+    /// may be called concurrently from multiple threads. Other methods are
+    /// not thread safe. Only supported by FixedObjectPool.
+    static const bool lock_free = false;
+
+    /// If true each entry has a generation counter which is incremented
+    /// when the entry is freed, enabling the handle methods of
+    /// FixedObjectPool and DynamicObjectPool.
+    static const bool generations = false;
+
+    /// Type of generational handles, either uint32_t or uint64_t. The high
+    /// half of a handle holds the generation and the low half the position
+    /// of the entry in the pool, so 32 bit handles can address pools of up
+    /// to 65536 entries.
+    typedef uint64_t handle_t;
+
+    /// Type of the free list index stored for every entry, which limits the
+    /// number of entries in a block. A smaller type such as uint8_t or
+    /// uint16_t saves memory for pools of small objects, and FixedObjectPool
+    /// supports uint64_t for pools of more than 2^32 entries. DynamicObjectPool
+    /// caps block sizes to fit and doesn't support uint64_t, lock free pools
+    /// support at most 32 bits.
+    typedef uint32_t index_t;
+
+    /// If true each block keeps a packed array of the indices of its live
+    /// entries, so for_each only touches allocated entries whatever the
+    /// occupancy. Allocating and freeing update the array with swap and pop,
+    /// costing two extra indices per entry. Not supported by lock free pools.
+    static const bool dense = false;
+
+    /// If true the entry storage of each block starts on a cache line
+    /// boundary rather than at the alignment of T.
+    static const bool align_entries = false;
+
+    /// If true each entry is also padded to a power of two size up to a
+    /// cache line, or to a whole number of cache lines for larger types, so
+    /// no entry straddles two lines. Implies align_entries.
+    static const bool pad_entries = false;
+
+    /// Number of entries ahead of the current one which for_each prefetches,
+    /// zero disables prefetching. Useful when the work done per entry hides
+    /// the memory latency of later entries.
+    static const unsigned prefetch_distance = 0;
+
+    /// If true blocks allocate their lowest free entry rather than the most
+    /// recently freed one, and DynamicObjectPool allocates from its lowest
+    /// block with space, so live objects gather at low addresses and high
+    /// blocks empty out for reclaim_memory. Allocation searches the bitmap
+    /// so is slower in sparse blocks. Not supported by lock free pools.
+    static const bool address_ordered = false;
+
+    /// If true pools count allocations, frees, failures and block changes
+    /// and sample operation latencies, see ObjectPoolTelemetry. When false
+    /// the instrumentation is compiled out.
+    static const bool telemetry = false;
+
+    /// With telemetry, one in this many new_object and delete_object calls
+    /// is timed for the latency histograms
+    static const unsigned telemetry_sample_interval = 64;
+};
+
+/// Policy for a FixedObjectPool which can be shared between threads.
+struct LockFreeObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool lock_free = true;
+};
+
+/// Policy for pools which hand out generational handles.
+struct GenerationalObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool generations = true;
+};
+
+/// Policy for pools which are iterated more often than they change.
+struct DenseObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool dense = true;
+};
+
+/// Policy for pools whose entries shouldn't share or straddle cache lines
+/// unnecessarily.
+struct CacheAlignedObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool align_entries = true;
+    static const bool pad_entries = true;
+};
+
+/// Policy for pools which record telemetry.
+struct TelemetryObjectPoolPolicy : DefaultObjectPoolPolicy
+{
+    static const bool telemetry = true;
+};
+
+
 /// Object pool statistics structure used for returning information about
 /// pool usage.
 struct ObjectPoolStats
 {
     size_t num_blocks = 0;
     size_t num_allocations = 0;
+    /// highest number of allocations at any one time
+    size_t peak_allocations = 0;
+    /// number of blocks which have no allocations
+    size_t num_free_blocks = 0;
+    /// bytes allocated for blocks and pool bookkeeping
+    size_t bytes_reserved = 0;
+    /// bytes used by allocated objects
+    size_t bytes_in_use = 0;
+};
+
+
+/// Snapshot of the counters of a pool whose policy enables telemetry,
+/// counted since the pool was created or its telemetry was last reset.
+struct ObjectPoolTelemetry
+{
+    static const uint32_t NUM_LATENCY_BUCKETS = detail::TELEMETRY_LATENCY_BUCKETS;
+
+    /// objects allocated and freed, including batches
+    uint64_t num_allocs = 0;
+    uint64_t num_frees = 0;
+    /// allocations which returned nullptr as the pool was out of space
+    uint64_t num_failed_allocs = 0;
+    /// blocks a DynamicObjectPool added as it grew
+    uint64_t num_blocks_added = 0;
+    /// blocks a DynamicObjectPool freed in reclaim_memory or reset
+    uint64_t num_blocks_freed = 0;
+    /// block info records a DynamicObjectPool visited to find a block with
+    /// space or to relink a block into its list of blocks with space
+    uint64_t num_blocks_scanned = 0;
+    /// highest number of allocations at any one time since the pool was
+    /// created
+    uint64_t peak_allocations = 0;
+    /// histograms of sampled new_object and delete_object latencies in
+    /// timestamp counter cycles, bucket i counts samples taking less than
+    /// 2^i cycles and at least half that
+    uint64_t alloc_cycles[NUM_LATENCY_BUCKETS] = {};
+    uint64_t free_cycles[NUM_LATENCY_BUCKETS] = {};
+
+    /// Returns the upper bound in cycles of the histogram bucket reaching
+    /// the given fraction of samples, e.g. 0.99 for the 99th percentile.
+    /// Returns zero if there are no samples.
+    static uint64_t percentile(const uint64_t (&histogram)[NUM_LATENCY_BUCKETS], double fraction);
+
+    /// Returns the counters as a JSON object for exporting to monitoring
+    std::string to_json() const;
+};
+
+
+/// Controls the number of entries in each block a DynamicObjectPool adds
+/// as it grows.
+struct ObjectPoolGrowth
+{
+    typedef detail::index_t index_t;
+
+    /// Returns the number of entries for a new block given the number of
+    /// existing blocks and the total number of entries they contain. The
+    /// result is clamped to between 1 and max_entries_per_block.
+    typedef index_t (*callback_t)(void* user_data, index_t num_blocks, size_t capacity);
+
+    enum Mode
+    {
+        /// every block has the initial number of entries
+        FIXED,
+        /// each new block holds as many entries as all existing blocks so
+        /// capacity doubles until blocks reach max_entries_per_block
+        GEOMETRIC,
+        /// block sizes are chosen by a user callback
+        CUSTOM
+    };
+
+    Mode mode = FIXED;
+    /// upper limit on the number of entries in a block, zero means the
+    /// initial number of entries. Blocks are aligned to the size of the
+    /// largest block so a large limit reserves more address space.
+    index_t max_entries_per_block = 0;
+    callback_t callback = nullptr;
+    void* user_data = nullptr;
+
+    static ObjectPoolGrowth fixed();
+    static ObjectPoolGrowth geometric(index_t max_entries_per_block);
+    static ObjectPoolGrowth custom(
+        callback_t callback, void* user_data, index_t max_entries_per_block);
+};
+
+
+/// Allocator for the memory of pool blocks. Blocks default to the heap,
+/// huge_pages() maps blocks directly from the OS using 2 MB pages to reduce
+/// TLB misses when iterating large pools.
+struct ObjectPoolBlockAllocator
+{
+    typedef detail::index_t index_t;
+
+    /// Returns size bytes aligned to align, or nullptr on failure
+    typedef void* (*allocate_t)(void* user_data, size_t size, size_t align);
+    /// Frees memory returned by allocate, size is the size it was allocated
+    /// with
+    typedef void (*deallocate_t)(void* user_data, void* ptr, size_t size);
+
+    /// aligned_malloc is used if allocate is null
+    allocate_t allocate = nullptr;
+    deallocate_t deallocate = nullptr;
+    void* user_data = nullptr;
+    /// If not zero DynamicObjectPool sizes blocks to fill a whole number of
+    /// pages of this size
+    size_t page_size = 0;
+
+    /// Size of the pages used by huge_pages()
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    static ObjectPoolBlockAllocator heap();
+
+    /// Maps blocks with mmap or VirtualAlloc. On Linux blocks use
+    /// transparent huge pages, or explicit huge pages from hugetlbfs if
+    /// explicit_pages is true and any are reserved. On Windows explicit
+    /// large pages are used if the process has the privilege to lock pages.
+    static ObjectPoolBlockAllocator huge_pages(bool explicit_pages = false);
+
+    /// Maps blocks like huge_pages() with physical memory placed on the
+    /// given NUMA node where the OS supports it. If the node is out of
+    /// memory pages come from other nodes.
+    static ObjectPoolBlockAllocator numa_node(index_t node);
+
+    /// Allocates and frees block memory, hiding the default heap case
+    void* allocate_block(size_t size, size_t align) const;
+    void deallocate_block(void* ptr, size_t size) const;
+};
+
+
+/// Executor for DynamicObjectPool::parallel_for_each which runs tasks on a
+/// set of worker threads that are kept alive between calls. Tasks are
+/// claimed from a shared counter, so threads which finish early take on the
+/// remaining tasks instead of waiting. Calls must not overlap.
+class ObjectPoolThreadExecutor
+{
+public:
+    /// Starts num_threads - 1 worker threads, the calling thread takes part
+    /// in running tasks as well
+    explicit ObjectPoolThreadExecutor(
+        unsigned num_threads = std::thread::hardware_concurrency());
+    ~ObjectPoolThreadExecutor();
+
+    /// Returns the number of threads tasks are run on
+    unsigned num_threads() const;
+
+    /// Calls run(i) for every i in [0, num_tasks) and returns once all of
+    /// them have finished
+    void operator()(size_t num_tasks, const std::function<void(size_t)>& run);
+
+private:
+    /// Runs tasks of the current call until there are none left
+    void run_tasks();
+    void worker();
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    /// task function and count of the current call
+    const std::function<void(size_t)>* run_;
+    size_t num_tasks_;
+    /// index of the next task to run
+    std::atomic<size_t> next_task_;
+    /// number of worker threads which haven't finished the current call
+    size_t num_busy_;
+    /// incremented by each call so workers can tell a new call has started
+    uint64_t call_id_;
+    bool stop_;
+
+    ObjectPoolThreadExecutor(const ObjectPoolThreadExecutor&) = delete;
+    ObjectPoolThreadExecutor& operator=(const ObjectPoolThreadExecutor&) = delete;
 };
 
 
 /// FixedObjectPool contains a single ObjectPoolBlock, it will not grow
 /// beyond the max number of entries given at construction time.
-template <typename T>
+///
+/// With LockFreeObjectPoolPolicy new_object and delete_object may be called
+/// from any thread without locking.
+template <typename T, typename Policy = DefaultObjectPoolPolicy>
 class FixedObjectPool
 {
 public:
-    typedef detail::index_t index_t;
+    typedef typename Policy::index_t index_t;
     typedef T value_t;
+    typedef typename Policy::handle_t handle_t;
 
-    FixedObjectPool(index_t max_entries);
+    FixedObjectPool(index_t max_entries,
+        const ObjectPoolBlockAllocator& allocator = ObjectPoolBlockAllocator());
     ~FixedObjectPool();
 
     /// Constructs a new object from the pool. Returns nullptr if there is no
@@ -120,6 +906,17 @@ public:
     /// Deletes the given pointer. The pointer must be owned by the pool.
     void delete_object(const T* ptr);
 
+    /// Constructs up to count new objects from the pool, each with a copy of
+    /// the given parameters, storing the pointers in ptrs. Returns the
+    /// number of objects constructed which is less than count if the pool
+    /// runs out of space.
+    template <class... P>
+    index_t new_objects(index_t count, T** ptrs, const P&... params);
+
+    /// Deletes count pointers which must be owned by the pool. Null pointers
+    /// are skipped.
+    void delete_objects(const T* const* ptrs, index_t count);
+
     /// Delete all current allocations
     void delete_all();
 
@@ -127,28 +924,121 @@ public:
     template <typename F>
     void for_each(const F func) const;
 
-    /// Calculates object pool stats
+    /// Forward iterator over allocated entries, V is T or const T. Empty
+    /// entries are skipped a bitmap word at a time. Deleting the entry an
+    /// iterator refers to is allowed, but creating objects while
+    /// iterating invalidates iterators.
+    template <typename V>
+    class Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+        Iterator();
+
+        /// Converts an iterator to a const_iterator
+        template <typename U,
+            typename = typename std::enable_if<std::is_convertible<U*, V*>::value>::type>
+        Iterator(const Iterator<U>& other);
+
+        V& operator*() const;
+        V* operator->() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        friend class FixedObjectPool;
+        template <typename U>
+        friend class Iterator;
+
+        Iterator(const FixedObjectPool* pool, index_t index);
+
+        const FixedObjectPool* pool_;
+        /// index of the entry in the pool's block
+        index_t index_;
+    };
+
+    typedef Iterator<T> iterator;
+    typedef Iterator<const T> const_iterator;
+
+    /// Returns iterators over allocated entries
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /// Returns object pool stats, this doesn't need to visit every entry
     ObjectPoolStats calc_stats() const;
 
+    /// Returns a snapshot of the pool's telemetry. Requires a policy with
+    /// telemetry.
+    ObjectPoolTelemetry telemetry() const;
+
+    /// Sets the telemetry counters to zero
+    void reset_telemetry();
+
+    /// Returns a handle to an allocated object which can be checked for
+    /// validity after the object is deleted. Requires a policy with
+    /// generations. Zero is never a valid handle.
+    handle_t handle_of(const T* ptr) const;
+
+    /// Returns the object for a handle, or nullptr if it has been deleted
+    T* resolve(handle_t handle) const;
+
+    /// Returns true if the handle refers to a live object
+    bool is_valid(handle_t handle) const;
+
+    /// Writes the pool's block to a file which load can map back in, e.g. to
+    /// warm start a process with a large pool. T must be trivially copyable.
+    /// Returns false if the file couldn't be written.
+    bool save(const char* path) const;
+
+    /// Replaces the pool's block with one mapped from a file written by save
+    /// from a pool of the same type and size, so restoring costs page faults
+    /// rather than copies. The pool must be empty. The mapping is copy on
+    /// write so changes stay in memory unless shared is true, in which case
+    /// they are written back to the file. Handles saved with the pool stay
+    /// valid. The pool may be destroyed without deleting loaded objects.
+    /// Returns false and leaves the pool unchanged if the file can't be
+    /// mapped or doesn't match the pool's layout.
+    bool load(const char* path, bool shared = false);
+
 private:
-    typedef detail::ObjectPoolBlock<T> Block;
+    typedef detail::ObjectPoolBlock<T, Policy> Block;
+    const ObjectPoolBlockAllocator allocator_;
     Block* block_;
+    /// true if block_ was mapped from a file by load
+    bool mapped_;
+    detail::TelemetryCounters<Policy> telemetry_;
 
     FixedObjectPool(const FixedObjectPool&) = delete;
     FixedObjectPool& operator=(const FixedObjectPool&) = delete;
 };
 
 
-/// DynamicObjectPool contains a dynamic array of ObjectPoolBlocks.
-template <typename T>
-class DynamicObjectPool
+/// StaticObjectPool holds up to N objects with the storage, free list and
+/// occupancy bitmap inline in the pool object, so creating it doesn't
+/// allocate and entries are addressed without a pointer hop. Free list
+/// indices use the smallest type which can index N entries.
+template <typename T, size_t N>
+class StaticObjectPool
 {
+    static_assert(N > 0 && N < 0xffffffff, "StaticObjectPool capacity is out of range");
+
 public:
     typedef detail::index_t index_t;
     typedef T value_t;
+    /// Type of the free list indices
+    typedef typename detail::SmallestIndex<N>::type slot_t;
 
-    DynamicObjectPool(index_t entries_per_block);
-    ~DynamicObjectPool();
+    StaticObjectPool();
+    ~StaticObjectPool();
 
     /// Constructs a new object from the pool. Returns nullptr if there is no
     /// available space.
@@ -161,45 +1051,1108 @@ public:
     /// Delete all current allocations
     void delete_all();
 
-    /// Reclaim unused object pool blocks
-    void reclaim_memory();
-
     /// Calls the given function for all allocated entries
     template <typename F>
     void for_each(const F func) const;
 
-    /// Calculates object pool stats
+    /// Returns object pool stats
     ObjectPoolStats calc_stats() const;
 
+    /// Returns true if the pointer points at an entry of this pool
+    bool owns(const T* ptr) const;
+
+    /// Number of entries in the pool
+    static const index_t CAPACITY = static_cast<index_t>(N);
+
 private:
-    typedef detail::ObjectPoolBlock<T> Block;
+    typedef detail::bitmap_word_t bitmap_word_t;
+    static const index_t BITS_PER_WORD = sizeof(bitmap_word_t) * 8;
+    static const index_t NUM_WORDS = (N + BITS_PER_WORD - 1) / BITS_PER_WORD;
 
-    /// The BlockInfo struct keeps regularly accessed block information
-    /// packed together for better memory locality.
-    struct BlockInfo
-    {
-        /// cache the number of free entries for this block
-        index_t num_free_;
-        /// cache the offset of object memory from the start of the block
-        const T* offset_;
-        /// pointer to the block itself
-        Block* block_;
-    };
+    T* entry(index_t index) const;
 
-    /// storage for block info records
-    BlockInfo* block_info_;
-    /// number of blocks allocated
-    index_t num_blocks_;
-    /// index of the first block info with space
-    index_t free_block_index_;
-    /// the number of entries in each block
-    const index_t entries_per_block_;
+    typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage_[N];
+    bitmap_word_t bitmap_[NUM_WORDS];
+    /// next free entry of each free entry, N marks the end of the list
+    slot_t indices_[N];
+    slot_t free_head_;
+    slot_t num_allocations_;
+    slot_t peak_allocations_;
 
-    /// Adds a new block and updates the free_block_index.
-    BlockInfo* add_block();
+    StaticObjectPool(const StaticObjectPool&) = delete;
+    StaticObjectPool& operator=(const StaticObjectPool&) = delete;
+};
 
-    DynamicObjectPool(const DynamicObjectPool&) = delete;
-    DynamicObjectPool& operator=(const DynamicObjectPool&) = delete;
+
+/// WaitingObjectPool is a FixedObjectPool whose allocations can wait for
+/// space instead of failing. When the pool is full new_object_async queues
+/// a callback, and with C++20 coroutines co_await acquire(args...) suspends
+/// the caller. Each delete_object hands the entry it frees to the oldest
+/// waiter, whose object is constructed in it and whose callback or
+/// coroutine is resumed on the deleting thread, so a free never wakes more
+/// than one waiter. A mutex guards the pool and the queue of waiters, so all
+/// methods may be called from any thread.
+template <typename T, typename Policy = DefaultObjectPoolPolicy>
+class WaitingObjectPool
+{
+    struct Waiter;
+
+public:
+    typedef typename Policy::index_t index_t;
+    typedef T value_t;
+
+    WaitingObjectPool(index_t max_entries,
+        const ObjectPoolBlockAllocator& allocator = ObjectPoolBlockAllocator());
+
+    /// All objects must be deleted first, which also leaves no allocations
+    /// waiting as they are given the freed entries.
+    ~WaitingObjectPool();
+
+    /// Constructs a new object from the pool. Returns nullptr without
+    /// waiting if there is no available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Constructs a new object and calls on_ready with it. If the pool is
+    /// full the parameters are copied and on_ready is called later from the
+    /// delete_object call which frees space. Returns true if on_ready was
+    /// called before returning.
+    template <typename F, class... P>
+    bool new_object_async(F&& on_ready, P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool. If
+    /// allocations are waiting the freed entry goes to the oldest one, which
+    /// is resumed before this returns.
+    void delete_object(const T* ptr);
+
+    /// Delete all current allocations, then give the freed entries to
+    /// waiting allocations
+    void delete_all();
+
+    /// Returns the number of allocations waiting for space
+    size_t num_waiting() const;
+
+    /// Returns object pool stats
+    ObjectPoolStats calc_stats() const;
+
+#if OBJECT_POOL_HAS_COROUTINES
+    /// Awaitable returned by acquire. Its result is the new object.
+    template <class... A>
+    class Acquire;
+
+    /// Returns an awaitable which constructs a new object from copies of the
+    /// given parameters, suspending the awaiting coroutine until an entry is
+    /// freed if the pool is full. A suspended coroutine must not be
+    /// destroyed before it is resumed.
+    template <class... P>
+    Acquire<typename std::decay<P>::type...> acquire(P&&... params);
+#endif
+
+private:
+    typedef FixedObjectPool<T, Policy> Pool;
+
+    /// A queued allocation. construct_ creates the object in the pool under
+    /// the lock and resume_ hands it over after the lock is released.
+    struct Waiter
+    {
+        typedef T* (*construct_t)(Waiter* waiter, Pool& pool);
+        typedef void (*resume_t)(Waiter* waiter);
+
+        Waiter(construct_t construct, resume_t resume);
+
+        Waiter* next_;
+        /// the constructed object once the waiter has been served
+        T* ptr_;
+        construct_t construct_;
+        resume_t resume_;
+    };
+
+    /// Waiter holding copies of the construction parameters
+    template <class... A>
+    struct ArgsWaiter : Waiter
+    {
+        template <class... P>
+        ArgsWaiter(typename Waiter::resume_t resume, P&&... params);
+
+        static T* construct(Waiter* waiter, Pool& pool);
+        template <size_t... I>
+        T* construct_params(Pool& pool, detail::index_sequence<I...>);
+
+        std::tuple<A...> params_;
+    };
+
+    /// Waiter queued by new_object_async, allocated on the heap and freed
+    /// when it is resumed
+    template <typename F, class... A>
+    struct CallbackWaiter : ArgsWaiter<A...>
+    {
+        template <typename G, class... P>
+        CallbackWaiter(G&& on_ready, P&&... params);
+
+        static void resume(Waiter* waiter);
+
+        F on_ready_;
+    };
+
+    /// Appends a waiter to the queue, the lock must be held
+    void push_waiter(Waiter* waiter);
+
+    /// Constructs objects for up to max_count waiters from the front of the
+    /// queue while the pool has space, the lock must be held. Returns the
+    /// list of served waiters to resume once the lock is released.
+    Waiter* serve_waiters(size_t max_count);
+
+    /// Resumes each waiter of a list returned by serve_waiters
+    static void resume_waiters(Waiter* served);
+
+    Pool pool_;
+    mutable std::mutex mutex_;
+    /// oldest and newest waiting allocations
+    Waiter* waiters_head_;
+    Waiter* waiters_tail_;
+    size_t num_waiting_;
+
+    WaitingObjectPool(const WaitingObjectPool&) = delete;
+    WaitingObjectPool& operator=(const WaitingObjectPool&) = delete;
+};
+
+#if OBJECT_POOL_HAS_COROUTINES
+template <typename T, typename Policy>
+template <class... A>
+class WaitingObjectPool<T, Policy>::Acquire : ArgsWaiter<A...>
+{
+public:
+    /// Always false, space is checked under the pool's lock in await_suspend
+    bool await_ready() const;
+
+    /// Constructs the object if the pool has space, otherwise queues the
+    /// coroutine. Returns false if the object was constructed without
+    /// waiting, so the coroutine continues straight away.
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    /// Returns the new object
+    T* await_resume() const;
+
+private:
+    friend class WaitingObjectPool;
+
+    template <class... P>
+    explicit Acquire(WaitingObjectPool* pool, P&&... params);
+
+    static void resume(Waiter* waiter);
+
+    WaitingObjectPool* pool_;
+    std::coroutine_handle<> handle_;
+
+    Acquire(const Acquire&) = delete;
+    Acquire& operator=(const Acquire&) = delete;
+};
+#endif
+
+
+/// DynamicObjectPool contains a dynamic array of ObjectPoolBlocks.
+///
+/// With a policy which enables generations reclaim_memory only frees
+/// empty blocks at the end of the block list, so block indices stored in
+/// handles never change.
+template <typename T, typename Policy = DefaultObjectPoolPolicy>
+class DynamicObjectPool
+{
+    static_assert(!Policy::lock_free, "DynamicObjectPool does not support lock free policies");
+    static_assert(sizeof(typename Policy::index_t) <= sizeof(detail::index_t),
+        "DynamicObjectPool does not support 64 bit indices");
+
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+    typedef typename Policy::handle_t handle_t;
+
+    /// Creates a pool whose first block has entries_per_block entries,
+    /// later blocks are sized by the growth policy. If the allocator has a
+    /// page size, block sizes are rounded up to fill whole pages.
+    DynamicObjectPool(index_t entries_per_block,
+        const ObjectPoolGrowth& growth = ObjectPoolGrowth::fixed(),
+        const ObjectPoolBlockAllocator& allocator = ObjectPoolBlockAllocator());
+    ~DynamicObjectPool();
+
+    /// Constructs a new object from the pool. Returns nullptr if there is no
+    /// available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Constructs a new object in the same block as hint if that block has
+    /// space, otherwise anywhere in the pool like new_object. Placing objects
+    /// which are used together near each other improves locality. The hint
+    /// may be nullptr, otherwise it must be a live object of this pool.
+    template <class... P>
+    T* new_object_near(const T* hint, P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool.
+    void delete_object(const T* ptr);
+
+    /// Allocates storage for an object without constructing it. Returns
+    /// nullptr if there is no available space.
+    T* allocate();
+
+    /// Allocates storage in the same block as hint if possible, see
+    /// new_object_near
+    T* allocate_near(const T* hint);
+
+    /// Frees storage returned by allocate without destructing it
+    void deallocate(const T* ptr);
+
+    /// Deletes an object from a thread other than the one which owns the
+    /// pool. The object is destructed on the calling thread and its storage
+    /// is pushed on a lock free queue. The owning thread returns queued
+    /// storage to its blocks in collect_remote_frees, and in new_object when
+    /// no block has space, delete_all, reclaim_memory and compact. Queued
+    /// entries still count towards calc_stats until they are collected.
+    /// Iterating a non-const pool collects them first, iterating a const
+    /// pool asserts that none are pending.
+    ///
+    /// Queued storage holds the link to the next entry so T must be at
+    /// least pointer sized. Generations are not supported as handles would
+    /// resolve to destructed objects until their storage is collected.
+    void remote_delete_object(const T* ptr);
+
+    /// Returns storage queued by remote_delete_object to its blocks. Must be
+    /// called from the owning thread. Returns the number of entries freed.
+    size_t collect_remote_frees();
+
+    /// Constructs up to count new objects from the pool, each with a copy of
+    /// the given parameters, storing the pointers in ptrs. Returns the
+    /// number of objects constructed which is less than count if the pool
+    /// runs out of space.
+    template <class... P>
+    index_t new_objects(index_t count, T** ptrs, const P&... params);
+
+    /// Deletes count pointers which must be owned by the pool. Null pointers
+    /// are skipped. The objects of each block are destructed and freed
+    /// together. A batch which is sorted by address, such as pointers
+    /// collected by iterating the pool, or which lies in a single block is
+    /// freed as it is. Other batches spanning several blocks are first
+    /// grouped by block in a scratch array, so they may be in any order.
+    /// Batches with fewer pointers than the pool has blocks are grouped by
+    /// sorting, larger ones with a counting sort by block.
+    void delete_objects(const T* const* ptrs, index_t count);
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Deletes all current allocations like delete_all, then frees blocks
+    /// after the first ones which fit in retained_bytes, always keeping the
+    /// first block. For trivially destructible types without generations
+    /// this costs a few counter updates per block, so it suits scratch pools
+    /// which are emptied every frame.
+    void reset(size_t retained_bytes = std::numeric_limits<size_t>::max());
+
+    /// Reclaim unused object pool blocks
+    void reclaim_memory();
+
+    /// Moves live objects out of the least occupied blocks into the most
+    /// occupied ones with move construction, then frees the blocks this
+    /// call emptied. Empty blocks which were already in the pool are kept.
+    /// on_move(from, to) is called once each object has been constructed
+    /// at its new address, before the old object is destroyed, so
+    /// handle_of(from) is still valid. With generations enabled objects are
+    /// moved to the lowest block indices instead, and only emptied blocks at
+    /// the end of the pool are freed.
+    ///
+    /// At most max_moves objects are moved per call so compaction can be
+    /// spread across frames. The block order is computed by the first call
+    /// of a pass and kept until it finishes, so later calls cost about as
+    /// much as the objects they move. Blocks added in the meantime join the
+    /// next pass. Returns true once no more objects can be moved.
+    template <typename F>
+    bool compact(F on_move, size_t max_moves = std::numeric_limits<size_t>::max());
+
+    /// Calls the given function for all allocated entries. The non-const
+    /// overload collects remote frees first, the const one requires that
+    /// none are pending.
+    template <typename F>
+    void for_each(const F func);
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Calls the given function for all allocated entries, split into tasks
+    /// which may run concurrently. Each task covers chunk_size entries of a
+    /// block, rounded up to a whole bitmap word, or a whole block if
+    /// chunk_size is zero. executor(num_tasks, run) must call run(i) once for
+    /// every task index i in [0, num_tasks) and return when they are done,
+    /// e.g. ObjectPoolThreadExecutor or a wrapper around a job system.
+    /// Objects must not be created or deleted until it returns. Remote frees
+    /// are handled as by for_each.
+    template <typename F, typename E>
+    void parallel_for_each(const F func, E&& executor, index_t chunk_size = 0);
+    template <typename F, typename E>
+    void parallel_for_each(const F func, E&& executor, index_t chunk_size = 0) const;
+
+    /// Forward iterator over allocated entries, V is T or const T. Empty
+    /// entries are skipped a bitmap word at a time. Deleting the entry an
+    /// iterator refers to is allowed, but creating objects or reclaiming memory while
+    /// iterating invalidates iterators.
+    template <typename V>
+    class Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+        Iterator();
+
+        /// Converts an iterator to a const_iterator
+        template <typename U,
+            typename = typename std::enable_if<std::is_convertible<U*, V*>::value>::type>
+        Iterator(const Iterator<U>& other);
+
+        V& operator*() const;
+        V* operator->() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        friend class DynamicObjectPool;
+        template <typename U>
+        friend class Iterator;
+
+        Iterator(const DynamicObjectPool* pool, index_t block_index, index_t index);
+
+        /// Moves to the first allocated entry at or after the current
+        /// position, or to the end position
+        void seek();
+
+        const DynamicObjectPool* pool_;
+        /// index of the block info and the entry within the block
+        index_t block_index_;
+        index_t index_;
+    };
+
+    typedef Iterator<T> iterator;
+    typedef Iterator<const T> const_iterator;
+
+    /// Returns iterators over allocated entries. Remote frees are handled as
+    /// by for_each.
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /// Returns object pool stats, this doesn't need to visit every entry
+    ObjectPoolStats calc_stats() const;
+
+    /// Returns a snapshot of the pool's telemetry. Requires a policy with
+    /// telemetry.
+    ObjectPoolTelemetry telemetry() const;
+
+    /// Sets the telemetry counters to zero
+    void reset_telemetry();
+
+    /// Returns true if the pointer was allocated from this pool
+    bool owns(const T* ptr) const;
+
+    /// Returns a handle to an allocated object which can be checked for
+    /// validity after the object is deleted. Requires a policy with
+    /// generations. Zero is never a valid handle.
+    handle_t handle_of(const T* ptr) const;
+
+    /// Returns the object for a handle, or nullptr if it has been deleted
+    T* resolve(handle_t handle) const;
+
+    /// Returns true if the handle refers to a live object
+    bool is_valid(handle_t handle) const;
+
+    /// Writes every block to a file which load can map back in, e.g. to warm
+    /// start a process with a large pool. T must be trivially copyable and
+    /// no remote frees may be pending. Returns false if the file couldn't be
+    /// written.
+    bool save(const char* path) const;
+
+    /// Replaces the pool's blocks with ones mapped from a file written by
+    /// save from a pool of the same type and max block size, so restoring
+    /// costs page faults rather than copies. The pool must be empty. Each
+    /// block is mapped separately, so blocks should be much larger than a
+    /// page. The mapping is copy on write so changes stay in memory unless
+    /// shared is true, in which case they are written back to the file.
+    /// Handles saved with the pool stay valid, handles from before load
+    /// don't. The pool may be destroyed without deleting loaded objects.
+    /// Returns false and leaves the pool unchanged if the file can't be
+    /// mapped or doesn't match the pool's layout.
+    bool load(const char* path, bool shared = false);
+
+private:
+    typedef detail::ObjectPoolBlock<T, Policy> Block;
+
+    /// The BlockInfo struct keeps regularly accessed block information
+    /// packed together for better memory locality.
+    struct BlockInfo
+    {
+        /// cache the number of free entries for this block
+        index_t num_free_;
+        /// the number of entries in this block
+        index_t num_entries_;
+        /// indices of the next and previous block infos with space, only
+        /// valid when this block is in the free block list
+        index_t next_free_;
+        index_t prev_free_;
+        /// pointer to the block itself
+        Block* block_;
+    };
+
+    /// storage for block info records
+    BlockInfo* block_info_;
+    /// number of blocks allocated
+    index_t num_blocks_;
+    /// number of block info records there is storage for
+    index_t block_info_capacity_;
+    /// index of the first block info in the list of blocks with space
+    index_t free_block_index_;
+    /// the number of entries in the first block
+    const index_t entries_per_block_;
+    /// the number of entries in the largest block the pool may create
+    const index_t max_entries_per_block_;
+    /// controls the size of new blocks
+    const ObjectPoolGrowth growth_;
+    /// allocator for block memory
+    const ObjectPoolBlockAllocator allocator_;
+    /// power of two alignment of each block, used to find the owning block
+    /// of a pointer by masking off the low bits of its address
+    const size_t block_align_;
+    /// number of live objects in all blocks
+    size_t num_allocations_;
+    /// highest number of live objects since the pool was created
+    size_t peak_allocations_;
+    /// number of blocks with no live objects
+    index_t num_free_blocks_;
+    /// total number of entries in all blocks
+    size_t capacity_;
+    /// total size in bytes of all blocks
+    size_t bytes_in_blocks_;
+    /// number of low bits of a handle position holding the entry index
+    const unsigned handle_index_bits_;
+    /// generation that entries of the next new block start from, this is
+    /// above any generation of a block reclaimed from the same index
+    index_t first_generation_;
+    /// head of the list of entries freed by other threads, each entry's
+    /// storage holds a pointer to the next
+    std::atomic<void*> remote_frees_;
+    detail::TelemetryCounters<Policy> telemetry_;
+    /// blocks mapped from a file by load sorted by address. These are rare
+    /// so are kept here rather than growing every BlockInfo.
+    std::vector<const Block*> mapped_blocks_;
+    /// copy of the pointers passed to delete_objects grouped by block and
+    /// the start of each block's group, kept between calls and released by
+    /// reclaim_memory
+    std::vector<const T*> delete_scratch_;
+    std::vector<index_t> delete_block_starts_;
+    /// blocks of the current compaction pass in order of preference as a
+    /// destination and the cursors into it, kept between calls so each
+    /// call only does work proportional to its move budget. Blocks are
+    /// held by pointer as freeing blocks changes their indices.
+    std::vector<Block*> compact_order_;
+    size_t compact_dst_;
+    size_t compact_src_;
+    /// blocks emptied by the current call to compact
+    std::vector<Block*> compact_emptied_;
+
+    /// Adds a new block and updates the free_block_index.
+    BlockInfo* add_block();
+
+    /// Frees a block's memory, unmapping it if it was mapped by load
+    void destroy_block(Block* block);
+
+    /// Returns the number of entries the next new block should have.
+    index_t next_block_entries() const;
+
+    /// Rounds a number of entries up so the block fills whole pages of
+    /// the given size, a page size of zero leaves it unchanged
+    static index_t round_to_pages(index_t num_entries, size_t page_size);
+
+    /// Rebuilds the list of blocks with space from the block info array.
+    void rebuild_free_list();
+
+    /// Adds a block which has just gained space to the free block list, at
+    /// the front or in index order if the policy is address ordered
+    void link_free_block(index_t block_index);
+
+    /// Removes a block which has just become full from the free block list
+    void unlink_free_block(index_t block_index);
+
+    /// Allocates an entry from a block with space and updates counts
+    T* allocate_from(BlockInfo* p_info);
+
+    /// Updates counts and the free block list after count entries of the
+    /// given block have been deleted.
+    void on_entries_freed(index_t block_index, index_t count);
+
+    /// Deletes objects, freeing each run of pointers into the same block
+    /// together. Address ordered pools rebuild the free block list once at
+    /// the end instead of inserting each block which was full.
+    void delete_block_runs(const T* const* ptrs, index_t count);
+
+    /// Frees empty blocks from index first_empty on and shrinks the block
+    /// info array to fit
+    void free_blocks_from(index_t first_empty);
+
+    /// Frees a single empty block, moving the last block info into its
+    /// place. Only the last block may be freed if generations are enabled.
+    void free_block(index_t block_index);
+
+    DynamicObjectPool(const DynamicObjectPool&) = delete;
+    DynamicObjectPool& operator=(const DynamicObjectPool&) = delete;
+};
+
+/// NumaObjectPool keeps a DynamicObjectPool for each NUMA node. The blocks
+/// of each node's pool are mapped on that node and new objects are
+/// allocated from the calling thread's node by default, so threads mostly
+/// access local memory. Like DynamicObjectPool it is not thread safe.
+template <typename T>
+class NumaObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+
+    /// Creates a pool for every NUMA node in the system. Blocks are sized
+    /// to fill whole huge pages.
+    NumaObjectPool(index_t entries_per_block,
+        const ObjectPoolGrowth& growth = ObjectPoolGrowth::fixed());
+
+    /// Returns the number of NUMA nodes, this is one on systems without NUMA
+    index_t num_nodes() const;
+
+    /// Returns the NUMA node of the processor the calling thread is running
+    /// on, clamped to the nodes of this pool
+    index_t current_node() const;
+
+    /// Constructs a new object on the calling thread's node. Returns nullptr
+    /// if there is no available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Constructs a new object from the given node, falling back to other
+    /// nodes if it fails. Returns nullptr if no node has available space.
+    template <class... P>
+    T* new_object_on_node(index_t node, P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool.
+    void delete_object(const T* ptr);
+
+    /// Returns the node whose pool owns the given pointer
+    index_t node_of(const T* ptr) const;
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Reclaim unused object pool blocks on all nodes
+    void reclaim_memory();
+
+    /// Calls the given function for all allocated entries
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Returns object pool stats summed over all nodes
+    ObjectPoolStats calc_stats() const;
+
+    /// Returns object pool stats for a single node
+    ObjectPoolStats calc_node_stats(index_t node) const;
+
+private:
+    typedef DynamicObjectPool<T> NodePool;
+    std::vector<std::unique_ptr<NodePool> > nodes_;
+
+    NumaObjectPool(const NumaObjectPool&) = delete;
+    NumaObjectPool& operator=(const NumaObjectPool&) = delete;
+};
+
+/// ObjectPoolMemoryResource serves raw allocations of up to
+/// MAX_POOLED_SIZE bytes from DynamicObjectPools of untyped storage, one
+/// for each power of two size. Nothing is constructed in the storage.
+/// Larger or over aligned allocations come from the heap. Like
+/// DynamicObjectPool it is not thread safe. All memory is released when the
+/// resource is destroyed.
+class ObjectPoolMemoryResource
+{
+public:
+    typedef detail::index_t index_t;
+
+    /// Largest allocation size served from the pools
+    static const size_t MAX_POOLED_SIZE = 256;
+
+    /// Each size class pool starts with a block of entries_per_block
+    /// entries and grows geometrically up to max_entries_per_block.
+    explicit ObjectPoolMemoryResource(
+        index_t entries_per_block = 64, index_t max_entries_per_block = 4096);
+    ~ObjectPoolMemoryResource();
+
+    /// Returns storage for bytes bytes with the given power of two
+    /// alignment. Failure is reported like operator new, by throwing
+    /// std::bad_alloc or aborting if exceptions are disabled.
+    void* allocate(size_t bytes, size_t alignment = detail::MAX_RAW_ALIGN);
+
+    /// Frees storage returned by allocate, bytes and alignment must match
+    /// the values it was allocated with
+    void deallocate(void* ptr, size_t bytes, size_t alignment = detail::MAX_RAW_ALIGN);
+
+    /// Frees unused blocks of every size class
+    void reclaim_memory();
+
+    /// Returns the stats of all size class pools combined, heap allocations
+    /// are not included
+    ObjectPoolStats calc_stats() const;
+
+private:
+    /// Returns the index of the size class pool for an allocation, or
+    /// NUM_SIZE_CLASSES if it isn't pooled
+    static index_t size_class(size_t bytes, size_t alignment);
+
+    static const index_t NUM_SIZE_CLASSES = 6;
+
+    DynamicObjectPool<detail::RawStorage<8> > pool8_;
+    DynamicObjectPool<detail::RawStorage<16> > pool16_;
+    DynamicObjectPool<detail::RawStorage<32> > pool32_;
+    DynamicObjectPool<detail::RawStorage<64> > pool64_;
+    DynamicObjectPool<detail::RawStorage<128> > pool128_;
+    DynamicObjectPool<detail::RawStorage<256> > pool256_;
+
+    ObjectPoolMemoryResource(const ObjectPoolMemoryResource&) = delete;
+    ObjectPoolMemoryResource& operator=(const ObjectPoolMemoryResource&) = delete;
+};
+
+/// Standard allocator which allocates from an ObjectPoolMemoryResource, for
+/// node based containers such as std::list, std::map and std::unordered_map.
+/// Rebound copies share the same resource.
+template <typename T>
+class ObjectPoolAllocator
+{
+public:
+    typedef T value_type;
+
+    ObjectPoolAllocator(ObjectPoolMemoryResource* resource);
+    template <typename U>
+    ObjectPoolAllocator(const ObjectPoolAllocator<U>& other);
+
+    T* allocate(size_t n);
+    void deallocate(T* ptr, size_t n);
+
+    ObjectPoolMemoryResource* resource() const;
+
+private:
+    ObjectPoolMemoryResource* resource_;
+};
+
+template <typename T, typename U>
+bool operator==(const ObjectPoolAllocator<T>& a, const ObjectPoolAllocator<U>& b);
+template <typename T, typename U>
+bool operator!=(const ObjectPoolAllocator<T>& a, const ObjectPoolAllocator<U>& b);
+
+#if OBJECT_POOL_HAS_PMR
+/// std::pmr::memory_resource which allocates from an
+/// ObjectPoolMemoryResource, for use with std::pmr containers
+class PmrObjectPoolResource : public std::pmr::memory_resource
+{
+public:
+    typedef detail::index_t index_t;
+
+    explicit PmrObjectPoolResource(
+        index_t entries_per_block = 64, index_t max_entries_per_block = 4096);
+
+    /// Returns the underlying pools
+    ObjectPoolMemoryResource& pools();
+    const ObjectPoolMemoryResource& pools() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    ObjectPoolMemoryResource pools_;
+};
+#endif
+
+/// SizeClassPool allocates objects of any type up to MAX_SIZE bytes from
+/// slabs shared by all types of a similar size. Each size class is a
+/// multiple of GRANULARITY bytes and keeps its own list of slabs, and each
+/// slab has a free list of its entries so allocation and deletion are
+/// O(1). Slabs are aligned to their size so the owning slab of a pointer is
+/// found by masking its address. Like DynamicObjectPool it is not thread
+/// safe.
+class SizeClassPool
+{
+public:
+    typedef detail::index_t index_t;
+
+    /// Size classes are multiples of this, which is also the alignment of
+    /// every entry
+    static const size_t GRANULARITY = 16;
+    /// Largest object size supported
+    static const size_t MAX_SIZE = 512;
+    static const index_t NUM_SIZE_CLASSES = MAX_SIZE / GRANULARITY;
+
+    /// Creates a pool with slabs of slab_size bytes, which must be a power
+    /// of two with room for several entries of MAX_SIZE. Slabs are allocated
+    /// on demand.
+    explicit SizeClassPool(size_t slab_size = 64 * 1024,
+        const ObjectPoolBlockAllocator& allocator = ObjectPoolBlockAllocator());
+    ~SizeClassPool();
+
+    /// Constructs a new object in its size class. Returns nullptr if there
+    /// is no memory for a new slab.
+    template <typename T, class... P>
+    T* new_object(P&&... params);
+
+    /// Deletes an object created by new_object
+    template <typename T>
+    void delete_object(const T* ptr);
+
+    /// Returns uninitialised storage of at least size bytes, or nullptr if
+    /// size is above MAX_SIZE or there is no memory for a new slab
+    void* allocate(size_t size);
+
+    /// Frees storage returned by allocate, the size isn't needed as it is
+    /// recorded in the owning slab
+    void deallocate(const void* ptr);
+
+    /// Frees slabs which have no allocations
+    void reclaim_memory();
+
+    /// Returns stats for all size classes combined, each slab is a block
+    ObjectPoolStats calc_stats() const;
+
+    /// Returns stats for a single size class
+    ObjectPoolStats calc_class_stats(index_t size_class) const;
+
+    /// Returns the size class for an allocation of size bytes
+    static index_t size_class_of(size_t size);
+
+private:
+    /// Header at the start of each slab, it is followed by the free list
+    /// indices and the entries
+    struct SlabHeader
+    {
+        detail::FreeList<false> free_list_;
+        index_t size_class_;
+        /// index of this slab in its size class's slab list
+        index_t slab_index_;
+        index_t num_allocations_;
+    };
+
+    struct SlabInfo
+    {
+        SlabHeader* slab_;
+        /// index of the next slab with space, only valid when this slab is
+        /// in the free slab list
+        index_t next_free_;
+    };
+
+    struct SizeClass
+    {
+        std::vector<SlabInfo> slabs_;
+        /// index of the first slab in the list of slabs with space
+        index_t free_slab_index_;
+        /// number of entries in each slab
+        index_t entries_per_slab_;
+        /// byte offset of the first entry from the start of a slab
+        size_t entries_offset_;
+        size_t num_allocations_;
+        size_t peak_allocations_;
+    };
+
+    /// Adds a new slab to a size class and pushes it on its free slab list
+    bool add_slab(index_t size_class);
+
+    /// Returns the start of a slab's free list indices and entries
+    static index_t* slab_indices(SlabHeader* slab);
+    uint8_t* slab_entries(SlabHeader* slab) const;
+
+    SizeClass classes_[NUM_SIZE_CLASSES];
+    const size_t slab_size_;
+    const ObjectPoolBlockAllocator allocator_;
+
+    SizeClassPool(const SizeClassPool&) = delete;
+    SizeClassPool& operator=(const SizeClassPool&) = delete;
+};
+
+/// SoaObjectPool is a dynamically growing pool which stores each of the
+/// given types in a separate column array, so an entry is a slot index
+/// across several parallel arrays. Iterating a subset of columns only loads
+/// the memory of those columns, and runs of live entries are visited with a
+/// plain loop over contiguous elements which the compiler can vectorise.
+///
+/// Blocks have a power of two number of entries, at least 64, and columns
+/// are cache line aligned.
+template <typename... Ts>
+class SoaObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+
+    /// Type of the column with the given index
+    template <size_t I>
+    using column_t = typename std::tuple_element<I, std::tuple<Ts...> >::type;
+
+    static const size_t NUM_COLUMNS = sizeof...(Ts);
+
+    /// Marks a missing entry
+    static const index_t INVALID_INDEX = ~index_t(0);
+
+    SoaObjectPool(index_t entries_per_block);
+    ~SoaObjectPool();
+
+    /// Constructs a new entry, each column is constructed from the
+    /// corresponding parameter or default constructed if there are no
+    /// parameters. Returns the entry's index or INVALID_INDEX if there is no
+    /// available space.
+    template <class... P>
+    index_t new_object(P&&... params);
+
+    /// Deletes the entry with the given index.
+    void delete_object(index_t entry);
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Returns a column value of a live entry
+    template <size_t I>
+    column_t<I>& get(index_t entry);
+    template <size_t I>
+    const column_t<I>& get(index_t entry) const;
+
+    /// Calls func with a reference to the given columns of every live
+    /// entry, e.g. for_each<0, 1>([](Position& p, Velocity& v) { ... }).
+    /// Entries must not be created or deleted by func.
+    template <size_t... Columns, typename F>
+    void for_each(F func);
+
+    /// Returns object pool stats, this doesn't need to visit every entry
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef detail::bitmap_word_t bitmap_word_t;
+    static const index_t BITS_PER_WORD = sizeof(bitmap_word_t) * 8;
+
+    /// Header at the start of each block's allocation, it is followed by
+    /// the free list indices, the occupancy bitmap and the columns.
+    struct BlockHeader
+    {
+        BlockHeader() : free_list_(0), num_allocations_(0) {}
+
+        detail::FreeList<false> free_list_;
+        index_t num_allocations_;
+    };
+
+    struct BlockInfo
+    {
+        /// start of the block allocation
+        uint8_t* block_;
+        /// index of the next block info with space, only valid when this
+        /// block is in the free block list
+        index_t next_free_;
+    };
+
+    BlockHeader* header(index_t block_index) const;
+    index_t* indices(index_t block_index) const;
+    bitmap_word_t* bitmap(index_t block_index) const;
+    template <size_t I>
+    column_t<I>* column(index_t block_index) const;
+
+    /// Constructs the columns of an entry from params, or default
+    /// constructs them if there are no params
+    template <size_t... I, class... P>
+    void construct(detail::index_sequence<I...>, std::false_type, index_t entry, P&&... params);
+    template <size_t... I>
+    void construct(detail::index_sequence<I...>, std::true_type, index_t entry);
+    template <size_t... I>
+    void destruct(detail::index_sequence<I...>, index_t entry);
+
+    /// Allocates a slot, returning its entry index or INVALID_INDEX
+    index_t allocate();
+
+    /// Adds a new block and pushes it on the free block list
+    bool add_block();
+
+    std::vector<BlockInfo> blocks_;
+    /// index of the first block in the list of blocks with space
+    index_t free_block_index_;
+    /// the number of entries in each block, a power of two
+    const index_t entries_per_block_;
+    /// log2 of entries_per_block_ for splitting entry indices
+    const uint32_t entry_shift_;
+    /// byte offsets of each part of a block from its start
+    size_t bitmap_offset_;
+    size_t column_offsets_[NUM_COLUMNS];
+    size_t block_size_;
+    /// number of live entries in all blocks
+    size_t num_allocations_;
+    /// highest number of live entries since the pool was created
+    size_t peak_allocations_;
+
+    SoaObjectPool(const SoaObjectPool&) = delete;
+    SoaObjectPool& operator=(const SoaObjectPool&) = delete;
+};
+
+/// ConcurrentObjectPool is a thread safe dynamically growing pool. Each
+/// thread allocates from and frees to a small private cache of entries
+/// which is refilled from or flushed to shared ObjectPoolBlocks in batches.
+/// Each shared block has its own lock so frees from any thread are returned
+/// to their owning block without a pool wide lock.
+///
+/// Unlike the other pools there is no for_each or delete_all as iterating
+/// a pool which other threads are modifying isn't meaningful.
+template <typename T>
+class ConcurrentObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+
+    /// Creates a pool of blocks with entries_per_block entries. Each thread
+    /// caches up to cache_size free entries.
+    ConcurrentObjectPool(index_t entries_per_block, index_t cache_size = 64);
+    ~ConcurrentObjectPool();
+
+    /// Constructs a new object from the pool. Returns nullptr if there is no
+    /// available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool, it
+    /// may have been allocated by a different thread.
+    void delete_object(const T* ptr);
+
+    /// Returns entries cached by the calling thread to their blocks. This
+    /// happens automatically when a thread exits.
+    void flush_thread_cache();
+
+    /// Calculates object pool stats. Entries in thread caches count as
+    /// used for num_free_blocks and peak_allocations is not tracked.
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef detail::ObjectPoolBlock<T> Block;
+
+    /// Per thread cache of free entries
+    struct ThreadCache
+    {
+        /// cached free entries
+        T** entries_;
+        /// number of cached entries
+        index_t count_;
+        /// index of the block to start searching from when refilling
+        index_t next_block_;
+        /// number of objects constructed minus deleted by this thread, only
+        /// written by the owning thread
+        std::atomic<int64_t> num_live_;
+    };
+
+    /// Shared block information
+    struct BlockInfoData
+    {
+        /// number of free entries in the block, modified under lock_
+        std::atomic<index_t> num_free_;
+        /// lock guarding access to the block
+        detail::SpinLock lock_;
+        /// pointer to the block itself
+        Block* block_;
+    };
+
+    /// Shared block information padded to a cache line to avoid false
+    /// sharing between threads using neighbouring blocks
+    struct BlockInfo : BlockInfoData
+    {
+        uint8_t padding_[detail::MIN_BLOCK_ALIGN - sizeof(BlockInfoData)];
+    };
+
+    /// Block info records are allocated in segments which never move so
+    /// they can be read without locking while the pool grows. Each segment
+    /// is double the size of the previous one.
+    static const index_t FIRST_SEGMENT_SIZE = 64;
+    static const index_t MAX_SEGMENTS = 32;
+
+    /// Pool state shared with thread caches so threads can safely return
+    /// their cached entries on exit if the pool still exists.
+    struct State
+    {
+        State(index_t entries_per_block, index_t cache_size);
+        ~State();
+
+        /// Returns the block info record for the given block index
+        BlockInfo& block_info(index_t index) const;
+
+        /// Fills the cache with up to half cache_size_ free entries
+        void refill(ThreadCache& cache);
+
+        /// Returns count entries from the start of the cache to their blocks
+        void flush(ThreadCache& cache, index_t count);
+
+        /// Adds a new block with index num_blocks if no other thread has
+        /// added one first.
+        void add_block(index_t num_blocks);
+
+        /// Flushes and unregisters a cache from a thread which is exiting
+        void retire(ThreadCache* cache);
+
+        /// the number of entries in each block
+        const index_t entries_per_block_;
+        /// the maximum number of entries in each thread cache
+        const index_t cache_size_;
+        /// power of two alignment of each block, used to find the owning
+        /// block of a pointer by masking off the low bits of its address
+        const size_t block_align_;
+        /// number of blocks allocated
+        std::atomic<index_t> num_blocks_;
+        /// index of a block which recently had entries freed to it
+        std::atomic<index_t> free_block_hint_;
+        /// block info segments
+        std::atomic<BlockInfo*> segments_[MAX_SEGMENTS];
+        /// serialises adding blocks
+        std::mutex grow_mutex_;
+        /// guards caches_ and retired_live_
+        mutable std::mutex caches_mutex_;
+        /// all thread caches for this pool
+        std::vector<ThreadCache*> caches_;
+        /// live object count from caches of threads which have exited
+        int64_t retired_live_;
+    };
+
+    /// The calling thread's caches for each ConcurrentObjectPool<T>.
+    /// Destroying this on thread exit returns cached entries to any pools
+    /// which still exist.
+    struct ThreadCacheList
+    {
+        struct Entry
+        {
+            uint64_t pool_id_;
+            std::weak_ptr<State> state_;
+            ThreadCache* cache_;
+        };
+
+        ThreadCacheList();
+        ~ThreadCacheList();
+
+        std::vector<Entry> entries_;
+        /// the most recently used cache
+        uint64_t last_pool_id_;
+        ThreadCache* last_cache_;
+    };
+
+    /// Returns the calling thread's cache for this pool, creating it if needed
+    ThreadCache& thread_cache();
+
+    /// Creates a ThreadCache and registers it with the pool state
+    static ThreadCache* create_cache(State& state);
+    static void destroy_cache(ThreadCache* cache);
+
+    std::shared_ptr<State> state_;
+    /// unique identifier for this pool, never reused
+    const uint64_t pool_id_;
+
+    ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+    ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
 };
 
 #include "object_pool.inl"
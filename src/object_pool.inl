@@ -11,435 +11,4248 @@
 namespace detail
 {
 
-const uint32_t MIN_BLOCK_ALIGN = 64;
+/// Marks the end of a list of indices
+const index_t INVALID_INDEX = ~index_t(0);
 
 void* aligned_malloc(size_t size, size_t align);
 void aligned_free(void* ptr);
 
+/// Reports a failed raw allocation like operator new
+void throw_bad_alloc();
+
+/// Returns a unique identifier for a ConcurrentObjectPool
+uint64_t next_pool_id();
+
+/// Returns the number of NUMA nodes in the system, at least one
+uint32_t numa_node_count();
+
+/// Returns the NUMA node of the processor the calling thread is running on
+uint32_t current_numa_node();
+
+/// Header at the start of a file written by a pool's save. It is followed
+/// by a table of num_blocks PoolFileBlocks, then the blocks themselves as
+/// they are laid out in memory, each aligned so it can be mapped separately.
+struct PoolFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    /// layout of the saved pool's blocks, load requires these to match
+    uint32_t value_size;
+    uint32_t value_align;
+    uint32_t policy_flags;
+    uint32_t index_size;
+    uint32_t handle_size;
+    uint32_t reserved;
+    uint64_t max_entries_per_block;
+    /// state of the saved pool
+    uint64_t num_blocks;
+    uint64_t peak_allocations;
+    uint64_t first_generation;
+};
+
+/// Location of a block in a pool file
+struct PoolFileBlock
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t num_entries;
+};
+
+/// Writes a pool file. Fills in the header's identification and the offset
+/// of each block, block_ptrs[i] holds the contents of blocks[i].
+bool write_pool_file(const char* path, PoolFileHeader& header, PoolFileBlock* blocks,
+    const void* const* block_ptrs);
+
+/// Reads the header and block table of a pool file. Returns false if the
+/// file can't be read or its layout doesn't match the expected header.
+bool read_pool_file(const char* path, const PoolFileHeader& expected, PoolFileHeader& header,
+    std::vector<PoolFileBlock>& blocks);
+
+/// Maps each block of a pool file at an address aligned to align, copy on
+/// write unless shared is true. If any block can't be mapped none are.
+bool map_pool_file_blocks(const char* path, bool shared, size_t align,
+    const std::vector<PoolFileBlock>& blocks, std::vector<void*>& ptrs);
+
+/// Allocator which frees blocks mapped by map_pool_file_blocks
+const ObjectPoolBlockAllocator& pool_file_allocator();
+
+/// Returns a header describing the block layout of pools of T
+template <typename T, typename Policy>
+PoolFileHeader make_pool_file_header(uint64_t max_entries_per_block)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "saved objects must be trivially copyable");
+    PoolFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.value_size = sizeof(T);
+    header.value_align = std::alignment_of<T>::value;
+    header.policy_flags = (Policy::lock_free ? 1u : 0u) | (Policy::generations ? 2u : 0u)
+        | (Policy::dense ? 4u : 0u) | (Policy::align_entries ? 8u : 0u)
+        | (Policy::pad_entries ? 16u : 0u) | (Policy::address_ordered ? 32u : 0u);
+    header.index_size = sizeof(typename Policy::index_t);
+    header.handle_size = sizeof(typename Policy::handle_t);
+    header.max_entries_per_block = max_entries_per_block;
+    return header;
+}
+
+inline SpinLock::SpinLock()
+{
+    flag_.clear();
+}
+
+inline void SpinLock::lock()
+{
+    while (flag_.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+inline void SpinLock::unlock()
+{
+    flag_.clear(std::memory_order_release);
+}
+
+// Returns the index of the most significant set bit of n
+inline uint32_t floor_log2(uint32_t n)
+{
+    assert(n != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, n);
+    return index;
+#else
+    return 31 - __builtin_clz(n);
+#endif
+}
+
+template <typename I>
+I load_index(const I& index)
+{
+    return index;
+}
+
+template <typename I>
+I load_index(const std::atomic<I>& index)
+{
+    return index.load(std::memory_order_relaxed);
+}
+
+template <typename I>
+void store_index(I& index, typename NonDeduced<I>::type value)
+{
+    index = value;
+}
+
+template <typename I>
+void store_index(std::atomic<I>& index, typename NonDeduced<I>::type value)
+{
+    index.store(value, std::memory_order_relaxed);
+}
+
+template <typename I>
+I add_index(I& index, typename NonDeduced<I>::type value)
+{
+    return index += value;
+}
+
+template <typename I>
+I add_index(std::atomic<I>& index, typename NonDeduced<I>::type value)
+{
+    return index.fetch_add(value, std::memory_order_relaxed) + value;
+}
+
+template <typename I>
+I sub_index(I& index, typename NonDeduced<I>::type value)
+{
+    return index -= value;
+}
+
+template <typename I>
+I sub_index(std::atomic<I>& index, typename NonDeduced<I>::type value)
+{
+    return index.fetch_sub(value, std::memory_order_relaxed) - value;
+}
+
+template <typename I>
+void max_index(I& index, typename NonDeduced<I>::type value)
+{
+    if (index < value)
+    {
+        index = value;
+    }
+}
+
+template <typename I>
+void max_index(std::atomic<I>& index, typename NonDeduced<I>::type value)
+{
+    I current = index.load(std::memory_order_relaxed);
+    while (current < value
+        && !index.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+template <typename I>
+I claim_indices(I& index, typename NonDeduced<I>::type limit, typename NonDeduced<I>::type count,
+    typename NonDeduced<I>::type& first)
+{
+    first = index;
+    const I num_claimed = std::min<I>(count, limit - first);
+    index = first + num_claimed;
+    return num_claimed;
+}
+
+template <typename I>
+I claim_indices(std::atomic<I>& index, typename NonDeduced<I>::type limit,
+    typename NonDeduced<I>::type count, typename NonDeduced<I>::type& first)
+{
+    I current = index.load(std::memory_order_relaxed);
+    I num_claimed;
+    do
+    {
+        num_claimed = std::min<I>(count, limit - current);
+        if (num_claimed == 0)
+        {
+            break;
+        }
+    } while (!index.compare_exchange_weak(
+        current, current + num_claimed, std::memory_order_relaxed));
+    first = current;
+    return num_claimed;
+}
+
+inline bitmap_word_t load_bits(const bitmap_word_t& word)
+{
+    return word;
+}
+
+inline bitmap_word_t load_bits(const std::atomic<bitmap_word_t>& word)
+{
+    return word.load(std::memory_order_relaxed);
+}
+
+inline void set_bits(bitmap_word_t& word, bitmap_word_t mask)
+{
+    word |= mask;
+}
+
+inline void set_bits(std::atomic<bitmap_word_t>& word, bitmap_word_t mask)
+{
+    word.fetch_or(mask, std::memory_order_relaxed);
+}
+
+inline void clear_bits(bitmap_word_t& word, bitmap_word_t mask)
+{
+    word &= ~mask;
+}
+
+inline void clear_bits(std::atomic<bitmap_word_t>& word, bitmap_word_t mask)
+{
+    word.fetch_and(~mask, std::memory_order_relaxed);
+}
+
+inline void prefetch(const void* ptr)
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(ptr);
+#else
+    (void)ptr;
+#endif
+}
+
+inline uint64_t read_cycle_counter()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    return __rdtsc();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+#endif
+}
+
+// Returns the index of the least significant set bit of n
+inline uint32_t count_trailing_zeros(uint64_t n)
+{
+    assert(n != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, n);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<uint32_t>(n)))
+    {
+        return index;
+    }
+    _BitScanForward(&index, static_cast<uint32_t>(n >> 32));
+    return index + 32;
+#else
+    return __builtin_ctzll(n);
+#endif
+}
+
+template <typename I>
+FreeList<false, I>::FreeList(I head) : head_(head)
+{
+}
+
+template <typename I>
+void FreeList<false, I>::reset(I head)
+{
+    head_ = head;
+}
+
+template <typename I>
+I FreeList<false, I>::pop(const index_storage_t* indices, I end)
+{
+    const I index = head_;
+    if (index != end)
+    {
+        head_ = indices[index];
+    }
+    return index;
+}
+
+template <typename I>
+void FreeList<false, I>::push(index_storage_t* indices, I index)
+{
+    indices[index] = head_;
+    head_ = index;
+}
+
+template <typename I>
+I FreeList<false, I>::pop_n(const index_storage_t* indices, I end, I* out, I count)
+{
+    I num_popped = 0;
+    I index = head_;
+    while (num_popped != count && index != end)
+    {
+        out[num_popped++] = index;
+        index = indices[index];
+    }
+    head_ = index;
+    return num_popped;
+}
+
+template <typename I>
+void FreeList<false, I>::push_n(index_storage_t* indices, I first, I last)
+{
+    indices[last] = head_;
+    head_ = first;
+}
+
+template <typename I>
+FreeList<true, I>::FreeList(I head) : head_(head)
+{
+}
+
+template <typename I>
+void FreeList<true, I>::reset(I head)
+{
+    head_.store(head, std::memory_order_relaxed);
+}
+
+template <typename I>
+I FreeList<true, I>::pop(const index_storage_t* indices, I end)
+{
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (;;)
+    {
+        const I index = static_cast<I>(head);
+        if (index == end)
+        {
+            return end;
+        }
+        // the next index may be stale if another thread has popped this
+        // entry, the counter ensures the exchange fails in that case
+        const uint64_t next = indices[index].load(std::memory_order_relaxed);
+        const uint64_t update = (((head >> 32) + 1) << 32) | next;
+        if (head_.compare_exchange_weak(
+                head, update, std::memory_order_acquire, std::memory_order_acquire))
+        {
+            return index;
+        }
+    }
+}
+
+template <typename I>
+void FreeList<true, I>::push(index_storage_t* indices, I index)
+{
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t update;
+    do
+    {
+        indices[index].store(static_cast<I>(head), std::memory_order_relaxed);
+        update = (((head >> 32) + 1) << 32) | index;
+    } while (!head_.compare_exchange_weak(
+        head, update, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <typename I>
+I FreeList<true, I>::pop_n(const index_storage_t* indices, I end, I* out, I count)
+{
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (;;)
+    {
+        // entries are only ever removed from the head so if the counter is
+        // unchanged then no links in the chain have been modified either
+        I num_popped = 0;
+        I index = static_cast<I>(head);
+        while (num_popped != count && index != end)
+        {
+            out[num_popped++] = index;
+            index = indices[index].load(std::memory_order_relaxed);
+        }
+        if (num_popped == 0)
+        {
+            return 0;
+        }
+        const uint64_t update = (((head >> 32) + 1) << 32) | index;
+        if (head_.compare_exchange_weak(
+                head, update, std::memory_order_acquire, std::memory_order_acquire))
+        {
+            return num_popped;
+        }
+    }
+}
+
+template <typename I>
+void FreeList<true, I>::push_n(index_storage_t* indices, I first, I last)
+{
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t update;
+    do
+    {
+        indices[last].store(static_cast<I>(head), std::memory_order_relaxed);
+        update = (((head >> 32) + 1) << 32) | first;
+    } while (!head_.compare_exchange_weak(
+        head, update, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <typename Policy>
+TelemetryCounters<Policy, true>::TelemetryCounters()
+{
+    reset();
+}
+
+template <typename Policy>
+uint64_t TelemetryCounters<Policy, true>::begin_sample()
+{
+    if (add_index(num_sample_calls_, 1) % Policy::telemetry_sample_interval != 0)
+    {
+        return 0;
+    }
+    return read_cycle_counter();
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::end_alloc_sample(uint64_t start)
+{
+    add_sample(alloc_cycles_, start);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::end_free_sample(uint64_t start)
+{
+    add_sample(free_cycles_, start);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_sample(counter_t* histogram, uint64_t start)
+{
+    if (start == 0)
+    {
+        return;
+    }
+    // bucket i holds samples of less than 2^i cycles
+    uint64_t cycles = read_cycle_counter() - start;
+    uint32_t bucket = 0;
+    while (cycles != 0 && bucket != TELEMETRY_LATENCY_BUCKETS - 1)
+    {
+        cycles >>= 1;
+        ++bucket;
+    }
+    add_index(histogram[bucket], 1);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_allocs(uint64_t count)
+{
+    add_index(num_allocs_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_failed_allocs(uint64_t count)
+{
+    add_index(num_failed_allocs_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_frees(uint64_t count)
+{
+    add_index(num_frees_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_blocks_added(uint64_t count)
+{
+    add_index(num_blocks_added_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_blocks_freed(uint64_t count)
+{
+    add_index(num_blocks_freed_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::add_blocks_scanned(uint64_t count)
+{
+    add_index(num_blocks_scanned_, count);
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::snapshot(ObjectPoolTelemetry& telemetry) const
+{
+    telemetry.num_allocs = load_index(num_allocs_);
+    telemetry.num_failed_allocs = load_index(num_failed_allocs_);
+    telemetry.num_frees = load_index(num_frees_);
+    telemetry.num_blocks_added = load_index(num_blocks_added_);
+    telemetry.num_blocks_freed = load_index(num_blocks_freed_);
+    telemetry.num_blocks_scanned = load_index(num_blocks_scanned_);
+    for (uint32_t i = 0; i != TELEMETRY_LATENCY_BUCKETS; ++i)
+    {
+        telemetry.alloc_cycles[i] = load_index(alloc_cycles_[i]);
+        telemetry.free_cycles[i] = load_index(free_cycles_[i]);
+    }
+}
+
+template <typename Policy>
+void TelemetryCounters<Policy, true>::reset()
+{
+    store_index(num_allocs_, 0);
+    store_index(num_failed_allocs_, 0);
+    store_index(num_frees_, 0);
+    store_index(num_blocks_added_, 0);
+    store_index(num_blocks_freed_, 0);
+    store_index(num_blocks_scanned_, 0);
+    store_index(num_sample_calls_, 0);
+    for (uint32_t i = 0; i != TELEMETRY_LATENCY_BUCKETS; ++i)
+    {
+        store_index(alloc_cycles_[i], 0);
+        store_index(free_cycles_[i], 0);
+    }
+}
+
 // Aligns n to align. N will be unchanged if it is already aligned
 inline size_t align_to(size_t n, size_t align)
 {
     return (1 + (n - 1) / align) * align;
 }
 
-template <typename T>
-ObjectPoolBlock<T>* ObjectPoolBlock<T>::create(index_t entries_per_block)
+// Returns the number of bits needed to store values less than n
+inline uint32_t ceil_log2(size_t n)
+{
+    uint32_t bits = 0;
+    while ((size_t(1) << bits) < n)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+// Returns the smallest power of two which is not less than n
+inline size_t next_pow2(size_t n)
+{
+    size_t result = 1;
+    while (result < n)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::calc_bitmap_words(
+    index_t entries_per_block)
+{
+    return (entries_per_block + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+template <typename T, typename Policy>
+size_t ObjectPoolBlock<T, Policy>::calc_generations_offset(index_t entries_per_block)
+{
+    // the header is followed by the indices then the generations
+    const size_t header_size = sizeof(ObjectPoolBlock<T, Policy>);
+    const size_t indices_size = sizeof(index_storage_t) * entries_per_block;
+    return align_to(header_size + indices_size, sizeof(generation_storage_t));
+}
+
+template <typename T, typename Policy>
+size_t ObjectPoolBlock<T, Policy>::calc_live_offset(index_t entries_per_block)
+{
+    // the live array follows the generations, if there are any
+    const size_t generations_size =
+        Policy::generations ? sizeof(generation_storage_t) * entries_per_block : 0;
+    return align_to(calc_generations_offset(entries_per_block) + generations_size, sizeof(index_t));
+}
+
+template <typename T, typename Policy>
+size_t ObjectPoolBlock<T, Policy>::calc_bitmap_offset(index_t entries_per_block)
+{
+    // the bitmap follows the live array and positions, if there are any,
+    // aligned to the bitmap word size
+    const size_t live_size = Policy::dense ? 2 * sizeof(index_t) * entries_per_block : 0;
+    return align_to(calc_live_offset(entries_per_block) + live_size, sizeof(bitmap_storage_t));
+}
+
+template <typename T, typename Policy>
+size_t ObjectPoolBlock<T, Policy>::calc_memory_offset(index_t entries_per_block)
+{
+#if _MSC_VER <= 1800
+    const size_t type_align = __alignof(T);
+#else
+    const size_t type_align = alignof(T);
+#endif
+    const size_t entry_align = Policy::align_entries || Policy::pad_entries
+        ? std::max<size_t>(type_align, CACHE_LINE_SIZE)
+        : type_align;
+    // extend bitmap size by alignment of T
+    const size_t bitmap_size = sizeof(bitmap_storage_t) * calc_bitmap_words(entries_per_block);
+    return align_to(calc_bitmap_offset(entries_per_block) + bitmap_size, entry_align);
+}
+
+template <typename T, typename Policy>
+size_t ObjectPoolBlock<T, Policy>::calc_block_size(index_t entries_per_block)
+{
+    // block size includes header + indices + bitmap + entry alignment + entries
+    const size_t entries_size = ENTRY_STRIDE * entries_per_block;
+    return calc_memory_offset(entries_per_block) + entries_size;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::calc_entries_for_size(
+    size_t block_size)
+{
+    // estimate from the per entry cost then correct for alignment padding
+    const size_t entry_size = ENTRY_STRIDE + sizeof(index_storage_t)
+        + (Policy::generations ? sizeof(generation_storage_t) : 0)
+        + (Policy::dense ? 2 * sizeof(index_t) : 0);
+    const size_t header_size = sizeof(ObjectPoolBlock<T, Policy>);
+    const size_t max_entries = ObjectPoolBlock<T, Policy>::max_entries();
+    size_t n = block_size > header_size ? (block_size - header_size) / entry_size : 1;
+    n = std::min(std::max<size_t>(n, 1), max_entries);
+    while (n > 1 && calc_block_size(static_cast<index_t>(n)) > block_size)
+    {
+        --n;
+    }
+    while (n < max_entries && calc_block_size(static_cast<index_t>(n + 1)) <= block_size)
+    {
+        ++n;
+    }
+    return static_cast<index_t>(n);
+}
+
+template <typename T, typename Policy>
+ObjectPoolBlock<T, Policy>* ObjectPoolBlock<T, Policy>::create(
+    index_t entries_per_block, size_t block_align, const ObjectPoolBlockAllocator& allocator)
+{
+    const size_t block_size = calc_block_size(entries_per_block);
+    ObjectPoolBlock<T, Policy>* ptr = reinterpret_cast<ObjectPoolBlock<T, Policy>*>(
+        allocator.allocate_block(block_size, block_align));
+    if (ptr)
+    {
+        new (ptr) ObjectPoolBlock(entries_per_block);
+        assert(reinterpret_cast<uint8_t*>(ptr->indices_begin())
+            == reinterpret_cast<uint8_t*>(ptr) + sizeof(ObjectPoolBlock<T, Policy>));
+        assert(reinterpret_cast<uint8_t*>(ptr->memory_begin()) + ENTRY_STRIDE * entries_per_block
+            <= reinterpret_cast<uint8_t*>(ptr) + block_size);
+    }
+    return ptr;
+}
+
+template <typename T, typename Policy>
+ObjectPoolBlock<T, Policy>* ObjectPoolBlock<T, Policy>::from_pointer(
+    const T* ptr, size_t block_align)
+{
+    // blocks are aligned to a power of two at least as large as the block so
+    // masking any address within a block gives the address of its header
+    assert((block_align & (block_align - 1)) == 0);
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t(block_align) - 1);
+    return reinterpret_cast<ObjectPoolBlock<T, Policy>*>(addr);
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::destroy(
+    ObjectPoolBlock<T, Policy>* ptr, const ObjectPoolBlockAllocator& allocator)
+{
+    const size_t block_size = calc_block_size(ptr->num_entries());
+    ptr->~ObjectPoolBlock();
+    allocator.deallocate_block(ptr, block_size);
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::destroy_storage(
+    ObjectPoolBlock<T, Policy>* ptr, const ObjectPoolBlockAllocator& allocator)
+{
+    // skip the destructor as it would destruct all allocated entries
+    allocator.deallocate_block(ptr, calc_block_size(ptr->num_entries()));
+}
+
+template <typename T, typename Policy>
+ObjectPoolBlock<T, Policy>::ObjectPoolBlock(index_t entries_per_block)
+    : free_list_(entries_per_block),
+      entries_per_block_(entries_per_block),
+      pool_index_(0),
+      num_allocations_(0),
+      peak_allocations_(0),
+      lowest_free_word_(0),
+      high_water_(0),
+      num_generations_(0),
+      first_generation_(1)
+{
+    // the free list starts empty and entries are taken from the high water
+    // mark, lock free blocks can't initialise generations and bitmap words
+    // lazily as other threads may read them
+    if (Policy::lock_free)
+    {
+        if (Policy::generations)
+        {
+            generation_storage_t* generations = generations_begin();
+            for (index_t i = 0; i < entries_per_block; ++i)
+            {
+                new (generations + i) generation_storage_t(first_generation_);
+            }
+            num_generations_ = entries_per_block;
+        }
+        bitmap_storage_t* bitmap = bitmap_begin();
+        for (index_t i = 0, count = calc_bitmap_words(entries_per_block); i < count; ++i)
+        {
+            new (bitmap + i) bitmap_storage_t(0);
+        }
+    }
+}
+
+template <typename T, typename Policy>
+void destruct_all(ObjectPoolBlock<T, Policy>&,
+    typename std::enable_if<std::is_trivially_destructible<T>::value>::type* = 0)
+{
+    // skip calling destructors for trivially destructible types
+}
+
+template <typename T, typename Policy>
+void destruct_all(ObjectPoolBlock<T, Policy>& t,
+    typename std::enable_if<!std::is_trivially_destructible<T>::value>::type* = 0)
+{
+    // call destructors on all live objects in the pool
+    t.for_each([](T* ptr)
+        {
+            ptr->~T();
+        });
+}
+
+template <typename T, typename Policy>
+ObjectPoolBlock<T, Policy>::~ObjectPoolBlock()
+{
+    // destruct any allocated objects
+    destruct_all(*this);
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_storage_t* ObjectPoolBlock<T, Policy>::indices_begin()
+    const
+{
+    // calculcates the start of the indicies
+    return reinterpret_cast<index_storage_t*>(const_cast<ObjectPoolBlock<T, Policy>*>(this + 1));
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::generation_storage_t*
+ObjectPoolBlock<T, Policy>::generations_begin() const
+{
+    // calculates the start of the entry generations
+    return reinterpret_cast<generation_storage_t*>(
+        reinterpret_cast<uintptr_t>(this) + calc_generations_offset(entries_per_block_));
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::bump_generation(index_t index)
+{
+    if (Policy::generations)
+    {
+        generation_storage_t& generation = generations_begin()[index];
+        store_index(generation, next_generation(load_index(generation)));
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t* ObjectPoolBlock<T, Policy>::live_begin() const
+{
+    // calculates the start of the live entry array
+    return reinterpret_cast<index_t*>(
+        reinterpret_cast<uintptr_t>(this) + calc_live_offset(entries_per_block_));
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::add_live(index_t index)
+{
+    if (Policy::dense)
+    {
+        // append to the live array and record where the entry is
+        index_t* live = live_begin();
+        const index_t position = load_index(num_allocations_);
+        live[position] = index;
+        live[entries_per_block_ + index] = position;
+    }
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::remove_live(index_t index)
+{
+    if (Policy::dense)
+    {
+        // move the last live entry into the removed entry's position
+        index_t* live = live_begin();
+        const index_t position = live[entries_per_block_ + index];
+        const index_t last = live[load_index(num_allocations_) - 1];
+        assert(live[position] == index);
+        live[position] = last;
+        live[entries_per_block_ + last] = position;
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::bitmap_storage_t* ObjectPoolBlock<T, Policy>::bitmap_begin()
+    const
+{
+    // calculates the start of the occupancy bitmap
+    return reinterpret_cast<bitmap_storage_t*>(
+        reinterpret_cast<uintptr_t>(this) + calc_bitmap_offset(entries_per_block_));
+}
+
+template <typename T, typename Policy>
+T* ObjectPoolBlock<T, Policy>::memory_begin() const
+{
+    // calculates the start of pool memory
+    return reinterpret_cast<T*>(
+        reinterpret_cast<uintptr_t>(this) + calc_memory_offset(entries_per_block_));
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::prefetch_ahead(index_t index) const
+{
+    if (Policy::prefetch_distance != 0
+        && static_cast<size_t>(entries_per_block_ - index) > Policy::prefetch_distance)
+    {
+        prefetch(entry_at(index + Policy::prefetch_distance));
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::find_lowest_free(
+    index_t* out, index_t count)
+{
+    const bitmap_storage_t* bitmap = bitmap_begin();
+    const index_t high_water = load_index(high_water_);
+    const index_t num_words = calc_bitmap_words(high_water);
+    index_t num_found = 0;
+    index_t word = lowest_free_word_;
+    while (word < num_words)
+    {
+        bitmap_word_t free_bits = ~load_bits(bitmap[word]);
+        while (free_bits != 0 && num_found != count)
+        {
+            const index_t index = word * BITS_PER_WORD + count_trailing_zeros(free_bits);
+            if (index >= high_water)
+            {
+                // entries from the high water mark on are claimed in order
+                free_bits = 0;
+                break;
+            }
+            out[num_found++] = index;
+            free_bits &= free_bits - 1;
+        }
+        if (free_bits != 0)
+        {
+            // this word still has free entries
+            break;
+        }
+        ++word;
+    }
+    lowest_free_word_ = word;
+    return num_found;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::claim_unused(
+    index_t count, index_t& first)
+{
+    const index_t num_claimed = claim_indices(high_water_, entries_per_block_, count, first);
+    if (!Policy::lock_free && num_claimed != 0)
+    {
+        // clear bitmap words the claimed entries start using
+        bitmap_storage_t* bitmap = bitmap_begin();
+        for (index_t i = calc_bitmap_words(first), end = calc_bitmap_words(first + num_claimed);
+             i < end; ++i)
+        {
+            new (bitmap + i) bitmap_storage_t(0);
+        }
+        if (Policy::generations)
+        {
+            generation_storage_t* generations = generations_begin();
+            for (index_t i = num_generations_; i < first + num_claimed; ++i)
+            {
+                new (generations + i) generation_storage_t(first_generation_);
+            }
+            num_generations_ = std::max<index_t>(num_generations_, first + num_claimed);
+        }
+    }
+    return num_claimed;
+}
+
+template <typename T, typename Policy>
+const T* ObjectPoolBlock<T, Policy>::memory_offset() const
+{
+    return memory_begin();
+}
+
+template <typename T, typename Policy>
+template <class... P>
+T* ObjectPoolBlock<T, Policy>::new_object(P&&... params)
+{
+    T* ptr = allocate();
+    if (ptr)
+    {
+        // construct the entry
+        new (ptr) T(std::forward<P>(params)...);
+    }
+    return ptr;
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        // destruct this object
+        ptr->~T();
+        deallocate(ptr);
+    }
+}
+
+template <typename T, typename Policy>
+T* ObjectPoolBlock<T, Policy>::allocate()
+{
+    // pop the head of the free list, or take the lowest free entry
+    index_t index = entries_per_block_;
+    if (Policy::address_ordered)
+    {
+        find_lowest_free(&index, 1);
+    }
+    else
+    {
+        index = free_list_.pop(indices_begin(), entries_per_block_);
+    }
+    if (index == entries_per_block_)
+    {
+        claim_unused(1, index);
+    }
+    if (index != entries_per_block_)
+    {
+        // flag index as used in the occupancy bitmap
+        const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+        bitmap_storage_t& word = bitmap_begin()[index / BITS_PER_WORD];
+        // assert that this index is not in use
+        assert((load_bits(word) & mask) == 0);
+        set_bits(word, mask);
+        add_live(index);
+        max_index(peak_allocations_, add_index(num_allocations_, 1));
+        // get object memory
+        return entry_at(index);
+    }
+    return nullptr;
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::deallocate(const T* ptr)
+{
+    // get the index of this pointer
+    const index_t index = index_of(ptr);
+    // flag index as unused in the occupancy bitmap
+    const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+    bitmap_storage_t& word = bitmap_begin()[index / BITS_PER_WORD];
+    // assert this index is allocated
+    assert((load_bits(word) & mask) != 0);
+    clear_bits(word, mask);
+    bump_generation(index);
+    remove_live(index);
+    sub_index(num_allocations_, 1);
+    if (Policy::address_ordered)
+    {
+        lowest_free_word_ = std::min<index_t>(lowest_free_word_, index / BITS_PER_WORD);
+    }
+    else
+    {
+        // add index to the front of the free list
+        free_list_.push(indices_begin(), index);
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::allocate_n(
+    T** ptrs, index_t count)
+{
+    // pop indices from the free list in batches
+    static const index_t BATCH_SIZE = 64;
+    index_t batch[BATCH_SIZE];
+    index_storage_t* indices = indices_begin();
+    bitmap_storage_t* bitmap = bitmap_begin();
+    index_t num_allocated = 0;
+    while (num_allocated != count)
+    {
+        const index_t batch_size = std::min<index_t>(count - num_allocated, BATCH_SIZE);
+        index_t num_popped = Policy::address_ordered
+            ? find_lowest_free(batch, batch_size)
+            : free_list_.pop_n(indices, entries_per_block_, batch, batch_size);
+        if (num_popped != batch_size)
+        {
+            // take the remainder from the unused entries
+            index_t first;
+            const index_t num_claimed = claim_unused(batch_size - num_popped, first);
+            for (index_t i = 0; i != num_claimed; ++i)
+            {
+                batch[num_popped++] = first + i;
+            }
+        }
+        for (index_t i = 0; i != num_popped; ++i)
+        {
+            // flag index as used in the occupancy bitmap
+            const index_t index = batch[i];
+            const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+            bitmap_storage_t& word = bitmap[index / BITS_PER_WORD];
+            assert((load_bits(word) & mask) == 0);
+            set_bits(word, mask);
+            if (Policy::dense)
+            {
+                // add_live appends at num_allocations_ which isn't updated
+                // until the end of the batch
+                index_t* live = live_begin();
+                const index_t position = load_index(num_allocations_) + num_allocated;
+                live[position] = index;
+                live[entries_per_block_ + index] = position;
+            }
+            ptrs[num_allocated++] = entry_at(index);
+        }
+        if (num_popped != batch_size)
+        {
+            break;
+        }
+    }
+    if (num_allocated != 0)
+    {
+        max_index(peak_allocations_, add_index(num_allocations_, num_allocated));
+    }
+    return num_allocated;
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::deallocate_n(const T* const* ptrs, index_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    index_storage_t* indices = indices_begin();
+    bitmap_storage_t* bitmap = bitmap_begin();
+    // link the freed entries together then add them to the free list at once
+    index_t first = entries_per_block_;
+    index_t last = entries_per_block_;
+    for (index_t i = 0; i != count; ++i)
+    {
+        const index_t index = index_of(ptrs[i]);
+        // flag index as unused in the occupancy bitmap
+        const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+        bitmap_storage_t& word = bitmap[index / BITS_PER_WORD];
+        assert((load_bits(word) & mask) != 0);
+        clear_bits(word, mask);
+        bump_generation(index);
+        if (Policy::dense)
+        {
+            remove_live(index);
+            sub_index(num_allocations_, 1);
+        }
+        if (Policy::address_ordered)
+        {
+            lowest_free_word_ = std::min<index_t>(lowest_free_word_, index / BITS_PER_WORD);
+            continue;
+        }
+        if (last != entries_per_block_)
+        {
+            store_index(indices[last], index);
+        }
+        else
+        {
+            first = index;
+        }
+        last = index;
+    }
+    if (!Policy::address_ordered)
+    {
+        free_list_.push_n(indices, first, last);
+    }
+    if (!Policy::dense)
+    {
+        sub_index(num_allocations_, count);
+    }
+}
+
+template <typename T, typename Policy>
+template <typename F>
+void ObjectPoolBlock<T, Policy>::for_each(const F func) const
+{
+    if (Policy::dense)
+    {
+        // walk the live array backwards so deleting the current entry, which
+        // swaps in an entry already visited, doesn't skip anything
+        const index_t* live = live_begin();
+        for (index_t i = load_index(num_allocations_); i != 0;)
+        {
+            --i;
+            if (Policy::prefetch_distance != 0 && i >= Policy::prefetch_distance)
+            {
+                prefetch(entry_at(live[i - Policy::prefetch_distance]));
+            }
+            func(entry_at(live[i]));
+        }
+        return;
+    }
+    for_each_in(0, entries_per_block_, func);
+}
+
+template <typename T, typename Policy>
+template <typename F>
+void ObjectPoolBlock<T, Policy>::for_each_in(index_t begin, index_t end, const F func) const
+{
+    end = std::min<index_t>(end, load_index(high_water_));
+    if (begin >= end)
+    {
+        return;
+    }
+    const bitmap_storage_t* bitmap = bitmap_begin();
+    const index_t first_word = begin / BITS_PER_WORD;
+    const index_t last_word = (end - 1) / BITS_PER_WORD;
+    for (index_t i = first_word; i <= last_word; ++i)
+    {
+        // mask off entries outside the range in the first and last words
+        bitmap_word_t mask = ~bitmap_word_t(0);
+        if (i == first_word)
+        {
+            mask &= ~bitmap_word_t(0) << (begin % BITS_PER_WORD);
+        }
+        if (i == last_word && end % BITS_PER_WORD != 0)
+        {
+            mask &= (bitmap_word_t(1) << (end % BITS_PER_WORD)) - 1;
+        }
+        bitmap_word_t bits = load_bits(bitmap[i]) & mask;
+        while (bits != 0)
+        {
+            const uint32_t bit = count_trailing_zeros(bits);
+            const index_t index = i * BITS_PER_WORD + bit;
+            prefetch_ahead(index);
+            func(entry_at(index));
+            // reload the word in case func deleted other entries, skipping
+            // bits up to and including this one
+            bits = load_bits(bitmap[i]) & mask & ~((bitmap_word_t(2) << bit) - 1);
+        }
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::find_allocated(
+    index_t index) const
+{
+    const index_t high_water = load_index(high_water_);
+    if (index >= high_water)
+    {
+        return entries_per_block_;
+    }
+    const bitmap_storage_t* bitmap = bitmap_begin();
+    const index_t count = calc_bitmap_words(high_water);
+    index_t word = index / BITS_PER_WORD;
+    // mask off entries before the given index in the first word
+    bitmap_word_t bits = load_bits(bitmap[word]) & (~bitmap_word_t(0) << (index % BITS_PER_WORD));
+    while (bits == 0)
+    {
+        if (++word == count)
+        {
+            return entries_per_block_;
+        }
+        bits = load_bits(bitmap[word]);
+    }
+    return word * BITS_PER_WORD + count_trailing_zeros(bits);
+}
+
+template <typename T, typename Policy>
+T* ObjectPoolBlock<T, Policy>::entry_at(index_t index) const
+{
+    assert(index < entries_per_block_);
+    return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(memory_begin()) + index * ENTRY_STRIDE);
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::delete_all()
+{
+    // destruct any allocated objects
+    destruct_all(*this);
+    free_list_.reset(entries_per_block_);
+    lowest_free_word_ = 0;
+    store_index(num_allocations_, 0);
+    // only bitmap words below the high water mark have been used, these are
+    // cleared as entries are claimed again unless the block is lock free
+    bitmap_storage_t* bitmap = bitmap_begin();
+    const index_t count = calc_bitmap_words(load_index(high_water_));
+    store_index(high_water_, 0);
+    if (Policy::generations || Policy::lock_free)
+    {
+        for (index_t i = 0; i < count; ++i)
+        {
+            // invalidate handles to each live entry
+            if (Policy::generations)
+            {
+                bitmap_word_t bits = load_bits(bitmap[i]);
+                while (bits != 0)
+                {
+                    const uint32_t bit = count_trailing_zeros(bits);
+                    bump_generation(i * BITS_PER_WORD + bit);
+                    bits &= bits - 1;
+                }
+            }
+            clear_bits(bitmap[i], ~bitmap_word_t(0));
+        }
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::num_allocations() const
+{
+    return load_index(num_allocations_);
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::peak_allocations() const
+{
+    return load_index(peak_allocations_);
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::num_entries() const
+{
+    return entries_per_block_;
+}
+
+template <typename T, typename Policy>
+detail::index_t ObjectPoolBlock<T, Policy>::pool_index() const
+{
+    return pool_index_;
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::set_pool_index(detail::index_t pool_index)
+{
+    pool_index_ = pool_index;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::generation_t ObjectPoolBlock<T, Policy>::next_generation(
+    generation_t generation)
+{
+    // truncate to the generation bits of a handle, skipping zero
+    const unsigned generation_bits = sizeof(handle_t) * 8 - HANDLE_POSITION_BITS;
+    const unsigned type_bits = sizeof(generation_t) * 8;
+    const generation_t mask = generation_bits >= type_bits
+        ? ~generation_t(0)
+        : ~generation_t(0) >> (type_bits - generation_bits);
+    const generation_t next = (generation + 1) & mask;
+    return next != 0 ? next : 1;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::index_of(
+    const T* ptr) const
+{
+    // assert that pointer is in range and at the start of an entry
+    const size_t offset = reinterpret_cast<const uint8_t*>(ptr)
+        - reinterpret_cast<const uint8_t*>(memory_begin());
+    assert(offset < ENTRY_STRIDE * entries_per_block_ && offset % ENTRY_STRIDE == 0);
+    return static_cast<index_t>(offset / ENTRY_STRIDE);
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::generation_t ObjectPoolBlock<T, Policy>::generation(
+    index_t index) const
+{
+    static_assert(Policy::generations, "generations are not enabled by the pool policy");
+    assert(index < num_generations_);
+    return load_index(generations_begin()[index]);
+}
+
+template <typename T, typename Policy>
+T* ObjectPoolBlock<T, Policy>::resolve(index_t index, generation_t generation) const
+{
+    // freeing an entry changes its generation so a match means the handle
+    // is current, the bitmap is also checked so forged handles to entries
+    // which were never allocated are rejected
+    static_assert(Policy::generations, "generations are not enabled by the pool policy");
+    if (index < load_index(high_water_) && load_index(generations_begin()[index]) == generation)
+    {
+        const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+        if (load_bits(bitmap_begin()[index / BITS_PER_WORD]) & mask)
+        {
+            return entry_at(index);
+        }
+    }
+    return nullptr;
+}
+
+template <typename T, typename Policy>
+void ObjectPoolBlock<T, Policy>::reset_generations(generation_t generation)
+{
+    first_generation_ = generation;
+    generation_storage_t* generations = generations_begin();
+    for (index_t i = 0; i < num_generations_; ++i)
+    {
+        store_index(generations[i], generation);
+    }
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::generation_t ObjectPoolBlock<T, Policy>::max_generation() const
+{
+    const generation_storage_t* generations = generations_begin();
+    generation_t result = first_generation_;
+    for (index_t i = 0; i < num_generations_; ++i)
+    {
+        result = std::max(result, load_index(generations[i]));
+    }
+    return result;
+}
+
+template <typename T, typename Policy>
+typename ObjectPoolBlock<T, Policy>::index_t ObjectPoolBlock<T, Policy>::max_entries()
+{
+    // the largest index marks the end of the free list
+    return std::numeric_limits<index_t>::max() - 1;
+}
+
+} // namespace detail
+
+inline void* ObjectPoolBlockAllocator::allocate_block(size_t size, size_t align) const
+{
+    return allocate ? allocate(user_data, size, align) : detail::aligned_malloc(size, align);
+}
+
+inline void ObjectPoolBlockAllocator::deallocate_block(void* ptr, size_t size) const
+{
+    if (deallocate)
+    {
+        deallocate(user_data, ptr, size);
+    }
+    else
+    {
+        detail::aligned_free(ptr);
+    }
+}
+
+template <typename T, typename Policy>
+FixedObjectPool<T, Policy>::FixedObjectPool(
+    index_t max_entries, const ObjectPoolBlockAllocator& allocator)
+    : allocator_(allocator),
+      block_(Block::create(max_entries, detail::MIN_BLOCK_ALIGN, allocator)),
+      mapped_(false)
+{
+    // every entry index must fit in the position bits of a handle
+    assert(!Policy::generations
+        || (max_entries - 1) >> (Block::HANDLE_POSITION_BITS - 1) >> 1 == 0);
+}
+
+template <typename T, typename Policy>
+FixedObjectPool<T, Policy>::~FixedObjectPool()
+{
+    // a mapped block may still hold objects, they are trivially destructible
+    assert(mapped_ || calc_stats().num_allocations == 0);
+    Block::destroy(block_, mapped_ ? detail::pool_file_allocator() : allocator_);
+}
+
+template <typename T, typename Policy>
+template <class... P>
+T* FixedObjectPool<T, Policy>::new_object(P&&... params)
+{
+    const uint64_t start = telemetry_.begin_sample();
+    T* ptr = block_->allocate();
+    telemetry_.end_alloc_sample(start);
+    if (!ptr)
+    {
+        telemetry_.add_failed_allocs(1);
+        return nullptr;
+    }
+    telemetry_.add_allocs(1);
+    new (ptr) T(std::forward<P>(params)...);
+    return ptr;
+}
+
+template <typename T, typename Policy>
+void FixedObjectPool<T, Policy>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        ptr->~T();
+        const uint64_t start = telemetry_.begin_sample();
+        block_->deallocate(ptr);
+        telemetry_.end_free_sample(start);
+        telemetry_.add_frees(1);
+    }
+}
+
+template <typename T, typename Policy>
+template <class... P>
+typename FixedObjectPool<T, Policy>::index_t FixedObjectPool<T, Policy>::new_objects(
+    index_t count, T** ptrs, const P&... params)
+{
+    const index_t num_allocated = block_->allocate_n(ptrs, count);
+    telemetry_.add_allocs(num_allocated);
+    if (num_allocated != count)
+    {
+        telemetry_.add_failed_allocs(1);
+    }
+    for (index_t i = 0; i != num_allocated; ++i)
+    {
+        new (ptrs[i]) T(params...);
+    }
+    return num_allocated;
+}
+
+template <typename T, typename Policy>
+void FixedObjectPool<T, Policy>::delete_objects(const T* const* ptrs, index_t count)
+{
+    // free each run of non-null pointers in a single batch
+    index_t first = 0;
+    while (first != count)
+    {
+        index_t last = first;
+        for (; last != count && ptrs[last] != nullptr; ++last)
+        {
+            ptrs[last]->~T();
+        }
+        block_->deallocate_n(ptrs + first, last - first);
+        telemetry_.add_frees(last - first);
+        for (first = last; first != count && ptrs[first] == nullptr; ++first)
+        {
+        }
+    }
+}
+
+template <typename T, typename Policy>
+void FixedObjectPool<T, Policy>::delete_all()
+{
+    telemetry_.add_frees(block_->num_allocations());
+    block_->delete_all();
+}
+
+template <typename T, typename Policy>
+template <typename F>
+void FixedObjectPool<T, Policy>::for_each(const F func) const
+{
+    block_->for_each(func);
+}
+
+template <typename T, typename Policy>
+template <typename V>
+FixedObjectPool<T, Policy>::Iterator<V>::Iterator()
+    : pool_(nullptr),
+      index_(0)
+{
+}
+
+template <typename T, typename Policy>
+template <typename V>
+template <typename U, typename>
+FixedObjectPool<T, Policy>::Iterator<V>::Iterator(const Iterator<U>& other)
+    : pool_(other.pool_),
+      index_(other.index_)
+{
+}
+
+template <typename T, typename Policy>
+template <typename V>
+FixedObjectPool<T, Policy>::Iterator<V>::Iterator(const FixedObjectPool* pool, index_t index)
+    : pool_(pool),
+      index_(index)
+{
+}
+
+template <typename T, typename Policy>
+template <typename V>
+V& FixedObjectPool<T, Policy>::Iterator<V>::operator*() const
+{
+    return *operator->();
+}
+
+template <typename T, typename Policy>
+template <typename V>
+V* FixedObjectPool<T, Policy>::Iterator<V>::operator->() const
+{
+    return pool_->block_->entry_at(index_);
+}
+
+template <typename T, typename Policy>
+template <typename V>
+typename FixedObjectPool<T, Policy>::template Iterator<V>&
+FixedObjectPool<T, Policy>::Iterator<V>::operator++()
+{
+    index_ = pool_->block_->find_allocated(index_ + 1);
+    return *this;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+typename FixedObjectPool<T, Policy>::template Iterator<V>
+FixedObjectPool<T, Policy>::Iterator<V>::operator++(int)
+{
+    Iterator result = *this;
+    ++*this;
+    return result;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+bool FixedObjectPool<T, Policy>::Iterator<V>::operator==(const Iterator& other) const
+{
+    return index_ == other.index_;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+bool FixedObjectPool<T, Policy>::Iterator<V>::operator!=(const Iterator& other) const
+{
+    return !(*this == other);
+}
+
+template <typename T, typename Policy>
+typename FixedObjectPool<T, Policy>::iterator FixedObjectPool<T, Policy>::begin()
+{
+    return iterator(this, block_->find_allocated(0));
+}
+
+template <typename T, typename Policy>
+typename FixedObjectPool<T, Policy>::iterator FixedObjectPool<T, Policy>::end()
+{
+    return iterator(this, block_->num_entries());
+}
+
+template <typename T, typename Policy>
+typename FixedObjectPool<T, Policy>::const_iterator FixedObjectPool<T, Policy>::begin() const
+{
+    return const_iterator(this, block_->find_allocated(0));
+}
+
+template <typename T, typename Policy>
+typename FixedObjectPool<T, Policy>::const_iterator FixedObjectPool<T, Policy>::end() const
+{
+    return const_iterator(this, block_->num_entries());
+}
+
+template <typename T, typename Policy>
+ObjectPoolStats FixedObjectPool<T, Policy>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = 1;
+    stats.num_allocations = block_->num_allocations();
+    stats.peak_allocations = block_->peak_allocations();
+    stats.num_free_blocks = stats.num_allocations == 0 ? 1 : 0;
+    stats.bytes_reserved = Block::calc_block_size(block_->num_entries());
+    stats.bytes_in_use = stats.num_allocations * sizeof(T);
+    return stats;
+}
+
+template <typename T, typename Policy>
+ObjectPoolTelemetry FixedObjectPool<T, Policy>::telemetry() const
+{
+    static_assert(Policy::telemetry, "telemetry requires a policy with telemetry enabled");
+    ObjectPoolTelemetry telemetry;
+    telemetry_.snapshot(telemetry);
+    telemetry.peak_allocations = block_->peak_allocations();
+    return telemetry;
+}
+
+template <typename T, typename Policy>
+void FixedObjectPool<T, Policy>::reset_telemetry()
+{
+    static_assert(Policy::telemetry, "telemetry requires a policy with telemetry enabled");
+    telemetry_.reset();
+}
+
+template <typename T, typename Policy>
+typename FixedObjectPool<T, Policy>::handle_t FixedObjectPool<T, Policy>::handle_of(
+    const T* ptr) const
+{
+    const index_t index = block_->index_of(ptr);
+    return handle_t(block_->generation(index)) << Block::HANDLE_POSITION_BITS | index;
+}
+
+template <typename T, typename Policy>
+T* FixedObjectPool<T, Policy>::resolve(handle_t handle) const
+{
+    const handle_t position_mask = (handle_t(1) << Block::HANDLE_POSITION_BITS) - 1;
+    return block_->resolve(static_cast<index_t>(handle & position_mask),
+        static_cast<typename Block::generation_t>(handle >> Block::HANDLE_POSITION_BITS));
+}
+
+template <typename T, typename Policy>
+bool FixedObjectPool<T, Policy>::is_valid(handle_t handle) const
+{
+    return resolve(handle) != nullptr;
+}
+
+template <typename T, typename Policy>
+bool FixedObjectPool<T, Policy>::save(const char* path) const
+{
+    const index_t num_entries = block_->num_entries();
+    detail::PoolFileHeader header = detail::make_pool_file_header<T, Policy>(num_entries);
+    header.num_blocks = 1;
+    header.peak_allocations = block_->peak_allocations();
+    header.first_generation = 1;
+    detail::PoolFileBlock block;
+    block.size = Block::calc_block_size(num_entries);
+    block.num_entries = num_entries;
+    const void* block_ptr = block_;
+    return detail::write_pool_file(path, header, &block, &block_ptr);
+}
+
+template <typename T, typename Policy>
+bool FixedObjectPool<T, Policy>::load(const char* path, bool shared)
+{
+    assert(calc_stats().num_allocations == 0);
+    const index_t num_entries = block_->num_entries();
+    detail::PoolFileHeader header;
+    std::vector<detail::PoolFileBlock> blocks;
+    std::vector<void*> block_ptrs;
+    if (!detail::read_pool_file(
+            path, detail::make_pool_file_header<T, Policy>(num_entries), header, blocks)
+        || blocks.size() != 1 || blocks[0].num_entries != num_entries
+        || blocks[0].size != Block::calc_block_size(num_entries)
+        || !detail::map_pool_file_blocks(
+            path, shared, detail::MIN_BLOCK_ALIGN, blocks, block_ptrs))
+    {
+        return false;
+    }
+    Block::destroy(block_, mapped_ ? detail::pool_file_allocator() : allocator_);
+    block_ = static_cast<Block*>(block_ptrs[0]);
+    mapped_ = true;
+    return true;
+}
+
+template <typename T, size_t N>
+const typename StaticObjectPool<T, N>::index_t StaticObjectPool<T, N>::CAPACITY;
+
+template <typename T, size_t N>
+StaticObjectPool<T, N>::StaticObjectPool()
+    : free_head_(0), num_allocations_(0), peak_allocations_(0)
+{
+    for (index_t i = 0; i != N; ++i)
+    {
+        indices_[i] = static_cast<slot_t>(i + 1);
+    }
+    std::fill_n(bitmap_, NUM_WORDS, bitmap_word_t(0));
+}
+
+template <typename T, size_t N>
+StaticObjectPool<T, N>::~StaticObjectPool()
+{
+    // destruct any allocated objects
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        for_each([](T* ptr) { ptr->~T(); });
+    }
+}
+
+template <typename T, size_t N>
+T* StaticObjectPool<T, N>::entry(index_t index) const
+{
+    return reinterpret_cast<T*>(const_cast<StaticObjectPool*>(this)->storage_ + index);
+}
+
+template <typename T, size_t N>
+template <class... P>
+T* StaticObjectPool<T, N>::new_object(P&&... params)
+{
+    const index_t index = free_head_;
+    if (index == N)
+    {
+        return nullptr;
+    }
+    free_head_ = indices_[index];
+    bitmap_word_t& word = bitmap_[index / BITS_PER_WORD];
+    const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+    assert((word & mask) == 0);
+    word |= mask;
+    if (++num_allocations_ > peak_allocations_)
+    {
+        peak_allocations_ = num_allocations_;
+    }
+    T* ptr = entry(index);
+    new (ptr) T(std::forward<P>(params)...);
+    return ptr;
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        assert(owns(ptr));
+        ptr->~T();
+        const index_t index = static_cast<index_t>(ptr - entry(0));
+        bitmap_word_t& word = bitmap_[index / BITS_PER_WORD];
+        const bitmap_word_t mask = bitmap_word_t(1) << (index % BITS_PER_WORD);
+        assert((word & mask) != 0);
+        word &= ~mask;
+        indices_[index] = free_head_;
+        free_head_ = static_cast<slot_t>(index);
+        --num_allocations_;
+    }
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::delete_all()
+{
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        for_each([](T* ptr) { ptr->~T(); });
+    }
+    for (index_t i = 0; i != N; ++i)
+    {
+        indices_[i] = static_cast<slot_t>(i + 1);
+    }
+    std::fill_n(bitmap_, NUM_WORDS, bitmap_word_t(0));
+    free_head_ = 0;
+    num_allocations_ = 0;
+}
+
+template <typename T, size_t N>
+template <typename F>
+void StaticObjectPool<T, N>::for_each(const F func) const
+{
+    for (index_t i = 0; i != NUM_WORDS; ++i)
+    {
+        bitmap_word_t bits = bitmap_[i];
+        while (bits != 0)
+        {
+            const uint32_t bit = detail::count_trailing_zeros(bits);
+            func(entry(i * BITS_PER_WORD + bit));
+            // reload the word in case func deleted other entries, skipping
+            // bits up to and including this one
+            bits = bitmap_[i] & ~((bitmap_word_t(2) << bit) - 1);
+        }
+    }
+}
+
+template <typename T, size_t N>
+ObjectPoolStats StaticObjectPool<T, N>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = 1;
+    stats.num_allocations = num_allocations_;
+    stats.peak_allocations = peak_allocations_;
+    stats.num_free_blocks = num_allocations_ == 0 ? 1 : 0;
+    stats.bytes_reserved = sizeof(*this);
+    stats.bytes_in_use = stats.num_allocations * sizeof(T);
+    return stats;
+}
+
+template <typename T, size_t N>
+bool StaticObjectPool<T, N>::owns(const T* ptr) const
+{
+    return ptr >= entry(0) && ptr < entry(0) + N;
+}
+
+template <typename T, typename Policy>
+WaitingObjectPool<T, Policy>::Waiter::Waiter(construct_t construct, resume_t resume)
+    : next_(nullptr), ptr_(nullptr), construct_(construct), resume_(resume)
+{
+}
+
+template <typename T, typename Policy>
+template <class... A>
+template <class... P>
+WaitingObjectPool<T, Policy>::ArgsWaiter<A...>::ArgsWaiter(
+    typename Waiter::resume_t resume, P&&... params)
+    : Waiter(&ArgsWaiter::construct, resume), params_(std::forward<P>(params)...)
+{
+}
+
+template <typename T, typename Policy>
+template <class... A>
+T* WaitingObjectPool<T, Policy>::ArgsWaiter<A...>::construct(Waiter* waiter, Pool& pool)
+{
+    return static_cast<ArgsWaiter*>(waiter)->construct_params(
+        pool, detail::make_index_sequence<sizeof...(A)>());
+}
+
+template <typename T, typename Policy>
+template <class... A>
+template <size_t... I>
+T* WaitingObjectPool<T, Policy>::ArgsWaiter<A...>::construct_params(
+    Pool& pool, detail::index_sequence<I...>)
+{
+    // new_object only moves from the parameters if it constructs the object,
+    // so they are still intact for a later attempt if the pool is full
+    return pool.new_object(std::get<I>(std::move(params_))...);
+}
+
+template <typename T, typename Policy>
+template <typename F, class... A>
+template <typename G, class... P>
+WaitingObjectPool<T, Policy>::CallbackWaiter<F, A...>::CallbackWaiter(
+    G&& on_ready, P&&... params)
+    : ArgsWaiter<A...>(&CallbackWaiter::resume, std::forward<P>(params)...),
+      on_ready_(std::forward<G>(on_ready))
+{
+}
+
+template <typename T, typename Policy>
+template <typename F, class... A>
+void WaitingObjectPool<T, Policy>::CallbackWaiter<F, A...>::resume(Waiter* waiter)
+{
+    // free the waiter first so the callback may delete the object or pool
+    CallbackWaiter* self = static_cast<CallbackWaiter*>(waiter);
+    F on_ready(std::move(self->on_ready_));
+    T* ptr = self->ptr_;
+    delete self;
+    on_ready(ptr);
+}
+
+template <typename T, typename Policy>
+WaitingObjectPool<T, Policy>::WaitingObjectPool(
+    index_t max_entries, const ObjectPoolBlockAllocator& allocator)
+    : pool_(max_entries, allocator),
+      waiters_head_(nullptr),
+      waiters_tail_(nullptr),
+      num_waiting_(0)
+{
+}
+
+template <typename T, typename Policy>
+WaitingObjectPool<T, Policy>::~WaitingObjectPool()
+{
+    // explicitly delete_object or delete_all before pool goes out of scope
+    assert(waiters_head_ == nullptr);
+}
+
+template <typename T, typename Policy>
+template <class... P>
+T* WaitingObjectPool<T, Policy>::new_object(P&&... params)
+{
+    // the pool is always full while allocations are waiting, so there is no
+    // need to check the queue to avoid jumping it
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pool_.new_object(std::forward<P>(params)...);
+}
+
+template <typename T, typename Policy>
+template <typename F, class... P>
+bool WaitingObjectPool<T, Policy>::new_object_async(F&& on_ready, P&&... params)
+{
+    typedef CallbackWaiter<typename std::decay<F>::type, typename std::decay<P>::type...>
+        CallbackWaiterT;
+    T* ptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ptr = pool_.new_object(std::forward<P>(params)...);
+        if (!ptr)
+        {
+            // the parameters weren't moved from as nothing was constructed
+            push_waiter(new CallbackWaiterT(std::forward<F>(on_ready), std::forward<P>(params)...));
+            return false;
+        }
+    }
+    on_ready(ptr);
+    return true;
+}
+
+template <typename T, typename Policy>
+void WaitingObjectPool<T, Policy>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        Waiter* served;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pool_.delete_object(ptr);
+            served = serve_waiters(1);
+        }
+        resume_waiters(served);
+    }
+}
+
+template <typename T, typename Policy>
+void WaitingObjectPool<T, Policy>::delete_all()
+{
+    Waiter* served;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pool_.delete_all();
+        served = serve_waiters(std::numeric_limits<size_t>::max());
+    }
+    resume_waiters(served);
+}
+
+template <typename T, typename Policy>
+size_t WaitingObjectPool<T, Policy>::num_waiting() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_waiting_;
+}
+
+template <typename T, typename Policy>
+ObjectPoolStats WaitingObjectPool<T, Policy>::calc_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pool_.calc_stats();
+}
+
+template <typename T, typename Policy>
+void WaitingObjectPool<T, Policy>::push_waiter(Waiter* waiter)
+{
+    waiter->next_ = nullptr;
+    if (waiters_tail_)
+    {
+        waiters_tail_->next_ = waiter;
+    }
+    else
+    {
+        waiters_head_ = waiter;
+    }
+    waiters_tail_ = waiter;
+    ++num_waiting_;
+}
+
+template <typename T, typename Policy>
+typename WaitingObjectPool<T, Policy>::Waiter* WaitingObjectPool<T, Policy>::serve_waiters(
+    size_t max_count)
+{
+    // a single freed entry is at the head of the free list, so the oldest
+    // waiter's object is constructed in it while it is still in cache
+    Waiter* served = nullptr;
+    Waiter** served_tail = &served;
+    for (; waiters_head_ && max_count != 0; --max_count)
+    {
+        Waiter* waiter = waiters_head_;
+        waiter->ptr_ = waiter->construct_(waiter, pool_);
+        if (!waiter->ptr_)
+        {
+            break;
+        }
+        waiters_head_ = waiter->next_;
+        --num_waiting_;
+        waiter->next_ = nullptr;
+        *served_tail = waiter;
+        served_tail = &waiter->next_;
+    }
+    if (!waiters_head_)
+    {
+        waiters_tail_ = nullptr;
+    }
+    return served;
+}
+
+template <typename T, typename Policy>
+void WaitingObjectPool<T, Policy>::resume_waiters(Waiter* served)
+{
+    while (served)
+    {
+        // resuming may free the waiter
+        Waiter* next = served->next_;
+        served->resume_(served);
+        served = next;
+    }
+}
+
+#if OBJECT_POOL_HAS_COROUTINES
+template <typename T, typename Policy>
+template <class... P>
+typename WaitingObjectPool<T, Policy>::template Acquire<typename std::decay<P>::type...>
+WaitingObjectPool<T, Policy>::acquire(P&&... params)
+{
+    return Acquire<typename std::decay<P>::type...>(this, std::forward<P>(params)...);
+}
+
+template <typename T, typename Policy>
+template <class... A>
+template <class... P>
+WaitingObjectPool<T, Policy>::Acquire<A...>::Acquire(WaitingObjectPool* pool, P&&... params)
+    : ArgsWaiter<A...>(&Acquire::resume, std::forward<P>(params)...),
+      pool_(pool),
+      handle_()
+{
+}
+
+template <typename T, typename Policy>
+template <class... A>
+bool WaitingObjectPool<T, Policy>::Acquire<A...>::await_ready() const
+{
+    return false;
+}
+
+template <typename T, typename Policy>
+template <class... A>
+bool WaitingObjectPool<T, Policy>::Acquire<A...>::await_suspend(std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(pool_->mutex_);
+    this->ptr_ = ArgsWaiter<A...>::construct(this, pool_->pool_);
+    if (this->ptr_)
+    {
+        return false;
+    }
+    handle_ = handle;
+    pool_->push_waiter(this);
+    return true;
+}
+
+template <typename T, typename Policy>
+template <class... A>
+T* WaitingObjectPool<T, Policy>::Acquire<A...>::await_resume() const
+{
+    return this->ptr_;
+}
+
+template <typename T, typename Policy>
+template <class... A>
+void WaitingObjectPool<T, Policy>::Acquire<A...>::resume(Waiter* waiter)
+{
+    static_cast<Acquire*>(waiter)->handle_.resume();
+}
+#endif
+
+template <typename T, typename Policy>
+DynamicObjectPool<T, Policy>::DynamicObjectPool(index_t entries_per_block,
+    const ObjectPoolGrowth& growth, const ObjectPoolBlockAllocator& allocator)
+    : block_info_(nullptr),
+      num_blocks_(0),
+      block_info_capacity_(0),
+      free_block_index_(detail::INVALID_INDEX),
+      entries_per_block_(round_to_pages(entries_per_block, allocator.page_size)),
+      max_entries_per_block_(round_to_pages(growth.mode == ObjectPoolGrowth::FIXED
+              ? entries_per_block
+              : std::max(entries_per_block, growth.max_entries_per_block),
+          allocator.page_size)),
+      growth_(growth),
+      allocator_(allocator),
+      block_align_(std::max<size_t>(detail::MIN_BLOCK_ALIGN,
+          detail::next_pow2(Block::calc_block_size(max_entries_per_block_)))),
+      num_allocations_(0),
+      peak_allocations_(0),
+      num_free_blocks_(0),
+      capacity_(0),
+      bytes_in_blocks_(0),
+      handle_index_bits_(detail::ceil_log2(max_entries_per_block_)),
+      first_generation_(1),
+      remote_frees_(nullptr),
+      compact_dst_(0),
+      compact_src_(0)
+{
+    assert(!Policy::generations || handle_index_bits_ <= Block::HANDLE_POSITION_BITS);
+    assert(growth.mode != ObjectPoolGrowth::CUSTOM || growth.callback != nullptr);
+    // always have one block available
+    add_block();
+}
+
+template <typename T, typename Policy>
+DynamicObjectPool<T, Policy>::~DynamicObjectPool()
+{
+    // explicitly delete_object or delete_all before pool goes out of scope
+    collect_remote_frees();
+    assert(!mapped_blocks_.empty() || calc_stats().num_allocations == 0);
+    for (index_t index = 0; index != num_blocks_; ++index)
+    {
+        destroy_block(block_info_[index].block_);
+    }
+    free(block_info_);
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::index_t DynamicObjectPool<T, Policy>::round_to_pages(
+    index_t num_entries, size_t page_size)
+{
+    // blocks can't have more entries than their index type can hold
+    const typename Block::index_t entries =
+        static_cast<typename Block::index_t>(std::min<index_t>(num_entries, Block::max_entries()));
+    if (page_size == 0)
+    {
+        return entries;
+    }
+    return Block::calc_entries_for_size(
+        detail::align_to(Block::calc_block_size(entries), page_size));
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::index_t
+DynamicObjectPool<T, Policy>::next_block_entries() const
+{
+    if (num_blocks_ == 0)
+    {
+        return entries_per_block_;
+    }
+
+    size_t num_entries = entries_per_block_;
+    switch (growth_.mode)
+    {
+    case ObjectPoolGrowth::FIXED:
+        break;
+    case ObjectPoolGrowth::GEOMETRIC:
+        num_entries = std::max(num_entries, capacity_);
+        break;
+    case ObjectPoolGrowth::CUSTOM:
+        num_entries = growth_.callback(growth_.user_data, num_blocks_, capacity_);
+        break;
+    }
+    num_entries = std::min<size_t>(std::max<size_t>(num_entries, 1), max_entries_per_block_);
+    return std::min(round_to_pages(static_cast<index_t>(num_entries), allocator_.page_size),
+        max_entries_per_block_);
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::BlockInfo* DynamicObjectPool<T, Policy>::add_block()
+{
+    assert(free_block_index_ == detail::INVALID_INDEX);
+    // grow block info storage geometrically so adding blocks is amortized
+    // constant time
+    if (num_blocks_ == block_info_capacity_)
+    {
+        const index_t new_capacity = std::max<index_t>(4, block_info_capacity_ * 2);
+        BlockInfo* new_block_info =
+            reinterpret_cast<BlockInfo*>(realloc(block_info_, new_capacity * sizeof(BlockInfo)));
+        if (!new_block_info)
+        {
+            return nullptr;
+        }
+        block_info_ = new_block_info;
+        block_info_capacity_ = new_capacity;
+    }
+
+    // the block index must fit in the position bits of a handle above the
+    // entry index
+    if (Policy::generations
+        && uint64_t(num_blocks_) >> (Block::HANDLE_POSITION_BITS - handle_index_bits_) != 0)
+    {
+        return nullptr;
+    }
+
+    const index_t num_entries = next_block_entries();
+    if (Block* block = Block::create(num_entries, block_align_, allocator_))
+    {
+        if (Policy::generations && first_generation_ != 1)
+        {
+            block->reset_generations(first_generation_);
+        }
+        const index_t index = num_blocks_;
+        block->set_pool_index(index);
+        // update the number of blocks
+        ++num_blocks_;
+        capacity_ += num_entries;
+        bytes_in_blocks_ += Block::calc_block_size(num_entries);
+        telemetry_.add_blocks_added(1);
+        // initialise the new block info structure
+        BlockInfo& info = block_info_[index];
+        info.num_free_ = num_entries;
+        info.num_entries_ = num_entries;
+        info.block_ = block;
+        // the new block is the only one with space
+        info.next_free_ = detail::INVALID_INDEX;
+        info.prev_free_ = detail::INVALID_INDEX;
+        free_block_index_ = index;
+        ++num_free_blocks_;
+        return &info;
+    }
+    return nullptr;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::destroy_block(Block* block)
+{
+    const std::less<const Block*> less;
+    typename std::vector<const Block*>::iterator itr =
+        std::lower_bound(mapped_blocks_.begin(), mapped_blocks_.end(), block, less);
+    if (itr != mapped_blocks_.end() && *itr == block)
+    {
+        mapped_blocks_.erase(itr);
+        Block::destroy(block, detail::pool_file_allocator());
+    }
+    else
+    {
+        Block::destroy(block, allocator_);
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::rebuild_free_list()
+{
+    // link blocks with space from back to front so the lowest index is first
+    free_block_index_ = detail::INVALID_INDEX;
+    for (index_t index = num_blocks_; index-- != 0;)
+    {
+        BlockInfo& info = block_info_[index];
+        if (info.num_free_ != 0)
+        {
+            info.next_free_ = free_block_index_;
+            info.prev_free_ = detail::INVALID_INDEX;
+            if (free_block_index_ != detail::INVALID_INDEX)
+            {
+                block_info_[free_block_index_].prev_free_ = index;
+            }
+            free_block_index_ = index;
+        }
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::link_free_block(index_t block_index)
+{
+    // find the block to insert after, keeping the list in index order if
+    // the policy is address ordered
+    index_t prev = detail::INVALID_INDEX;
+    index_t next = free_block_index_;
+    if (Policy::address_ordered)
+    {
+        while (next != detail::INVALID_INDEX && next < block_index)
+        {
+            prev = next;
+            next = block_info_[next].next_free_;
+            telemetry_.add_blocks_scanned(1);
+        }
+    }
+    BlockInfo& info = block_info_[block_index];
+    info.prev_free_ = prev;
+    info.next_free_ = next;
+    if (prev != detail::INVALID_INDEX)
+    {
+        block_info_[prev].next_free_ = block_index;
+    }
+    else
+    {
+        free_block_index_ = block_index;
+    }
+    if (next != detail::INVALID_INDEX)
+    {
+        block_info_[next].prev_free_ = block_index;
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::unlink_free_block(index_t block_index)
+{
+    const BlockInfo& info = block_info_[block_index];
+    if (info.prev_free_ != detail::INVALID_INDEX)
+    {
+        block_info_[info.prev_free_].next_free_ = info.next_free_;
+    }
+    else
+    {
+        assert(free_block_index_ == block_index);
+        free_block_index_ = info.next_free_;
+    }
+    if (info.next_free_ != detail::INVALID_INDEX)
+    {
+        block_info_[info.next_free_].prev_free_ = info.prev_free_;
+    }
+}
+
+template <typename T, typename Policy>
+template <typename... P>
+T* DynamicObjectPool<T, Policy>::new_object(P&&... params)
+{
+    const uint64_t start = telemetry_.begin_sample();
+    T* ptr = allocate();
+    telemetry_.end_alloc_sample(start);
+    if (ptr)
+    {
+        new (ptr) T(std::forward<P>(params)...);
+    }
+    return ptr;
+}
+
+template <typename T, typename Policy>
+template <typename... P>
+T* DynamicObjectPool<T, Policy>::new_object_near(const T* hint, P&&... params)
+{
+    const uint64_t start = telemetry_.begin_sample();
+    T* ptr = allocate_near(hint);
+    telemetry_.end_alloc_sample(start);
+    if (ptr)
+    {
+        new (ptr) T(std::forward<P>(params)...);
+    }
+    return ptr;
+}
+
+template <typename T, typename Policy>
+T* DynamicObjectPool<T, Policy>::allocate_near(const T* hint)
+{
+    if (hint)
+    {
+        const Block* block = Block::from_pointer(hint, block_align_);
+        const index_t block_index = block->pool_index();
+        assert(block_index < num_blocks_ && block_info_[block_index].block_ == block);
+        BlockInfo* p_info = block_info_ + block_index;
+        telemetry_.add_blocks_scanned(1);
+        if (p_info->num_free_ != 0)
+        {
+            return allocate_from(p_info);
+        }
+    }
+    return allocate();
+}
+
+template <typename T, typename Policy>
+T* DynamicObjectPool<T, Policy>::allocate()
+{
+    // if no blocks have space then reuse entries freed by other threads
+    // before creating a new block
+    if (free_block_index_ == detail::INVALID_INDEX)
+    {
+        collect_remote_frees();
+    }
+    BlockInfo* p_info;
+    if (free_block_index_ != detail::INVALID_INDEX)
+    {
+        p_info = block_info_ + free_block_index_;
+        telemetry_.add_blocks_scanned(1);
+    }
+    else
+    {
+        p_info = add_block();
+        if (!p_info)
+        {
+            telemetry_.add_failed_allocs(1);
+            return nullptr;
+        }
+    }
+    return allocate_from(p_info);
+}
+
+template <typename T, typename Policy>
+T* DynamicObjectPool<T, Policy>::allocate_from(BlockInfo* p_info)
+{
+    T* ptr = p_info->block_->allocate();
+    assert(ptr != nullptr);
+    // update counts, removing the block from the free list if full
+    if (p_info->num_free_ == p_info->num_entries_)
+    {
+        --num_free_blocks_;
+    }
+    if (--p_info->num_free_ == 0)
+    {
+        unlink_free_block(static_cast<index_t>(p_info - block_info_));
+    }
+    if (++num_allocations_ > peak_allocations_)
+    {
+        peak_allocations_ = num_allocations_;
+    }
+    telemetry_.add_allocs(1);
+    return ptr;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        // find the owning block from the pointer address
+        Block* block = Block::from_pointer(ptr, block_align_);
+        const index_t block_index = block->pool_index();
+        assert(block_index < num_blocks_ && block_info_[block_index].block_ == block);
+        ptr->~T();
+        const uint64_t start = telemetry_.begin_sample();
+        block->deallocate(ptr);
+        on_entries_freed(block_index, 1);
+        telemetry_.end_free_sample(start);
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::deallocate(const T* ptr)
+{
+    if (ptr)
+    {
+        Block* block = Block::from_pointer(ptr, block_align_);
+        const index_t block_index = block->pool_index();
+        assert(block_index < num_blocks_ && block_info_[block_index].block_ == block);
+        block->deallocate(ptr);
+        on_entries_freed(block_index, 1);
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::remote_delete_object(const T* ptr)
+{
+    static_assert(sizeof(T) >= sizeof(void*), "remote frees require pointer sized entries");
+    static_assert(!Policy::generations, "remote frees do not support generations");
+    if (ptr)
+    {
+        ptr->~T();
+        // the storage may not be pointer aligned so the link is copied in
+        void* node = const_cast<T*>(ptr);
+        void* head = remote_frees_.load(std::memory_order_relaxed);
+        do
+        {
+            memcpy(node, &head, sizeof(head));
+        } while (!remote_frees_.compare_exchange_weak(
+            head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+}
+
+template <typename T, typename Policy>
+size_t DynamicObjectPool<T, Policy>::collect_remote_frees()
+{
+    // take the whole list at once, as there is a single consumer nothing
+    // else can pop entries so the list can be walked without ABA problems
+    if (remote_frees_.load(std::memory_order_relaxed) == nullptr)
+    {
+        return 0;
+    }
+    void* node = remote_frees_.exchange(nullptr, std::memory_order_acquire);
+    size_t count = 0;
+    while (node)
+    {
+        void* next;
+        memcpy(&next, node, sizeof(next));
+        deallocate(static_cast<T*>(node));
+        node = next;
+        ++count;
+    }
+    return count;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::on_entries_freed(index_t block_index, index_t count)
+{
+    BlockInfo* p_info = block_info_ + block_index;
+    telemetry_.add_blocks_scanned(1);
+    telemetry_.add_frees(count);
+    // add the block to the free list if it was full
+    if (p_info->num_free_ == 0)
+    {
+        link_free_block(block_index);
+    }
+    p_info->num_free_ += count;
+    if (p_info->num_free_ == p_info->num_entries_)
+    {
+        ++num_free_blocks_;
+    }
+    num_allocations_ -= count;
+}
+
+template <typename T, typename Policy>
+template <class... P>
+typename DynamicObjectPool<T, Policy>::index_t DynamicObjectPool<T, Policy>::new_objects(
+    index_t count, T** ptrs, const P&... params)
+{
+    index_t num_allocated = 0;
+    while (num_allocated != count)
+    {
+        // if no blocks have space then reuse entries freed by other threads,
+        // then create a new block
+        if (free_block_index_ == detail::INVALID_INDEX)
+        {
+            collect_remote_frees();
+        }
+        BlockInfo* p_info;
+        if (free_block_index_ != detail::INVALID_INDEX)
+        {
+            p_info = block_info_ + free_block_index_;
+            telemetry_.add_blocks_scanned(1);
+        }
+        else
+        {
+            p_info = add_block();
+            if (!p_info)
+            {
+                telemetry_.add_failed_allocs(1);
+                break;
+            }
+        }
+
+        // take as many entries as possible from this block
+        const index_t num_wanted = std::min(count - num_allocated, p_info->num_free_);
+        const index_t num_taken = p_info->block_->allocate_n(ptrs + num_allocated, num_wanted);
+        assert(num_taken == num_wanted);
+        if (p_info->num_free_ == p_info->num_entries_)
+        {
+            --num_free_blocks_;
+        }
+        p_info->num_free_ -= num_taken;
+        if (p_info->num_free_ == 0)
+        {
+            unlink_free_block(static_cast<index_t>(p_info - block_info_));
+        }
+        num_allocated += num_taken;
+    }
+
+    num_allocations_ += num_allocated;
+    if (num_allocations_ > peak_allocations_)
+    {
+        peak_allocations_ = num_allocations_;
+    }
+    telemetry_.add_allocs(num_allocated);
+
+    // construct the new objects
+    for (index_t i = 0; i != num_allocated; ++i)
+    {
+        new (ptrs[i]) T(params...);
+    }
+    return num_allocated;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::delete_objects(const T* const* ptrs, index_t count)
+{
+    // runs of pointers into the same block are freed together, so unless
+    // the batch is already grouped bucket a copy by block to make each
+    // block one run
+    bool sorted = true;
+    bool one_block = true;
+    const T* prev = nullptr;
+    for (index_t i = 0; i != count && (sorted || one_block); ++i)
+    {
+        if (ptrs[i] == nullptr)
+        {
+            continue;
+        }
+        if (prev)
+        {
+            sorted = sorted && !std::less<const T*>()(ptrs[i], prev);
+            one_block = one_block
+                && Block::from_pointer(ptrs[i], block_align_)
+                    == Block::from_pointer(prev, block_align_);
+        }
+        prev = ptrs[i];
+    }
+    if (sorted || one_block)
+    {
+        delete_block_runs(ptrs, count);
+        return;
+    }
+    if (count < num_blocks_)
+    {
+        // a counting sort costs a pass over every block, which dwarfs small
+        // batches in large pools, so sort the copy by address instead
+        delete_scratch_.assign(ptrs, ptrs + count);
+        std::sort(delete_scratch_.begin(), delete_scratch_.end(), std::less<const T*>());
+        delete_block_runs(delete_scratch_.data(), count);
+        return;
+    }
+    // counting sort by block index, which is linear in the batch size
+    delete_block_starts_.assign(num_blocks_ + 1, 0);
+    index_t num_ptrs = 0;
+    for (index_t i = 0; i != count; ++i)
+    {
+        if (ptrs[i] != nullptr)
+        {
+            ++delete_block_starts_[Block::from_pointer(ptrs[i], block_align_)->pool_index() + 1];
+            ++num_ptrs;
+        }
+    }
+    for (index_t index = 0; index != num_blocks_; ++index)
+    {
+        delete_block_starts_[index + 1] += delete_block_starts_[index];
+    }
+    delete_scratch_.resize(num_ptrs);
+    for (index_t i = 0; i != count; ++i)
+    {
+        if (ptrs[i] != nullptr)
+        {
+            const index_t block_index = Block::from_pointer(ptrs[i], block_align_)->pool_index();
+            delete_scratch_[delete_block_starts_[block_index]++] = ptrs[i];
+        }
+    }
+    delete_block_runs(delete_scratch_.data(), num_ptrs);
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::delete_block_runs(const T* const* ptrs, index_t count)
+{
+    index_t num_freed = 0;
+    bool relink = false;
+    index_t first = 0;
+    while (first != count)
+    {
+        if (ptrs[first] == nullptr)
+        {
+            ++first;
+            continue;
+        }
+        // free each run of pointers from the same block in a single batch
+        Block* block = Block::from_pointer(ptrs[first], block_align_);
+        const index_t block_index = block->pool_index();
+        BlockInfo& info = block_info_[block_index];
+        assert(block_index < num_blocks_ && info.block_ == block);
+        index_t last = first;
+        for (; last != count && ptrs[last] != nullptr
+             && Block::from_pointer(ptrs[last], block_align_) == block;
+             ++last)
+        {
+            ptrs[last]->~T();
+        }
+        const index_t num_block_freed = last - first;
+        block->deallocate_n(ptrs + first, num_block_freed);
+        telemetry_.add_blocks_scanned(1);
+
+        // linking in front of the free block list is cheap, but address
+        // ordered lists are walked to insert so are rebuilt once at the end
+        if (info.num_free_ == 0)
+        {
+            if (Policy::address_ordered)
+            {
+                relink = true;
+            }
+            else
+            {
+                link_free_block(block_index);
+            }
+        }
+        info.num_free_ += num_block_freed;
+        if (info.num_free_ == info.num_entries_)
+        {
+            ++num_free_blocks_;
+        }
+        num_freed += num_block_freed;
+        first = last;
+    }
+    num_allocations_ -= num_freed;
+    telemetry_.add_frees(num_freed);
+    if (relink)
+    {
+        rebuild_free_list();
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::delete_all()
+{
+    // remotely deleted objects have already been destructed
+    collect_remote_frees();
+    telemetry_.add_frees(num_allocations_);
+    for (BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
+         ++p_info)
+    {
+        p_info->block_->delete_all();
+        p_info->num_free_ = p_info->num_entries_;
+    }
+    num_allocations_ = 0;
+    num_free_blocks_ = num_blocks_;
+    rebuild_free_list();
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::reset(size_t retained_bytes)
+{
+    delete_all();
+    // keep the first blocks which fit, block indices don't change so
+    // handles to the deleted objects stay invalid
+    size_t bytes = Block::calc_block_size(block_info_[0].num_entries_);
+    index_t num_kept = 1;
+    while (num_kept != num_blocks_)
+    {
+        bytes += Block::calc_block_size(block_info_[num_kept].num_entries_);
+        if (bytes > retained_bytes)
+        {
+            break;
+        }
+        ++num_kept;
+    }
+    if (num_kept != num_blocks_)
+    {
+        free_blocks_from(num_kept);
+    }
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::reclaim_memory()
+{
+    collect_remote_frees();
+    std::vector<const T*>().swap(delete_scratch_);
+    std::vector<index_t>().swap(delete_block_starts_);
+    std::vector<Block*>().swap(compact_order_);
+    std::vector<Block*>().swap(compact_emptied_);
+    index_t used_index = num_blocks_;
+    if (Policy::generations)
+    {
+        // handles contain block indices so blocks can't be moved, only the
+        // empty blocks after the last used block are freed
+        for (index_t index = num_blocks_; index-- != 0;)
+        {
+            if (block_info_[index].num_free_ != block_info_[index].num_entries_)
+            {
+                used_index = index;
+                break;
+            }
+        }
+    }
+    else
+    {
+        // loop through all blocks shuffling the used blocks to the front and
+        // unused to the back.
+        index_t empty_index = num_blocks_;
+        for (index_t index = 0; index < num_blocks_; ++index)
+        {
+            if (block_info_[index].num_free_ != block_info_[index].num_entries_)
+            {
+                used_index = index;
+            }
+            else if (index < empty_index)
+            {
+                empty_index = index;
+            }
+
+            if (empty_index < used_index && used_index != num_blocks_)
+            {
+                std::swap(block_info_[empty_index], block_info_[used_index]);
+                used_index = empty_index;
+                ++empty_index;
+            }
+        }
+    }
+
+    // if no blocks are used, keep one around
+    if (used_index == num_blocks_)
+    {
+        used_index = 0;
+    }
+    free_blocks_from(used_index + 1);
+}
+
+template <typename T, typename Policy>
+template <typename F>
+bool DynamicObjectPool<T, Policy>::compact(F on_move, size_t max_moves)
+{
+    collect_remote_frees();
+    // start a pass by ordering blocks by preference as a destination, the
+    // most occupied first or the lowest index first if block indices are
+    // part of handles
+    if (compact_order_.empty())
+    {
+        compact_order_.resize(num_blocks_);
+        for (index_t index = 0; index != num_blocks_; ++index)
+        {
+            compact_order_[index] = block_info_[index].block_;
+        }
+        if (!Policy::generations)
+        {
+            std::stable_sort(compact_order_.begin(), compact_order_.end(),
+                [](const Block* a, const Block* b)
+                {
+                    return a->num_allocations() > b->num_allocations();
+                });
+        }
+        compact_dst_ = 0;
+        compact_src_ = compact_order_.size();
+    }
+
+    // move entries from the back of the order into space at the front
+    const std::vector<Block*>& order = compact_order_;
+    size_t& dst = compact_dst_;
+    size_t& src = compact_src_;
+    size_t num_moves = 0;
+    bool done = false;
+    while (num_moves != max_moves)
+    {
+        while (dst < src && block_info_[order[dst]->pool_index()].num_free_ == 0)
+        {
+            ++dst;
+        }
+        while (src > dst && order[src - 1]->num_allocations() == 0)
+        {
+            --src;
+        }
+        if (src <= dst + 1)
+        {
+            done = true;
+            break;
+        }
+
+        const index_t src_index = order[src - 1]->pool_index();
+        BlockInfo& src_info = block_info_[src_index];
+        src_info.block_->for_each([&](T* from)
+            {
+                // find space before the source block
+                while (dst + 1 < src && block_info_[order[dst]->pool_index()].num_free_ == 0)
+                {
+                    ++dst;
+                }
+                if (num_moves == max_moves || dst + 1 >= src)
+                {
+                    return;
+                }
+                const index_t dst_index = order[dst]->pool_index();
+                BlockInfo& dst_info = block_info_[dst_index];
+                T* to = dst_info.block_->allocate();
+                assert(to != nullptr);
+                new (to) T(std::move(*from));
+                on_move(const_cast<const T*>(from), to);
+                from->~T();
+                src_info.block_->deallocate(from);
+                ++num_moves;
+
+                // update counts and the free block list as the entry moves
+                if (dst_info.num_free_ == dst_info.num_entries_)
+                {
+                    --num_free_blocks_;
+                }
+                if (--dst_info.num_free_ == 0)
+                {
+                    unlink_free_block(dst_index);
+                }
+                if (src_info.num_free_ == 0)
+                {
+                    link_free_block(src_index);
+                }
+                if (++src_info.num_free_ == src_info.num_entries_)
+                {
+                    ++num_free_blocks_;
+                    compact_emptied_.push_back(src_info.block_);
+                }
+            });
+        // step past an emptied source block now as it is about to be freed
+        if (src_info.num_free_ == src_info.num_entries_)
+        {
+            --src;
+        }
+    }
+
+    // free the blocks emptied by this call, they are in the order they were
+    // emptied which is highest index first with generations so trailing
+    // blocks are freed before the blocks in front of them
+    for (size_t i = 0; i != compact_emptied_.size(); ++i)
+    {
+        const index_t index = compact_emptied_[i]->pool_index();
+        if (Policy::generations && index + 1 != num_blocks_)
+        {
+            break;
+        }
+        free_block(index);
+    }
+    compact_emptied_.clear();
+    if (done)
+    {
+        compact_order_.clear();
+    }
+    return done;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::free_blocks_from(index_t first_empty)
+{
+    // the blocks of a compaction pass may be freed or shuffled, so start
+    // the next call of compact afresh
+    compact_order_.clear();
+    // free remaining empty blocks
+    if (first_empty < num_blocks_)
+    {
+        telemetry_.add_blocks_freed(num_blocks_ - first_empty);
+    }
+    for (index_t index = first_empty; index < num_blocks_; ++index)
+    {
+        Block* block = block_info_[index].block_;
+        // new blocks which reuse this index must start from later
+        // generations so handles to entries of this block stay invalid
+        if (Policy::generations)
+        {
+            first_generation_ =
+                std::max(first_generation_, Block::next_generation(block->max_generation()));
+        }
+        destroy_block(block);
+    }
+
+    // shrink the block info array to fit, keeping the old storage if
+    // realloc fails
+    num_blocks_ = std::min(num_blocks_, first_empty);
+    if (BlockInfo* new_block_info =
+            reinterpret_cast<BlockInfo*>(realloc(block_info_, sizeof(BlockInfo) * num_blocks_)))
+    {
+        block_info_ = new_block_info;
+        block_info_capacity_ = num_blocks_;
+    }
+
+    // blocks may have been shuffled so update their indices
+    num_free_blocks_ = 0;
+    capacity_ = 0;
+    bytes_in_blocks_ = 0;
+    for (index_t index = 0; index != num_blocks_; ++index)
+    {
+        const BlockInfo& info = block_info_[index];
+        info.block_->set_pool_index(index);
+        if (info.num_free_ == info.num_entries_)
+        {
+            ++num_free_blocks_;
+        }
+        capacity_ += info.num_entries_;
+        bytes_in_blocks_ += Block::calc_block_size(info.num_entries_);
+    }
+
+    // relink the remaining blocks with space
+    rebuild_free_list();
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::free_block(index_t block_index)
+{
+    assert(!Policy::generations || block_index + 1 == num_blocks_);
+    BlockInfo& info = block_info_[block_index];
+    assert(info.num_free_ == info.num_entries_);
+    unlink_free_block(block_index);
+    --num_free_blocks_;
+    capacity_ -= info.num_entries_;
+    bytes_in_blocks_ -= Block::calc_block_size(info.num_entries_);
+    telemetry_.add_blocks_freed(1);
+    if (Policy::generations)
+    {
+        first_generation_ =
+            std::max(first_generation_, Block::next_generation(info.block_->max_generation()));
+    }
+    destroy_block(info.block_);
+
+    // move the last block into the hole, relinking it under its new index
+    const index_t last_index = --num_blocks_;
+    if (block_index != last_index)
+    {
+        const bool has_space = block_info_[last_index].num_free_ != 0;
+        if (has_space)
+        {
+            unlink_free_block(last_index);
+        }
+        info = block_info_[last_index];
+        info.block_->set_pool_index(block_index);
+        if (has_space)
+        {
+            link_free_block(block_index);
+        }
+    }
+}
+
+template <typename T, typename Policy>
+template <typename F>
+void DynamicObjectPool<T, Policy>::for_each(const F func)
+{
+    // remotely deleted objects have been destructed so mustn't be visited
+    collect_remote_frees();
+    static_cast<const DynamicObjectPool*>(this)->for_each(func);
+}
+
+template <typename T, typename Policy>
+template <typename F>
+void DynamicObjectPool<T, Policy>::for_each(const F func) const
+{
+    assert(remote_frees_.load(std::memory_order_relaxed) == nullptr);
+    for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
+         ++p_info)
+    {
+        if (p_info->num_free_ < p_info->num_entries_)
+        {
+            p_info->block_->for_each(func);
+        }
+    }
+}
+
+template <typename T, typename Policy>
+template <typename F, typename E>
+void DynamicObjectPool<T, Policy>::parallel_for_each(
+    const F func, E&& executor, index_t chunk_size)
+{
+    collect_remote_frees();
+    static_cast<const DynamicObjectPool*>(this)->parallel_for_each(
+        func, std::forward<E>(executor), chunk_size);
+}
+
+template <typename T, typename Policy>
+template <typename F, typename E>
+void DynamicObjectPool<T, Policy>::parallel_for_each(
+    const F func, E&& executor, index_t chunk_size) const
+{
+    assert(remote_frees_.load(std::memory_order_relaxed) == nullptr);
+    struct Task
+    {
+        const Block* block_;
+        index_t begin_;
+        index_t end_;
+    };
+
+    // split live blocks into tasks starting on bitmap word boundaries
+    const index_t word_bits = sizeof(detail::bitmap_word_t) * 8;
+    const index_t step =
+        chunk_size == 0 ? 0 : (chunk_size + word_bits - 1) / word_bits * word_bits;
+    std::vector<Task> tasks;
+    for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
+         ++p_info)
+    {
+        if (p_info->num_free_ == p_info->num_entries_)
+        {
+            continue;
+        }
+        const index_t num_entries = p_info->num_entries_;
+        for (index_t begin = 0, end = 0; begin != num_entries; begin = end)
+        {
+            end = step == 0 || num_entries - begin <= step ? num_entries : begin + step;
+            Task task = {p_info->block_, begin, end};
+            tasks.push_back(task);
+        }
+    }
+
+    const std::function<void(size_t)> run = [&tasks, &func](size_t index)
+    {
+        const Task& task = tasks[index];
+        task.block_->for_each_in(task.begin_, task.end_, func);
+    };
+    executor(tasks.size(), run);
+}
+
+template <typename T, typename Policy>
+template <typename V>
+DynamicObjectPool<T, Policy>::Iterator<V>::Iterator()
+    : pool_(nullptr),
+      block_index_(0),
+      index_(0)
+{
+}
+
+template <typename T, typename Policy>
+template <typename V>
+template <typename U, typename>
+DynamicObjectPool<T, Policy>::Iterator<V>::Iterator(const Iterator<U>& other)
+    : pool_(other.pool_),
+      block_index_(other.block_index_),
+      index_(other.index_)
+{
+}
+
+template <typename T, typename Policy>
+template <typename V>
+DynamicObjectPool<T, Policy>::Iterator<V>::Iterator(
+    const DynamicObjectPool* pool, index_t block_index, index_t index)
+    : pool_(pool),
+      block_index_(block_index),
+      index_(index)
+{
+    seek();
+}
+
+template <typename T, typename Policy>
+template <typename V>
+V& DynamicObjectPool<T, Policy>::Iterator<V>::operator*() const
+{
+    return *operator->();
+}
+
+template <typename T, typename Policy>
+template <typename V>
+V* DynamicObjectPool<T, Policy>::Iterator<V>::operator->() const
+{
+    return pool_->block_info_[block_index_].block_->entry_at(index_);
+}
+
+template <typename T, typename Policy>
+template <typename V>
+typename DynamicObjectPool<T, Policy>::template Iterator<V>&
+DynamicObjectPool<T, Policy>::Iterator<V>::operator++()
+{
+    ++index_;
+    seek();
+    return *this;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+typename DynamicObjectPool<T, Policy>::template Iterator<V>
+DynamicObjectPool<T, Policy>::Iterator<V>::operator++(int)
+{
+    Iterator result = *this;
+    ++*this;
+    return result;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+bool DynamicObjectPool<T, Policy>::Iterator<V>::operator==(const Iterator& other) const
+{
+    return block_index_ == other.block_index_ && index_ == other.index_;
+}
+
+template <typename T, typename Policy>
+template <typename V>
+bool DynamicObjectPool<T, Policy>::Iterator<V>::operator!=(const Iterator& other) const
+{
+    return !(*this == other);
+}
+
+template <typename T, typename Policy>
+template <typename V>
+void DynamicObjectPool<T, Policy>::Iterator<V>::seek()
+{
+    for (; block_index_ != pool_->num_blocks_; ++block_index_, index_ = 0)
+    {
+        const BlockInfo& info = pool_->block_info_[block_index_];
+        if (info.num_free_ != info.num_entries_)
+        {
+            index_ = info.block_->find_allocated(index_);
+            if (index_ != info.num_entries_)
+            {
+                return;
+            }
+        }
+    }
+    index_ = 0;
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::iterator DynamicObjectPool<T, Policy>::begin()
+{
+    collect_remote_frees();
+    return iterator(this, 0, 0);
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::iterator DynamicObjectPool<T, Policy>::end()
+{
+    return iterator(this, num_blocks_, 0);
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::const_iterator DynamicObjectPool<T, Policy>::begin() const
+{
+    assert(remote_frees_.load(std::memory_order_relaxed) == nullptr);
+    return const_iterator(this, 0, 0);
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::const_iterator DynamicObjectPool<T, Policy>::end() const
+{
+    return const_iterator(this, num_blocks_, 0);
+}
+
+template <typename T, typename Policy>
+ObjectPoolStats DynamicObjectPool<T, Policy>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = num_blocks_;
+    stats.num_allocations = num_allocations_;
+    stats.peak_allocations = peak_allocations_;
+    stats.num_free_blocks = num_free_blocks_;
+    stats.bytes_reserved = bytes_in_blocks_ + block_info_capacity_ * sizeof(BlockInfo);
+    stats.bytes_in_use = num_allocations_ * sizeof(T);
+    return stats;
+}
+
+template <typename T, typename Policy>
+ObjectPoolTelemetry DynamicObjectPool<T, Policy>::telemetry() const
+{
+    static_assert(Policy::telemetry, "telemetry requires a policy with telemetry enabled");
+    ObjectPoolTelemetry telemetry;
+    telemetry_.snapshot(telemetry);
+    telemetry.peak_allocations = peak_allocations_;
+    return telemetry;
+}
+
+template <typename T, typename Policy>
+void DynamicObjectPool<T, Policy>::reset_telemetry()
+{
+    static_assert(Policy::telemetry, "telemetry requires a policy with telemetry enabled");
+    telemetry_.reset();
+}
+
+template <typename T, typename Policy>
+typename DynamicObjectPool<T, Policy>::handle_t DynamicObjectPool<T, Policy>::handle_of(
+    const T* ptr) const
+{
+    const Block* block = Block::from_pointer(ptr, block_align_);
+    const index_t index = block->index_of(ptr);
+    const handle_t position = handle_t(block->pool_index()) << handle_index_bits_ | index;
+    return handle_t(block->generation(index)) << Block::HANDLE_POSITION_BITS | position;
+}
+
+template <typename T, typename Policy>
+T* DynamicObjectPool<T, Policy>::resolve(handle_t handle) const
+{
+    const handle_t position_mask = (handle_t(1) << Block::HANDLE_POSITION_BITS) - 1;
+    const handle_t position = handle & position_mask;
+    const index_t block_index = static_cast<index_t>(position >> handle_index_bits_);
+    if (block_index >= num_blocks_)
+    {
+        return nullptr;
+    }
+    const handle_t index_mask = (handle_t(1) << handle_index_bits_) - 1;
+    const index_t index = static_cast<index_t>(position & index_mask);
+    return block_info_[block_index].block_->resolve(
+        index, static_cast<index_t>(handle >> Block::HANDLE_POSITION_BITS));
+}
+
+template <typename T, typename Policy>
+bool DynamicObjectPool<T, Policy>::is_valid(handle_t handle) const
+{
+    return resolve(handle) != nullptr;
+}
+
+template <typename T, typename Policy>
+bool DynamicObjectPool<T, Policy>::save(const char* path) const
+{
+    assert(remote_frees_.load(std::memory_order_relaxed) == nullptr);
+    detail::PoolFileHeader header =
+        detail::make_pool_file_header<T, Policy>(max_entries_per_block_);
+    header.num_blocks = num_blocks_;
+    header.peak_allocations = peak_allocations_;
+    header.first_generation = first_generation_;
+    std::vector<detail::PoolFileBlock> blocks(num_blocks_);
+    std::vector<const void*> block_ptrs(num_blocks_);
+    for (index_t index = 0; index != num_blocks_; ++index)
+    {
+        const BlockInfo& info = block_info_[index];
+        blocks[index].size = Block::calc_block_size(info.num_entries_);
+        blocks[index].num_entries = info.num_entries_;
+        block_ptrs[index] = info.block_;
+    }
+    return detail::write_pool_file(path, header, blocks.data(), block_ptrs.data());
+}
+
+template <typename T, typename Policy>
+bool DynamicObjectPool<T, Policy>::load(const char* path, bool shared)
+{
+    collect_remote_frees();
+    assert(num_allocations_ == 0);
+    detail::PoolFileHeader header;
+    std::vector<detail::PoolFileBlock> blocks;
+    if (!detail::read_pool_file(path,
+            detail::make_pool_file_header<T, Policy>(max_entries_per_block_), header, blocks)
+        || blocks.empty() || blocks.size() >= detail::INVALID_INDEX)
+    {
+        return false;
+    }
+    for (const detail::PoolFileBlock& block : blocks)
+    {
+        if (block.num_entries == 0 || block.num_entries > max_entries_per_block_
+            || block.size != Block::calc_block_size(static_cast<index_t>(block.num_entries)))
+        {
+            return false;
+        }
+    }
+
+    // allocate the block infos before mapping so nothing can fail after the
+    // current blocks are freed
+    const index_t num_blocks = static_cast<index_t>(blocks.size());
+    BlockInfo* block_info = static_cast<BlockInfo*>(malloc(sizeof(BlockInfo) * num_blocks));
+    std::vector<void*> block_ptrs;
+    if (!block_info
+        || !detail::map_pool_file_blocks(path, shared, block_align_, blocks, block_ptrs))
+    {
+        free(block_info);
+        return false;
+    }
+    telemetry_.add_blocks_freed(num_blocks_);
+    for (index_t index = 0; index != num_blocks_; ++index)
+    {
+        destroy_block(block_info_[index].block_);
+    }
+    free(block_info_);
+    compact_order_.clear();
+
+    block_info_ = block_info;
+    num_blocks_ = num_blocks;
+    block_info_capacity_ = num_blocks;
+    num_allocations_ = 0;
+    num_free_blocks_ = 0;
+    capacity_ = 0;
+    bytes_in_blocks_ = 0;
+    for (index_t index = 0; index != num_blocks; ++index)
+    {
+        Block* block = static_cast<Block*>(block_ptrs[index]);
+        block->set_pool_index(index);
+        BlockInfo& info = block_info_[index];
+        info.num_entries_ = block->num_entries();
+        info.num_free_ = info.num_entries_ - block->num_allocations();
+        info.block_ = block;
+        if (info.num_free_ == info.num_entries_)
+        {
+            ++num_free_blocks_;
+        }
+        num_allocations_ += block->num_allocations();
+        capacity_ += info.num_entries_;
+        bytes_in_blocks_ += Block::calc_block_size(info.num_entries_);
+        mapped_blocks_.push_back(block);
+    }
+    std::sort(mapped_blocks_.begin(), mapped_blocks_.end(), std::less<const Block*>());
+    telemetry_.add_blocks_added(num_blocks);
+    peak_allocations_ = std::max<size_t>(header.peak_allocations, num_allocations_);
+    // later blocks must not reuse generations of saved handles
+    first_generation_ = std::max(first_generation_, static_cast<index_t>(header.first_generation));
+    rebuild_free_list();
+    return true;
+}
+
+template <typename T, typename Policy>
+bool DynamicObjectPool<T, Policy>::owns(const T* ptr) const
+{
+    // the masked address is only a block of this pool if it is in the
+    // block info array at the index stored in its header
+    const Block* block = Block::from_pointer(ptr, block_align_);
+    const index_t block_index = block->pool_index();
+    return block_index < num_blocks_ && block_info_[block_index].block_ == block;
+}
+
+template <typename T>
+NumaObjectPool<T>::NumaObjectPool(index_t entries_per_block, const ObjectPoolGrowth& growth)
+{
+    const index_t num_nodes = detail::numa_node_count();
+    nodes_.reserve(num_nodes);
+    for (index_t node = 0; node != num_nodes; ++node)
+    {
+        nodes_.emplace_back(new NodePool(
+            entries_per_block, growth, ObjectPoolBlockAllocator::numa_node(node)));
+    }
+}
+
+template <typename T>
+typename NumaObjectPool<T>::index_t NumaObjectPool<T>::num_nodes() const
+{
+    return static_cast<index_t>(nodes_.size());
+}
+
+template <typename T>
+typename NumaObjectPool<T>::index_t NumaObjectPool<T>::current_node() const
+{
+    const index_t node = detail::current_numa_node();
+    return node < nodes_.size() ? node : 0;
+}
+
+template <typename T>
+template <typename... P>
+T* NumaObjectPool<T>::new_object(P&&... params)
+{
+    return new_object_on_node(current_node(), std::forward<P>(params)...);
+}
+
+template <typename T>
+template <typename... P>
+T* NumaObjectPool<T>::new_object_on_node(index_t node, P&&... params)
+{
+    assert(node < nodes_.size());
+    if (T* ptr = nodes_[node]->new_object(std::forward<P>(params)...))
+    {
+        return ptr;
+    }
+    // the preferred node failed to grow, try the others in order
+    for (index_t other = 0; other != nodes_.size(); ++other)
+    {
+        if (other != node)
+        {
+            if (T* ptr = nodes_[other]->new_object(std::forward<P>(params)...))
+            {
+                return ptr;
+            }
+        }
+    }
+    return nullptr;
+}
+
+template <typename T>
+typename NumaObjectPool<T>::index_t NumaObjectPool<T>::node_of(const T* ptr) const
+{
+    for (index_t node = 0; node != nodes_.size(); ++node)
+    {
+        if (nodes_[node]->owns(ptr))
+        {
+            return node;
+        }
+    }
+    assert(false && "pointer is not owned by this pool");
+    return detail::INVALID_INDEX;
+}
+
+template <typename T>
+void NumaObjectPool<T>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        nodes_[node_of(ptr)]->delete_object(ptr);
+    }
+}
+
+template <typename T>
+void NumaObjectPool<T>::delete_all()
+{
+    for (auto& node : nodes_)
+    {
+        node->delete_all();
+    }
+}
+
+template <typename T>
+void NumaObjectPool<T>::reclaim_memory()
+{
+    for (auto& node : nodes_)
+    {
+        node->reclaim_memory();
+    }
+}
+
+template <typename T>
+template <typename F>
+void NumaObjectPool<T>::for_each(const F func) const
+{
+    // iterate each node as const so nothing is modified through the
+    // owning pointers
+    for (const auto& node : nodes_)
+    {
+        const NodePool& pool = *node;
+        pool.for_each(func);
+    }
+}
+
+template <typename T>
+ObjectPoolStats NumaObjectPool<T>::calc_stats() const
+{
+    // peak allocations is the sum of each node's peak, which may not have
+    // occurred at the same time
+    ObjectPoolStats stats;
+    for (const auto& node : nodes_)
+    {
+        const ObjectPoolStats node_stats = node->calc_stats();
+        stats.num_blocks += node_stats.num_blocks;
+        stats.num_allocations += node_stats.num_allocations;
+        stats.peak_allocations += node_stats.peak_allocations;
+        stats.num_free_blocks += node_stats.num_free_blocks;
+        stats.bytes_reserved += node_stats.bytes_reserved;
+        stats.bytes_in_use += node_stats.bytes_in_use;
+    }
+    return stats;
+}
+
+template <typename T>
+ObjectPoolStats NumaObjectPool<T>::calc_node_stats(index_t node) const
+{
+    assert(node < nodes_.size());
+    return nodes_[node]->calc_stats();
+}
+
+template <typename T>
+ObjectPoolAllocator<T>::ObjectPoolAllocator(ObjectPoolMemoryResource* resource)
+    : resource_(resource)
+{
+}
+
+template <typename T>
+template <typename U>
+ObjectPoolAllocator<T>::ObjectPoolAllocator(const ObjectPoolAllocator<U>& other)
+    : resource_(other.resource())
+{
+}
+
+template <typename T>
+T* ObjectPoolAllocator<T>::allocate(size_t n)
+{
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+}
+
+template <typename T>
+void ObjectPoolAllocator<T>::deallocate(T* ptr, size_t n)
+{
+    resource_->deallocate(ptr, n * sizeof(T), alignof(T));
+}
+
+template <typename T>
+ObjectPoolMemoryResource* ObjectPoolAllocator<T>::resource() const
+{
+    return resource_;
+}
+
+template <typename T, typename U>
+bool operator==(const ObjectPoolAllocator<T>& a, const ObjectPoolAllocator<U>& b)
+{
+    return a.resource() == b.resource();
+}
+
+template <typename T, typename U>
+bool operator!=(const ObjectPoolAllocator<T>& a, const ObjectPoolAllocator<U>& b)
+{
+    return !(a == b);
+}
+
+#if OBJECT_POOL_HAS_PMR
+inline PmrObjectPoolResource::PmrObjectPoolResource(
+    index_t entries_per_block, index_t max_entries_per_block)
+    : pools_(entries_per_block, max_entries_per_block)
+{
+}
+
+inline ObjectPoolMemoryResource& PmrObjectPoolResource::pools()
+{
+    return pools_;
+}
+
+inline const ObjectPoolMemoryResource& PmrObjectPoolResource::pools() const
+{
+    return pools_;
+}
+
+inline void* PmrObjectPoolResource::do_allocate(size_t bytes, size_t alignment)
+{
+    return pools_.allocate(bytes, alignment);
+}
+
+inline void PmrObjectPoolResource::do_deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+    pools_.deallocate(ptr, bytes, alignment);
+}
+
+inline bool PmrObjectPoolResource::do_is_equal(const std::pmr::memory_resource& other) const
+    noexcept
 {
-    // the header size
-    const size_t header_size = sizeof(ObjectPoolBlock<T>);
-#if _MSC_VER <= 1800
-    const size_t entry_align = __alignof(T);
-#else
-    const size_t entry_align = alignof(T);
+    return this == &other;
+}
 #endif
-    // extend indices size by alignment of T
-    const size_t indices_size = align_to(sizeof(index_t) * entries_per_block, entry_align);
-    // align block to cache line size, or entry alignment if larger
-    const size_t entries_size = sizeof(T) * entries_per_block;
-    // block size includes indices + entry alignment + entries
-    const size_t block_size = header_size + indices_size + entries_size;
-    ObjectPoolBlock<T>* ptr =
-        reinterpret_cast<ObjectPoolBlock<T>*>(aligned_malloc(block_size, MIN_BLOCK_ALIGN));
+
+template <typename T, class... P>
+T* SizeClassPool::new_object(P&&... params)
+{
+    static_assert(sizeof(T) <= MAX_SIZE, "type is too large for SizeClassPool");
+    static_assert(alignof(T) <= GRANULARITY, "type is over aligned for SizeClassPool");
+    void* ptr = allocate(sizeof(T));
     if (ptr)
     {
-        new (ptr) ObjectPoolBlock(entries_per_block);
-        assert(reinterpret_cast<uint8_t*>(ptr->indices_begin())
-            == reinterpret_cast<uint8_t*>(ptr) + header_size);
-        assert(reinterpret_cast<uint8_t*>(ptr->memory_begin())
-            == reinterpret_cast<uint8_t*>(ptr) + header_size + indices_size);
+        new (ptr) T(std::forward<P>(params)...);
     }
-    return ptr;
+    return static_cast<T*>(ptr);
 }
 
 template <typename T>
-void ObjectPoolBlock<T>::destroy(ObjectPoolBlock<T>* ptr)
+void SizeClassPool::delete_object(const T* ptr)
 {
-    ptr->~ObjectPoolBlock();
-    aligned_free(ptr);
+    if (ptr)
+    {
+        ptr->~T();
+        deallocate(ptr);
+    }
 }
 
-template <typename T>
-ObjectPoolBlock<T>::ObjectPoolBlock(index_t entries_per_block)
-    : free_head_index_(0), entries_per_block_(entries_per_block)
+inline SizeClassPool::index_t SizeClassPool::size_class_of(size_t size)
 {
-    index_t* indices = indices_begin();
-    for (index_t i = 0; i < entries_per_block; ++i)
-    {
-        indices[i] = i + 1;
-    }
+    return size == 0 ? 0 : static_cast<index_t>((size - 1) / GRANULARITY);
 }
 
-template <typename T>
-void destruct_all(ObjectPoolBlock<T>&,
-    typename std::enable_if<std::is_trivially_destructible<T>::value>::type* = 0)
+template <typename... Ts>
+const typename SoaObjectPool<Ts...>::index_t SoaObjectPool<Ts...>::INVALID_INDEX;
+
+template <typename... Ts>
+SoaObjectPool<Ts...>::SoaObjectPool(index_t entries_per_block)
+    : free_block_index_(detail::INVALID_INDEX),
+      entries_per_block_(static_cast<index_t>(
+          std::max<size_t>(BITS_PER_WORD, detail::next_pow2(entries_per_block)))),
+      entry_shift_(detail::floor_log2(entries_per_block_)),
+      num_allocations_(0),
+      peak_allocations_(0)
 {
-    // skip calling destructors for trivially destructible types
+    static_assert(sizeof...(Ts) != 0, "SoaObjectPool needs at least one column");
+    // the header is followed by the indices, the bitmap and then each column
+    // aligned to a cache line so columns can be loaded with aligned vectors
+    const size_t indices_end = sizeof(BlockHeader) + sizeof(index_t) * entries_per_block_;
+    bitmap_offset_ = detail::align_to(indices_end, sizeof(bitmap_word_t));
+    size_t offset = bitmap_offset_ + sizeof(bitmap_word_t) * (entries_per_block_ / BITS_PER_WORD);
+    const size_t sizes[] = {sizeof(Ts)...};
+    const size_t aligns[] = {alignof(Ts)...};
+    for (size_t i = 0; i != NUM_COLUMNS; ++i)
+    {
+        offset = detail::align_to(offset, std::max<size_t>(detail::MIN_BLOCK_ALIGN, aligns[i]));
+        column_offsets_[i] = offset;
+        offset += sizes[i] * entries_per_block_;
+    }
+    block_size_ = offset;
+
+    // always have one block available
+    add_block();
 }
 
-template <typename T>
-void destruct_all(ObjectPoolBlock<T>& t,
-    typename std::enable_if<!std::is_trivially_destructible<T>::value>::type* = 0)
+template <typename... Ts>
+SoaObjectPool<Ts...>::~SoaObjectPool()
 {
-    // call destructors on all live objects in the pool
-    t.for_each([](T* ptr)
-        {
-            ptr->~T();
-        });
+    // explicitly delete_object or delete_all before pool goes out of scope
+    assert(num_allocations_ == 0);
+    delete_all();
+    for (auto& info : blocks_)
+    {
+        detail::aligned_free(info.block_);
+    }
 }
 
-template <typename T>
-ObjectPoolBlock<T>::~ObjectPoolBlock()
+template <typename... Ts>
+typename SoaObjectPool<Ts...>::BlockHeader* SoaObjectPool<Ts...>::header(
+    index_t block_index) const
 {
-    // destruct any allocated objects
-    destruct_all(*this);
+    return reinterpret_cast<BlockHeader*>(blocks_[block_index].block_);
 }
 
-template <typename T>
-index_t* ObjectPoolBlock<T>::indices_begin() const
+template <typename... Ts>
+typename SoaObjectPool<Ts...>::index_t* SoaObjectPool<Ts...>::indices(index_t block_index) const
 {
-    // calculcates the start of the indicies
-    return reinterpret_cast<index_t*>(const_cast<ObjectPoolBlock<T>*>(this + 1));
+    return reinterpret_cast<index_t*>(blocks_[block_index].block_ + sizeof(BlockHeader));
 }
 
-template <typename T>
-T* ObjectPoolBlock<T>::memory_begin() const
+template <typename... Ts>
+typename SoaObjectPool<Ts...>::bitmap_word_t* SoaObjectPool<Ts...>::bitmap(
+    index_t block_index) const
 {
-    // calculates the start of pool memory
-    return reinterpret_cast<T*>(indices_begin() + entries_per_block_);
+    return reinterpret_cast<bitmap_word_t*>(blocks_[block_index].block_ + bitmap_offset_);
 }
 
-template <typename T>
-const T* ObjectPoolBlock<T>::memory_offset() const
+template <typename... Ts>
+template <size_t I>
+typename SoaObjectPool<Ts...>::template column_t<I>* SoaObjectPool<Ts...>::column(
+    index_t block_index) const
 {
-    return memory_begin();
+    return reinterpret_cast<column_t<I>*>(blocks_[block_index].block_ + column_offsets_[I]);
 }
 
-template <typename T>
-template <class... P>
-T* ObjectPoolBlock<T>::new_object(P&&... params)
+template <typename... Ts>
+bool SoaObjectPool<Ts...>::add_block()
 {
-    // get the head of the free list
-    const index_t index = free_head_index_;
-    if (index != entries_per_block_)
+    assert(free_block_index_ == detail::INVALID_INDEX);
+    // entry indices must not overflow or reach INVALID_INDEX
+    const index_t block_index = static_cast<index_t>(blocks_.size());
+    if ((uint64_t(block_index) + 1) << entry_shift_ > INVALID_INDEX)
     {
-        index_t* indices = indices_begin();
-        // assert that this index is not in use
-        assert(indices[index] != index);
-        // update head of the free list
-        free_head_index_ = indices[index];
-        // flag index as used by assigning it's own index
-        indices[index] = index;
-        // get object memory
-        T* ptr = memory_begin() + index;
-        // construct the entry
-        new (ptr) T(std::forward<P>(params)...);
-        return ptr;
+        return false;
     }
-    return nullptr;
+    const size_t aligns[] = {alignof(Ts)...};
+    const size_t block_align =
+        std::max<size_t>(detail::MIN_BLOCK_ALIGN, *std::max_element(aligns, aligns + NUM_COLUMNS));
+    uint8_t* block = static_cast<uint8_t*>(detail::aligned_malloc(block_size_, block_align));
+    if (!block)
+    {
+        return false;
+    }
+
+    BlockInfo info = {block, free_block_index_};
+    blocks_.push_back(info);
+    new (header(block_index)) BlockHeader();
+    index_t* block_indices = indices(block_index);
+    for (index_t i = 0; i != entries_per_block_; ++i)
+    {
+        block_indices[i] = i + 1;
+    }
+    std::fill_n(bitmap(block_index), entries_per_block_ / BITS_PER_WORD, bitmap_word_t(0));
+    free_block_index_ = block_index;
+    return true;
 }
 
-template <typename T>
-void ObjectPoolBlock<T>::delete_object(const T* ptr)
+template <typename... Ts>
+typename SoaObjectPool<Ts...>::index_t SoaObjectPool<Ts...>::allocate()
 {
-    if (ptr)
+    // if no blocks have space then create a new one
+    if (free_block_index_ == detail::INVALID_INDEX && !add_block())
     {
-        // assert that pointer is in range
-        const T* begin = memory_begin();
-        assert(ptr >= begin && ptr < (begin + entries_per_block_));
-        // destruct this object
-        ptr->~T();
-        // get the index of this pointer
-        const index_t index = static_cast<index_t>(ptr - begin);
-        index_t* indices = indices_begin();
-        // assert this index is allocated
-        assert(indices[index] == index);
-        // remove index from used list
-        indices[index] = free_head_index_;
-        // store index of next free entry in this entry
-        free_head_index_ = index;
+        return INVALID_INDEX;
     }
+    const index_t block_index = free_block_index_;
+    BlockHeader* block_header = header(block_index);
+    const index_t slot = block_header->free_list_.pop(indices(block_index), entries_per_block_);
+    assert(slot != entries_per_block_);
+    bitmap_word_t& word = bitmap(block_index)[slot / BITS_PER_WORD];
+    assert((word & (bitmap_word_t(1) << (slot % BITS_PER_WORD))) == 0);
+    word |= bitmap_word_t(1) << (slot % BITS_PER_WORD);
+    // remove the block from the free list if it is full
+    if (++block_header->num_allocations_ == entries_per_block_)
+    {
+        free_block_index_ = blocks_[block_index].next_free_;
+    }
+    if (++num_allocations_ > peak_allocations_)
+    {
+        peak_allocations_ = num_allocations_;
+    }
+    return block_index << entry_shift_ | slot;
 }
 
-template <typename T>
-template <typename F>
-void ObjectPoolBlock<T>::for_each(const F func) const
+template <typename... Ts>
+template <size_t... I, class... P>
+void SoaObjectPool<Ts...>::construct(
+    detail::index_sequence<I...>, std::false_type, index_t entry, P&&... params)
+{
+    const index_t block_index = entry >> entry_shift_;
+    const index_t slot = entry & (entries_per_block_ - 1);
+    const int expand[] = {
+        0, (new (column<I>(block_index) + slot) column_t<I>(std::forward<P>(params)), 0)...};
+    (void)expand;
+}
+
+template <typename... Ts>
+template <size_t... I>
+void SoaObjectPool<Ts...>::construct(detail::index_sequence<I...>, std::true_type, index_t entry)
+{
+    const index_t block_index = entry >> entry_shift_;
+    const index_t slot = entry & (entries_per_block_ - 1);
+    const int expand[] = {0, (new (column<I>(block_index) + slot) column_t<I>(), 0)...};
+    (void)expand;
+}
+
+template <typename... Ts>
+template <size_t... I>
+void SoaObjectPool<Ts...>::destruct(detail::index_sequence<I...>, index_t entry)
+{
+    const index_t block_index = entry >> entry_shift_;
+    const index_t slot = entry & (entries_per_block_ - 1);
+    const int expand[] = {0, (column<I>(block_index)[slot].~column_t<I>(), 0)...};
+    (void)expand;
+}
+
+template <typename... Ts>
+template <class... P>
+typename SoaObjectPool<Ts...>::index_t SoaObjectPool<Ts...>::new_object(P&&... params)
 {
-    const index_t* indices = indices_begin();
-    T* first = memory_begin();
-    for (index_t i = 0, count = entries_per_block_; i != count; ++i)
+    static_assert(sizeof...(P) == 0 || sizeof...(P) == NUM_COLUMNS,
+        "new_object takes no parameters or one for each column");
+    const index_t entry = allocate();
+    if (entry != INVALID_INDEX)
     {
-        if (indices[i] == i)
-        {
-            func(first + i);
-        }
+        // default construct every column if there are no parameters
+        construct(detail::make_index_sequence<NUM_COLUMNS>(),
+            std::integral_constant<bool, sizeof...(P) == 0>(), entry, std::forward<P>(params)...);
     }
+    return entry;
 }
 
-template <typename T>
-void ObjectPoolBlock<T>::delete_all()
+template <typename... Ts>
+void SoaObjectPool<Ts...>::delete_object(index_t entry)
 {
-    // destruct any allocated objects
-    destruct_all(*this);
-    free_head_index_ = 0;
-    index_t* indices = indices_begin();
-    for (index_t i = 0; i < entries_per_block_; ++i)
+    const index_t block_index = entry >> entry_shift_;
+    const index_t slot = entry & (entries_per_block_ - 1);
+    assert(block_index < blocks_.size());
+    bitmap_word_t& word = bitmap(block_index)[slot / BITS_PER_WORD];
+    const bitmap_word_t mask = bitmap_word_t(1) << (slot % BITS_PER_WORD);
+    // assert this entry is allocated
+    assert((word & mask) != 0);
+    destruct(detail::make_index_sequence<NUM_COLUMNS>(), entry);
+    word &= ~mask;
+    BlockHeader* block_header = header(block_index);
+    block_header->free_list_.push(indices(block_index), slot);
+    // add the block to the free list if it was full
+    if (block_header->num_allocations_-- == entries_per_block_)
     {
-        indices[i] = i + 1;
+        blocks_[block_index].next_free_ = free_block_index_;
+        free_block_index_ = block_index;
     }
+    --num_allocations_;
 }
 
-template <typename T>
-index_t ObjectPoolBlock<T>::num_allocations() const
+template <typename... Ts>
+void SoaObjectPool<Ts...>::delete_all()
 {
-    index_t num_allocs = 0;
-    for_each([&num_allocs](const T*)
+    const bool trivial[] = {std::is_trivially_destructible<Ts>::value...};
+    const bool all_trivial =
+        std::find(trivial, trivial + NUM_COLUMNS, false) == trivial + NUM_COLUMNS;
+    // link blocks from back to front so the lowest index is first
+    free_block_index_ = detail::INVALID_INDEX;
+    for (index_t block_index = static_cast<index_t>(blocks_.size()); block_index-- != 0;)
+    {
+        bitmap_word_t* block_bitmap = bitmap(block_index);
+        // skip destructor calls for trivially destructible columns
+        if (!all_trivial)
         {
-            ++num_allocs;
-        });
-    return num_allocs;
+            for (index_t w = 0; w != entries_per_block_ / BITS_PER_WORD; ++w)
+            {
+                for (bitmap_word_t bits = block_bitmap[w]; bits != 0; bits &= bits - 1)
+                {
+                    const index_t slot = w * BITS_PER_WORD + detail::count_trailing_zeros(bits);
+                    destruct(detail::make_index_sequence<NUM_COLUMNS>(),
+                        block_index << entry_shift_ | slot);
+                }
+            }
+        }
+        std::fill_n(block_bitmap, entries_per_block_ / BITS_PER_WORD, bitmap_word_t(0));
+        BlockHeader* block_header = header(block_index);
+        block_header->free_list_.reset(0);
+        block_header->num_allocations_ = 0;
+        index_t* block_indices = indices(block_index);
+        for (index_t i = 0; i != entries_per_block_; ++i)
+        {
+            block_indices[i] = i + 1;
+        }
+        blocks_[block_index].next_free_ = free_block_index_;
+        free_block_index_ = block_index;
+    }
+    num_allocations_ = 0;
 }
 
-} // namespace detail
-
-template <typename T>
-FixedObjectPool<T>::FixedObjectPool(index_t max_entries)
-    : block_(Block::create(max_entries))
+template <typename... Ts>
+template <size_t I>
+typename SoaObjectPool<Ts...>::template column_t<I>& SoaObjectPool<Ts...>::get(index_t entry)
 {
+    assert((entry >> entry_shift_) < blocks_.size());
+    return column<I>(entry >> entry_shift_)[entry & (entries_per_block_ - 1)];
 }
 
-template <typename T>
-FixedObjectPool<T>::~FixedObjectPool()
+template <typename... Ts>
+template <size_t I>
+const typename SoaObjectPool<Ts...>::template column_t<I>& SoaObjectPool<Ts...>::get(
+    index_t entry) const
 {
-    assert(calc_stats().num_allocations == 0);
-    Block::destroy(block_);
+    assert((entry >> entry_shift_) < blocks_.size());
+    return column<I>(entry >> entry_shift_)[entry & (entries_per_block_ - 1)];
 }
 
-template <typename T>
-template <class... P>
-T* FixedObjectPool<T>::new_object(P&&... params)
+namespace detail
 {
-    return block_->new_object(std::forward<P>(params)...);
-}
-
-template <typename T>
-void FixedObjectPool<T>::delete_object(const T* ptr)
+/// Calls func on a contiguous run of SoaObjectPool entries
+template <typename F, typename... C>
+inline void soa_for_each_run(F& func, index_t begin, index_t end, C*... columns)
 {
-    block_->delete_object(ptr);
+    for (index_t i = begin; i != end; ++i)
+    {
+        func(columns[i]...);
+    }
 }
 
-template <typename T>
-void FixedObjectPool<T>::delete_all()
+/// Calls func on the SoaObjectPool entries flagged in a bitmap word
+template <typename F, typename... C>
+inline void soa_for_each_bit(F& func, bitmap_word_t bits, index_t base, C*... columns)
 {
-    block_->delete_all();
+    while (bits != 0)
+    {
+        const index_t i = base + count_trailing_zeros(bits);
+        func(columns[i]...);
+        bits &= bits - 1;
+    }
 }
+} // namespace detail
 
-template <typename T>
-template <typename F>
-void FixedObjectPool<T>::for_each(const F func) const
+template <typename... Ts>
+template <size_t... Columns, typename F>
+void SoaObjectPool<Ts...>::for_each(F func)
 {
-    block_->for_each(func);
+    for (index_t block_index = 0; block_index != blocks_.size(); ++block_index)
+    {
+        if (header(block_index)->num_allocations_ == 0)
+        {
+            continue;
+        }
+        const bitmap_word_t* block_bitmap = bitmap(block_index);
+        for (index_t w = 0; w != entries_per_block_ / BITS_PER_WORD; ++w)
+        {
+            const bitmap_word_t bits = block_bitmap[w];
+            const index_t base = w * BITS_PER_WORD;
+            if (bits == ~bitmap_word_t(0))
+            {
+                // a fully occupied word is a contiguous run of entries which
+                // is visited with a simple loop
+                detail::soa_for_each_run(
+                    func, base, base + BITS_PER_WORD, column<Columns>(block_index)...);
+            }
+            else if (bits != 0)
+            {
+                detail::soa_for_each_bit(func, bits, base, column<Columns>(block_index)...);
+            }
+        }
+    }
 }
 
-template <typename T>
-ObjectPoolStats FixedObjectPool<T>::calc_stats() const
+template <typename... Ts>
+ObjectPoolStats SoaObjectPool<Ts...>::calc_stats() const
 {
+    const size_t sizes[] = {sizeof(Ts)...};
+    size_t entry_size = 0;
+    for (size_t size : sizes)
+    {
+        entry_size += size;
+    }
     ObjectPoolStats stats;
-    stats.num_blocks = 1;
-    stats.num_allocations = block_->num_allocations();
+    stats.num_blocks = blocks_.size();
+    stats.num_allocations = num_allocations_;
+    stats.peak_allocations = peak_allocations_;
+    for (index_t block_index = 0; block_index != blocks_.size(); ++block_index)
+    {
+        stats.num_free_blocks += header(block_index)->num_allocations_ == 0;
+    }
+    stats.bytes_reserved = blocks_.size() * block_size_ + blocks_.capacity() * sizeof(BlockInfo);
+    stats.bytes_in_use = num_allocations_ * entry_size;
     return stats;
 }
 
 template <typename T>
-DynamicObjectPool<T>::DynamicObjectPool(index_t entries_per_block)
-    : block_info_(nullptr),
+ConcurrentObjectPool<T>::State::State(index_t entries_per_block, index_t cache_size)
+    : entries_per_block_(entries_per_block),
+      cache_size_(std::max<index_t>(cache_size, 2)),
+      block_align_(std::max<size_t>(detail::MIN_BLOCK_ALIGN,
+          detail::next_pow2(Block::calc_block_size(entries_per_block)))),
       num_blocks_(0),
-      free_block_index_(0),
-      entries_per_block_(entries_per_block)
+      free_block_hint_(0),
+      retired_live_(0)
 {
-    // always have one block available
-    add_block();
+    for (index_t i = 0; i != MAX_SEGMENTS; ++i)
+    {
+        segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
 }
 
 template <typename T>
-DynamicObjectPool<T>::~DynamicObjectPool()
+ConcurrentObjectPool<T>::State::~State()
 {
-    // explicitly delete_object or delete_all before pool goes out of scope
-    assert(calc_stats().num_allocations == 0);
+    // entries in thread caches are allocated as far as their block is
+    // concerned so free block storage without calling any destructors
+    const index_t num_blocks = num_blocks_.load(std::memory_order_acquire);
+    for (index_t index = 0; index != num_blocks; ++index)
+    {
+        Block::destroy_storage(block_info(index).block_, ObjectPoolBlockAllocator());
+    }
+    for (index_t i = 0; i != MAX_SEGMENTS; ++i)
+    {
+        if (BlockInfo* segment = segments_[i].load(std::memory_order_relaxed))
+        {
+            const index_t segment_size = FIRST_SEGMENT_SIZE << i;
+            for (index_t j = 0; j != segment_size; ++j)
+            {
+                segment[j].~BlockInfo();
+            }
+            detail::aligned_free(segment);
+        }
+    }
 }
 
 template <typename T>
-typename DynamicObjectPool<T>::BlockInfo* DynamicObjectPool<T>::add_block()
+typename ConcurrentObjectPool<T>::BlockInfo& ConcurrentObjectPool<T>::State::block_info(
+    index_t index) const
 {
-    assert(free_block_index_ == num_blocks_);
-    if (Block* block = Block::create(entries_per_block_))
-    {
-        // update the number of blocks
-        ++num_blocks_;
-        // allocate space for new block info
-        block_info_ =
-            reinterpret_cast<BlockInfo*>(realloc(block_info_, num_blocks_ * sizeof(BlockInfo)));
-        // initialise the new block info structure
-        BlockInfo& info = block_info_[free_block_index_];
-        info.num_free_ = entries_per_block_;
-        info.offset_ = block->memory_offset();
-        info.block_ = block;
-        return &info;
-    }
-    return nullptr;
+    // segment n starts at index FIRST_SEGMENT_SIZE * (2^n - 1)
+    const index_t segment = detail::floor_log2(index / FIRST_SEGMENT_SIZE + 1);
+    const index_t offset = index - FIRST_SEGMENT_SIZE * ((index_t(1) << segment) - 1);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
 }
 
 template <typename T>
-template <typename... P>
-T* DynamicObjectPool<T>::new_object(P&&... params)
+void ConcurrentObjectPool<T>::State::add_block(index_t num_blocks)
 {
-    assert(free_block_index_ < num_blocks_);
-
-    // search for a block with free space
-    BlockInfo* p_info = block_info_ + free_block_index_;
-    for (const BlockInfo* p_end = block_info_ + num_blocks_;
-         p_info != p_end && p_info->num_free_ == 0; ++p_info)
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    // another thread may have added a block while we were waiting
+    if (num_blocks_.load(std::memory_order_relaxed) != num_blocks)
     {
+        return;
     }
 
-    // update the free block index
-    free_block_index_ = static_cast<index_t>(p_info - block_info_);
+    Block* block = Block::create(entries_per_block_, block_align_, ObjectPoolBlockAllocator());
+    if (!block)
+    {
+        return;
+    }
+    block->set_pool_index(num_blocks);
 
-    // if no free blocks found then create a new one
-    if (free_block_index_ == num_blocks_)
+    // allocate a new segment of block info records if needed
+    const index_t segment = detail::floor_log2(num_blocks / FIRST_SEGMENT_SIZE + 1);
+    if (!segments_[segment].load(std::memory_order_relaxed))
     {
-        p_info = add_block();
-        if (!p_info)
+        const index_t segment_size = FIRST_SEGMENT_SIZE << segment;
+        BlockInfo* infos = reinterpret_cast<BlockInfo*>(
+            detail::aligned_malloc(sizeof(BlockInfo) * segment_size, detail::MIN_BLOCK_ALIGN));
+        if (!infos)
         {
-            return nullptr;
+            Block::destroy(block, ObjectPoolBlockAllocator());
+            return;
+        }
+        for (index_t j = 0; j != segment_size; ++j)
+        {
+            new (infos + j) BlockInfo();
         }
+        segments_[segment].store(infos, std::memory_order_release);
     }
 
-    // construct the new object
-    T* ptr = p_info->block_->new_object(std::forward<P>(params)...);
-    assert(ptr != nullptr);
-    // update num free count
-    --p_info->num_free_;
-    return ptr;
+    BlockInfo& info = block_info(num_blocks);
+    info.num_free_.store(entries_per_block_, std::memory_order_relaxed);
+    info.block_ = block;
+
+    // publish the new block to other threads
+    free_block_hint_.store(num_blocks, std::memory_order_relaxed);
+    num_blocks_.store(num_blocks + 1, std::memory_order_release);
 }
 
 template <typename T>
-void DynamicObjectPool<T>::delete_object(const T* ptr)
+void ConcurrentObjectPool<T>::State::refill(ThreadCache& cache)
 {
-    BlockInfo* p_info = block_info_;
-    for (auto end = p_info + num_blocks_; p_info != end; ++p_info)
+    assert(cache.count_ == 0);
+    const index_t batch_size = cache_size_ / 2;
+    for (;;)
     {
-        const T* p_entries_begin = p_info->offset_;
-        const T* p_entries_end = p_entries_begin + entries_per_block_;
-        if (ptr >= p_entries_begin && ptr < p_entries_end)
+        const index_t num_blocks = num_blocks_.load(std::memory_order_acquire);
+        // try the hinted block first then search from where this thread
+        // last found space
+        index_t index = free_block_hint_.load(std::memory_order_relaxed);
+        for (index_t i = 0; i <= num_blocks && cache.count_ < batch_size; ++i)
         {
-            p_info->block_->delete_object(ptr);
-            ++p_info->num_free_;
-            const index_t free_block = static_cast<index_t>(p_info - block_info_);
-            if (free_block < free_block_index_)
+            if (i != 0)
             {
-                free_block_index_ = free_block;
+                index = cache.next_block_++;
             }
+            if (index >= num_blocks)
+            {
+                index = cache.next_block_ = 0;
+                if (num_blocks == 0)
+                {
+                    break;
+                }
+            }
+            BlockInfo& info = block_info(index);
+            if (info.num_free_.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+            // pop a batch of entries from the block
+            std::lock_guard<detail::SpinLock> lock(info.lock_);
+            index_t count = 0;
+            while (cache.count_ < batch_size)
+            {
+                T* ptr = info.block_->allocate();
+                if (!ptr)
+                {
+                    break;
+                }
+                cache.entries_[cache.count_++] = ptr;
+                ++count;
+            }
+            info.num_free_.store(info.num_free_.load(std::memory_order_relaxed) - count,
+                std::memory_order_relaxed);
+        }
+
+        if (cache.count_ != 0)
+        {
+            return;
+        }
+
+        // every block is full, add a new one and try again
+        add_block(num_blocks);
+        if (num_blocks_.load(std::memory_order_acquire) == num_blocks)
+        {
+            // failed to allocate a block
             return;
         }
     }
 }
 
 template <typename T>
-void DynamicObjectPool<T>::delete_all()
+void ConcurrentObjectPool<T>::State::flush(ThreadCache& cache, index_t count)
 {
-    for (BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
-         ++p_info)
+    assert(count <= cache.count_);
+    T** first = cache.entries_;
+    T** last = first + count;
+    // sort by address so entries from the same block are adjacent and each
+    // block only needs to be locked once
+    std::sort(first, last);
+    while (first != last)
     {
-        p_info->block_->delete_all();
-        p_info->num_free_ = entries_per_block_;
+        Block* block = Block::from_pointer(*first, block_align_);
+        BlockInfo& info = block_info(block->pool_index());
+        assert(info.block_ == block);
+        index_t num_freed = 0;
+        {
+            std::lock_guard<detail::SpinLock> lock(info.lock_);
+            for (; first != last && Block::from_pointer(*first, block_align_) == block; ++first)
+            {
+                block->deallocate(*first);
+                ++num_freed;
+            }
+            info.num_free_.store(info.num_free_.load(std::memory_order_relaxed) + num_freed,
+                std::memory_order_relaxed);
+        }
+        free_block_hint_.store(block->pool_index(), std::memory_order_relaxed);
     }
-    free_block_index_ = 0;
+    // move remaining entries to the start of the cache
+    std::copy(cache.entries_ + count, cache.entries_ + cache.count_, cache.entries_);
+    cache.count_ -= count;
 }
 
 template <typename T>
-void DynamicObjectPool<T>::reclaim_memory()
+void ConcurrentObjectPool<T>::State::retire(ThreadCache* cache)
 {
-    // loop through all blocks shuffling the used blocks to the front and unused
-    // to the back.
-    index_t used_index = num_blocks_;
-    index_t empty_index = num_blocks_;
-    for (index_t index = 0; index < num_blocks_; ++index)
-    {
-        if (block_info_[index].num_free_ != entries_per_block_)
-        {
-            used_index = index;
-        }
-        else if (index < empty_index)
-        {
-            empty_index = index;
-        }
+    flush(*cache, cache->count_);
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+    retired_live_ += cache->num_live_.load(std::memory_order_relaxed);
+    caches_.erase(std::find(caches_.begin(), caches_.end(), cache));
+}
+
+template <typename T>
+ConcurrentObjectPool<T>::ThreadCacheList::ThreadCacheList()
+    : last_pool_id_(0), last_cache_(nullptr)
+{
+}
 
-        if (empty_index < used_index && used_index != num_blocks_)
+template <typename T>
+ConcurrentObjectPool<T>::ThreadCacheList::~ThreadCacheList()
+{
+    // return cached entries to pools which still exist
+    for (auto& entry : entries_)
+    {
+        if (std::shared_ptr<State> state = entry.state_.lock())
         {
-            std::swap(block_info_[empty_index], block_info_[used_index]);
-            used_index = empty_index;
-            ++empty_index;
+            state->retire(entry.cache_);
         }
+        destroy_cache(entry.cache_);
     }
+}
 
-    // if no blocks are used, keep one around
-    if (used_index == num_blocks_)
+template <typename T>
+typename ConcurrentObjectPool<T>::ThreadCache* ConcurrentObjectPool<T>::create_cache(
+    State& state)
+{
+    ThreadCache* cache = new ThreadCache;
+    cache->entries_ = new T*[state.cache_size_];
+    cache->count_ = 0;
+    cache->next_block_ = 0;
+    cache->num_live_.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(state.caches_mutex_);
+    state.caches_.push_back(cache);
+    return cache;
+}
+
+template <typename T>
+void ConcurrentObjectPool<T>::destroy_cache(ThreadCache* cache)
+{
+    delete[] cache->entries_;
+    delete cache;
+}
+
+template <typename T>
+typename ConcurrentObjectPool<T>::ThreadCache& ConcurrentObjectPool<T>::thread_cache()
+{
+    static thread_local ThreadCacheList list;
+    if (list.last_pool_id_ == pool_id_)
     {
-        used_index = 0;
-        free_block_index_ = 0;
+        return *list.last_cache_;
     }
 
-    // free remaining empty blocks
-    for (index_t index = used_index + 1; index != num_blocks_; ++index)
+    auto& entries = list.entries_;
+    auto itr = std::find_if(entries.begin(), entries.end(),
+        [this](const typename ThreadCacheList::Entry& entry)
+        {
+            return entry.pool_id_ == pool_id_;
+        });
+    if (itr == entries.end())
     {
-        Block::destroy(block_info_[index].block_);
+        // discard caches belonging to pools which have been destroyed
+        for (auto& entry : entries)
+        {
+            if (entry.state_.expired())
+            {
+                destroy_cache(entry.cache_);
+                entry.cache_ = nullptr;
+            }
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                          [](const typename ThreadCacheList::Entry& entry)
+                          {
+                              return entry.cache_ == nullptr;
+                          }),
+            entries.end());
+
+        typename ThreadCacheList::Entry entry;
+        entry.pool_id_ = pool_id_;
+        entry.state_ = state_;
+        entry.cache_ = create_cache(*state_);
+        itr = entries.insert(entries.end(), entry);
     }
+    list.last_pool_id_ = pool_id_;
+    list.last_cache_ = itr->cache_;
+    return *itr->cache_;
+}
 
-    // resize the block info array
-    num_blocks_ = used_index + 1;
-    block_info_ =
-        reinterpret_cast<BlockInfo*>(realloc(block_info_, sizeof(BlockInfo) * num_blocks_));
+template <typename T>
+ConcurrentObjectPool<T>::ConcurrentObjectPool(index_t entries_per_block, index_t cache_size)
+    : state_(std::make_shared<State>(entries_per_block, cache_size)),
+      pool_id_(detail::next_pool_id())
+{
+}
 
-    // find the first free block index
-    free_block_index_ = num_blocks_;
-    for (index_t index = 0; index != num_blocks_; ++index)
+template <typename T>
+ConcurrentObjectPool<T>::~ConcurrentObjectPool()
+{
+    // explicitly delete_object all objects before pool goes out of scope
+    assert(calc_stats().num_allocations == 0);
+}
+
+template <typename T>
+template <class... P>
+T* ConcurrentObjectPool<T>::new_object(P&&... params)
+{
+    ThreadCache& cache = thread_cache();
+    if (cache.count_ == 0)
     {
-        if (block_info_[index].num_free_ != 0)
+        state_->refill(cache);
+        if (cache.count_ == 0)
         {
-            free_block_index_ = index;
-            break;
+            return nullptr;
         }
     }
+    T* ptr = cache.entries_[--cache.count_];
+    new (ptr) T(std::forward<P>(params)...);
+    cache.num_live_.store(
+        cache.num_live_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return ptr;
 }
 
 template <typename T>
-template <typename F>
-void DynamicObjectPool<T>::for_each(const F func) const
+void ConcurrentObjectPool<T>::delete_object(const T* ptr)
 {
-    for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
-         ++p_info)
+    if (ptr)
     {
-        if (p_info->num_free_ < entries_per_block_)
+        ptr->~T();
+        ThreadCache& cache = thread_cache();
+        if (cache.count_ == state_->cache_size_)
         {
-            p_info->block_->for_each(func);
+            // return the oldest half of the cache to the shared blocks
+            state_->flush(cache, cache.count_ / 2);
         }
+        cache.entries_[cache.count_++] = const_cast<T*>(ptr);
+        cache.num_live_.store(
+            cache.num_live_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
     }
 }
 
 template <typename T>
-ObjectPoolStats DynamicObjectPool<T>::calc_stats() const
+void ConcurrentObjectPool<T>::flush_thread_cache()
+{
+    ThreadCache& cache = thread_cache();
+    state_->flush(cache, cache.count_);
+}
+
+template <typename T>
+ObjectPoolStats ConcurrentObjectPool<T>::calc_stats() const
 {
+    const State& state = *state_;
     ObjectPoolStats stats;
-    stats.num_blocks = num_blocks_;
-    stats.num_allocations = 0;
-    for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
-         ++p_info)
+    const index_t num_blocks = state.num_blocks_.load(std::memory_order_acquire);
+    stats.num_blocks = num_blocks;
+    for (index_t index = 0; index != num_blocks; ++index)
     {
-        if (p_info->num_free_ < entries_per_block_)
+        if (state.block_info(index).num_free_.load(std::memory_order_relaxed)
+            == state.entries_per_block_)
         {
-            stats.num_allocations += p_info->block_->num_allocations();
+            ++stats.num_free_blocks;
         }
     }
+    stats.bytes_reserved =
+        num_blocks * (Block::calc_block_size(state.entries_per_block_) + sizeof(BlockInfo));
+    std::lock_guard<std::mutex> lock(state.caches_mutex_);
+    int64_t num_live = state.retired_live_;
+    for (const ThreadCache* cache : state.caches_)
+    {
+        num_live += cache->num_live_.load(std::memory_order_relaxed);
+        stats.bytes_reserved += sizeof(ThreadCache) + sizeof(T*) * state.cache_size_;
+    }
+    stats.num_allocations = static_cast<size_t>(num_live);
+    stats.bytes_in_use = stats.num_allocations * sizeof(T);
     return stats;
 }
 